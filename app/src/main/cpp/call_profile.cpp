@@ -0,0 +1,152 @@
+//
+// Created by agent on 2026/10/17.
+//
+
+#include "call_profile.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+CallProfile::CallProfile(size_t maxNodes) : maxNodes(std::max<size_t>(maxNodes, 1)) {
+    nodes.reserve(this->maxNodes);
+    // 装载率不超过一半
+    size_t size = 1;
+    while (size < this->maxNodes * 2) {
+        size <<= 1;
+    }
+    table.assign(size, 0);
+    tableMask = size - 1;
+}
+
+void CallProfile::reset(uint64_t root) {
+    nodes.clear();
+    nodes.push_back(ProfileNode{root, 0, 0, 1});
+    std::fill(table.begin(), table.end(), 0);
+    depth = 0;
+    droppedCalls = 0;
+    overflowCalls = 0;
+}
+
+uint32_t CallProfile::child(uint32_t parent, uint64_t function) {
+    uint64_t h = (function * 0x9e3779b97f4a7c15ull) ^ (parent * 0xc2b2ae3d27d4eb4full);
+    for (uint64_t i = (h >> 20) & tableMask;; i = (i + 1) & tableMask) {
+        uint32_t slot = table[i];
+        if (slot == 0) {
+            if (nodes.size() == maxNodes) {
+                droppedCalls++;
+                return parent;
+            }
+            nodes.push_back(ProfileNode{function, parent, 0, 0});
+            table[i] = (uint32_t) nodes.size();
+            return (uint32_t) nodes.size() - 1;
+        }
+        const ProfileNode &node = nodes[slot - 1];
+        if (node.function == function && node.parent == parent) {
+            return slot - 1;
+        }
+    }
+}
+
+std::vector<uint64_t> CallProfile::functions() const {
+    std::vector<uint64_t> result;
+    result.reserve(nodes.size());
+    for (const auto &node: nodes) {
+        result.push_back(node.function);
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+void CallProfile::report(std::string &out, const std::unordered_map<uint64_t, std::string> &names) const {
+    auto name = [&](uint64_t function) -> const std::string & {
+        static const std::string unknown = "?";
+        auto it = names.find(function);
+        return it != names.end() ? it->second : unknown;
+    };
+
+    // 子节点总在父节点之后创建，倒序累加即得到每个节点包含子调用的指令数
+    std::vector<uint64_t> total(nodes.size());
+    for (size_t i = nodes.size(); i-- > 0;) {
+        total[i] += nodes[i].self;
+        if (i != 0) {
+            total[nodes[i].parent] += total[i];
+        }
+    }
+
+    // 按函数汇总：递归时只计最外层的调用，避免重复计入
+    struct Row {
+        uint64_t function;
+        uint64_t self;
+        uint64_t total;
+        uint64_t calls;
+    };
+    std::unordered_map<uint64_t, Row> rows;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const ProfileNode &node = nodes[i];
+        Row &row = rows.emplace(node.function, Row{node.function, 0, 0, 0}).first->second;
+        row.self += node.self;
+        row.calls += node.calls;
+        bool nested = false;
+        for (uint32_t p = node.parent; i != 0; p = nodes[p].parent) {
+            if (nodes[p].function == node.function) {
+                nested = true;
+                break;
+            }
+            if (p == 0) {
+                break;
+            }
+        }
+        if (!nested) {
+            row.total += total[i];
+        }
+    }
+    std::vector<Row> sorted;
+    sorted.reserve(rows.size());
+    for (const auto &item: rows) {
+        sorted.push_back(item.second);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Row &a, const Row &b) {
+        return a.self != b.self ? a.self > b.self : a.function < b.function;
+    });
+
+    char line[512];
+    uint64_t all = total.empty() ? 0 : total[0];
+    snprintf(line, sizeof(line), "# %" PRIu64 " instructions, %zu call paths, %zu functions\n", all, nodes.size(),
+             sorted.size());
+    out += line;
+    if (droppedCalls != 0 || overflowCalls != 0) {
+        snprintf(line, sizeof(line), "# %" PRIu64 " calls merged into caller (node limit), %" PRIu64
+                                     " beyond max depth\n", droppedCalls, overflowCalls);
+        out += line;
+    }
+    snprintf(line, sizeof(line), "# %14s %14s %10s %7s  %s\n", "self", "total", "calls", "self%", "function");
+    out += line;
+    for (const Row &row: sorted) {
+        snprintf(line, sizeof(line), "# %14" PRIu64 " %14" PRIu64 " %10" PRIu64 " %6.2f%%  %s\n", row.self,
+                 row.total, row.calls, all ? 100.0 * row.self / all : 0.0, name(row.function).c_str());
+        out += line;
+    }
+
+    // folded stack：每个有直接执行指令的节点一行
+    std::vector<uint32_t> path;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (nodes[i].self == 0) {
+            continue;
+        }
+        path.clear();
+        for (uint32_t p = (uint32_t) i;; p = nodes[p].parent) {
+            path.push_back(p);
+            if (p == 0) {
+                break;
+            }
+        }
+        for (size_t j = path.size(); j-- > 0;) {
+            out += name(nodes[path[j]].function);
+            out += j != 0 ? ';' : ' ';
+        }
+        snprintf(line, sizeof(line), "%" PRIu64 "\n", nodes[i].self);
+        out += line;
+    }
+}
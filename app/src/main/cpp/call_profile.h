@@ -0,0 +1,97 @@
+//
+// Created by agent on 2026/10/17.
+//
+// profile 模式（TRACE_PROFILE）的计数：影子调用栈 + 调用上下文树。
+// 每个节点是一条调用路径（根为 trace 目标），记录在该路径上直接执行的指令数；
+// 节点数组和子节点哈希表在创建时一次分配，之后内存不再增长，超出容量的调用计入调用者。
+// 不依赖 QBDI，由 vm.cpp 中的 sequence / 调用回调驱动。
+//
+
+#ifndef XPOSEDNHOOK_CALL_PROFILE_H
+#define XPOSEDNHOOK_CALL_PROFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 影子栈的最大深度，更深的调用计入栈顶
+#define PROFILE_MAX_DEPTH 1024
+#define PROFILE_DEFAULT_NODES (1 << 16)
+
+struct ProfileNode {
+    uint64_t function;      // 函数入口地址
+    uint32_t parent;        // 根节点的 parent 为自身（0）
+    uint64_t self;          // 在这条调用路径上直接执行的指令数
+    uint64_t calls;
+};
+
+struct ProfileFrame {
+    uint32_t node;
+    uint64_t returnAddress;
+    uint64_t sp;            // 调用时的 sp，返回后恢复为该值
+};
+
+class CallProfile {
+public:
+    explicit CallProfile(size_t maxNodes);
+
+    // 新的一次调用：只保留根节点 root
+    void reset(uint64_t root);
+
+    // 调用指令执行后：pc 为被调用函数，lr 为返回地址
+    void call(uint64_t function, uint64_t returnAddress, uint64_t sp) {
+        if (depth == PROFILE_MAX_DEPTH) {
+            overflowCalls++;
+            return;
+        }
+        uint32_t parent = top();
+        uint32_t node = child(parent, function);
+        if (node != parent) {
+            nodes[node].calls++;
+        }
+        frames[depth++] = ProfileFrame{node, returnAddress, sp};
+    }
+
+    // 新的 sequence 开始执行：先弹出已经返回的帧（到达返回地址且 sp 已恢复，或 sp 已越过调用时的位置），
+    // counted 时把 sequence 的指令数计入栈顶的节点
+    void execute(uint64_t address, uint64_t sp, uint64_t instructions, bool counted) {
+        while (depth > 0) {
+            const ProfileFrame &frame = frames[depth - 1];
+            if (sp > frame.sp || (sp == frame.sp && address == frame.returnAddress)) {
+                depth--;
+                continue;
+            }
+            break;
+        }
+        if (counted) {
+            nodes[top()].self += instructions;
+        }
+    }
+
+    // 火焰图的 folded stack（"根;调用者;函数 指令数"）和按函数汇总的表（每行以 "# " 开头，
+    // flamegraph.pl 会忽略），names 为函数地址到名称的映射
+    void report(std::string &out, const std::unordered_map<uint64_t, std::string> &names) const;
+
+    // 出现过的函数地址
+    std::vector<uint64_t> functions() const;
+
+private:
+    uint32_t top() const { return depth > 0 ? frames[depth - 1].node : 0; }
+
+    // parent 下 function 的子节点，不存在时创建；节点用完时返回 parent
+    uint32_t child(uint32_t parent, uint64_t function);
+
+    std::vector<ProfileNode> nodes;
+    // 子节点哈希表：(parent, function) -> 节点下标 + 1，0 为空
+    std::vector<uint32_t> table;
+    uint64_t tableMask;
+    size_t maxNodes;
+    ProfileFrame frames[PROFILE_MAX_DEPTH];
+    size_t depth = 0;
+    uint64_t droppedCalls = 0;      // 节点用完后计入调用者的调用
+    uint64_t overflowCalls = 0;     // 超过影子栈深度的调用
+};
+
+#endif //XPOSEDNHOOK_CALL_PROFILE_H
@@ -0,0 +1,120 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 覆盖率模式（TRACE_COVERAGE）的边位图，与 AFL 相同：块地址散列为 16 位 id，
+// 边 (prev, cur) 计入 hits[cur ^ (prev >> 1)]，计数饱和于 255。
+// 比较时把计数归到 AFL 的区间（1 / 2 / 3 / 4-7 / 8-15 / 16-31 / 32-127 / 128+），
+// 新的边或已有边进入新的计数区间都算作新覆盖。不依赖 QBDI，主机端也可以使用。
+//
+
+#ifndef XPOSEDNHOOK_COVERAGE_H
+#define XPOSEDNHOOK_COVERAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#define COVERAGE_MAP_BITS 16
+#define COVERAGE_MAP_SIZE (1 << COVERAGE_MAP_BITS)
+
+// 块地址 -> 16 位 id
+static inline uint32_t coverageBlockId(uint64_t address) {
+    uint64_t h = (address >> 2) * 0x9e3779b97f4a7c15ull;
+    return (uint32_t) (h >> (64 - COVERAGE_MAP_BITS));
+}
+
+// 计数所在的区间，每个区间一位
+static inline uint8_t coverageBucket(uint8_t count) {
+    if (count <= 3) {
+        return count == 0 ? 0 : count == 3 ? 4 : count;
+    }
+    if (count <= 7) return 8;
+    if (count <= 15) return 16;
+    if (count <= 31) return 32;
+    if (count <= 127) return 64;
+    return 128;
+}
+
+struct CoverageMap {
+    uint8_t hits[COVERAGE_MAP_SIZE];
+
+    void reset() { memset(hits, 0, sizeof(hits)); }
+
+    void copyTo(CoverageMap &snapshot) const { memcpy(snapshot.hits, hits, sizeof(hits)); }
+
+    // 执行过的边数
+    size_t edges() const {
+        size_t count = 0;
+        for (size_t i = 0; i < COVERAGE_MAP_SIZE; i += 8) {
+            uint64_t word;
+            memcpy(&word, hits + i, sizeof(word));
+            if (word == 0) {
+                continue;
+            }
+            for (size_t j = i; j < i + 8; ++j) {
+                count += hits[j] != 0;
+            }
+        }
+        return count;
+    }
+};
+
+// 执行时的位图更新，prev 为上一个块的 id 右移一位
+struct CoverageCursor {
+    uint32_t prev = 0;
+
+    inline void enter(CoverageMap &map, uint64_t blockAddress) {
+        uint32_t cur = coverageBlockId(blockAddress);
+        uint8_t &hit = map.hits[cur ^ prev];
+        hit += hit != UINT8_MAX;
+        prev = cur >> 1;
+    }
+};
+
+// current 相对 base（另一次调用的快照）的变化：current 中执行过、且计数区间与 base 不同的边，
+// 返回个数，edges 不为空时输出这些边的下标
+static inline size_t coverageDiff(const CoverageMap &base, const CoverageMap &current,
+                                  std::vector<uint32_t> *edges = nullptr) {
+    size_t count = 0;
+    for (uint32_t i = 0; i < COVERAGE_MAP_SIZE; i += 8) {
+        uint64_t word;
+        memcpy(&word, current.hits + i, sizeof(word));
+        if (word == 0) {
+            continue;
+        }
+        for (uint32_t j = i; j < i + 8; ++j) {
+            uint8_t bucket = coverageBucket(current.hits[j]);
+            if (bucket != 0 && bucket != coverageBucket(base.hits[j])) {
+                count++;
+                if (edges != nullptr) {
+                    edges->push_back(j);
+                }
+            }
+        }
+    }
+    return count;
+}
+
+// 累计覆盖：total 中每条边保存见过的计数区间的并集。把 current 并入 total，返回带来新区间的边数，
+// 大于 0 说明这次调用到达了新的代码或新的循环次数
+static inline size_t coverageMerge(CoverageMap &total, const CoverageMap &current) {
+    size_t count = 0;
+    for (uint32_t i = 0; i < COVERAGE_MAP_SIZE; i += 8) {
+        uint64_t word;
+        memcpy(&word, current.hits + i, sizeof(word));
+        if (word == 0) {
+            continue;
+        }
+        for (uint32_t j = i; j < i + 8; ++j) {
+            uint8_t bucket = coverageBucket(current.hits[j]);
+            if (bucket & ~total.hits[j]) {
+                total.hits[j] |= bucket;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+#endif //XPOSEDNHOOK_COVERAGE_H
@@ -12,8 +12,12 @@
 #include <sys/mman.h>
 #include <__fwd/string.h>
 #include "vm.h"
+#include "vm_pool.h"
+#include "stack_pool.h"
+#include "trace_session.h"
 #include "utils.h"
 #include "md5.h"
+#include "rc4.h"
 #include "sha1.hpp"
 
 uint64_t get_tick_count64() {
@@ -27,6 +31,37 @@ uint64_t get_tick_count64() {
 // 获取当前时间戳的函数
 uint64_t get_tick_count64();
 
+// trace 配置，format 改为 TRACE_FORMAT_BINARY 时输出 trace_log.bin，
+// 再在电脑上用 tools/trace_render 转成 trace_log.txt。
+// granularity 改为 TRACE_BLOCK 时每个块只回调两次，同样输出 trace_log.bin，由 trace_render 展开为逐条指令。
+// scope 默认为目标所在的整个模块，可以缩小范围，例如：
+//   g_trace_config.scope.addModule("libil2cpp.so").excludeRange("libil2cpp.so", 0x100000, 0x180000);
+//   g_trace_config.scope.addSymbol("libnhook.so", "Java_cn_mrack_xposed_nhook_NHook_sign1");
+// policy 默认只 trace 第一次调用；每次调用都 trace 时为 limit = 0，每 10 次 trace 一次、最多 20 次时为
+//   g_trace_config.policy.every = 10; g_trace_config.policy.limit = 20;
+// 每次被 trace 的调用追加到同一个文件中，以 "==== segment N ..." 分隔（二进制为 TRACE_REC_SEGMENT）。
+// granularity 改为 TRACE_PROFILE 时不输出 trace，只统计每条调用路径执行的指令数，写入 trace_profile.txt（总是文本，没有段分隔行）：
+// "# " 开头的是按函数汇总的表，其余行是 folded stack，可以直接交给 flamegraph.pl。
+// index = true 时另外写出 trace 文件名 + ".idx" 的索引，用 tools/trace_seek 跳到第 N 条指令或某个地址。
+// 目标带反调试、可能让进程崩溃时设 durable = true，trace 直接写进映射的 trace_log.txt.mmap，
+// 进程被杀也保留到最后一条完整的记录，tools 可以直接读取，trace_decompress 可以还原为普通文件。
+// 手机空间不够时设 stream = "unix:qbdi_trace"，第一次命中时在后台等待电脑上的 tools/trace_collect 连接
+// （最多 streamWaitMs），连上之后的调用才 trace，trace 不落盘，直接发到电脑上（adb forward tcp:5555 localabstract:qbdi_trace）。
+static TraceConfig g_trace_config;
+
+// 覆盖率模式（granularity = TRACE_COVERAGE）：所有调用累计的覆盖和上一次调用的快照，
+// 每次调用后输出本次的边数、相对上一次调用变化的边数、带来新覆盖的边数
+static CoverageMap g_coverage_total;
+static CoverageMap g_coverage_last;
+
+static void report_coverage(const CoverageMap &coverage, uint32_t segment) {
+    size_t changed = coverageDiff(g_coverage_last, coverage);
+    size_t fresh = coverageMerge(g_coverage_total, coverage);
+    coverage.copyTo(g_coverage_last);
+    LOGT("segment %u coverage: %zu edges, %zu changed since last call, %zu new, %zu total", segment,
+         coverage.edges(), changed, fresh, g_coverage_total.edges());
+}
+
 
 //void vm_handle_add(void *address, DobbyRegisterContext *ctx) {
 //    uint64_t now = get_tick_count64();
@@ -62,60 +97,86 @@ uint64_t get_tick_count64();
 //    LOGT("Read %ld times cost = %lfs\n", number, (double)(get_tick_count64() - now) / 1000);
 //}
 
-void vm_handle_add(void *address, DobbyRegisterContext *ctx) {
-    uint64_t now = get_tick_count64();
-    size_t number = 1;
-
-    LOGT("vm address %p ", address);
-    // 销毁拦截（或钩子）以避免重复触发
-    DobbyDestroy(address);
-    // 创建虚拟机实例
-    auto vm_ = new vm();
-    // 初始化虚拟机，并将目标地址传递给虚拟机
-    auto qvm = vm_->init(address);
+// 在池中的虚拟机上执行一次目标函数，trace 写入 trace 文件中编号为 segment 的段
+static void trace_call(void *address, DobbyRegisterContext *ctx, uint32_t segment) {
+    // 从池中取出该目标的虚拟机，第一次调用时创建并初始化，之后复用已翻译的块
+    vm *vm_ = vmPool().acquire(address, g_trace_config);
+    if (vm_ == nullptr) {
+        return;
+    }
+    // 从栈池取出虚拟栈，大小由该目标的配置决定（默认 8MB）。
+    // 原来用 allocateVirtualStack 从堆上分配 8MB 连续内存经常失败，只能退到 1MB；
+    // 栈池用 mmap 只保留地址空间，用到的页才占用内存，栈底有保护页
+    VirtualStack *stack = stackPool().acquire(vm_->config.stackSize, vm_->config.prefaultStack);
+    if (stack == nullptr) {
+        LOGT("Failed to allocate virtual stack");
+        vmPool().release(vm_);
+        return;
+    }
+    TraceSession &session = traceSession();
+    vm_->begin(session.sink(), segment, session.indexSink(), session.streamBase());
+    auto &qvm = vm_->qvm;
     // 获取虚拟机的通用寄存器状态
     auto state = qvm.getGPRState();
     // 将 Dobby 的寄存器上下文同步到虚拟机的状态
     syn_regs(ctx, state);
-    // 分配虚拟堆栈，大小为 0x800000 字节（8MB），为虚拟机的运行提供栈空间
-    uint8_t *fakestack;
-    // Allocate virtual stack
-    //改为分配0x100000内存为1mb后成功了
-    //如果需要更大可以考虑
-    /**
-     * 方法 1：分块分配多个 1MB 的小栈
-     * 方法 2：基于 mmap 的手动栈分配
-     * 方法 3：通过优化栈使用来减少栈需求
-     * 方法 4：确认是否存在系统限制
-     */
-    //内存不足：堆栈大小为 8MB，设备可能没有足够的连续内存来满足分配请求。
-    long mem_size = 0x100000 * 1 * 1 ;
-    if (QBDI::allocateVirtualStack(state, mem_size, &fakestack)) {
-        LOGT("Failed to allocate virtual stack");
+    useVirtualStack(state, stack);
+    // 调用虚拟机执行目标函数，传入目标函数地址
+    qvm.call(nullptr, (uint64_t) address);
+    // 归还虚拟机和虚拟栈，供下一次调用复用
+    vm_->end();
+    if (vm_->coverage) {
+        report_coverage(*vm_->coverage, segment);
     }
+    stackPool().release(stack);
+    vmPool().release(vm_);
+}
 
-    // Set memory protection to PROT_READ | PROT_WRITE
-    if (mprotect(fakestack, mem_size, PROT_READ | PROT_WRITE) != 0) {
-        perror("mprotect failed");
-        QBDI::alignedFree(fakestack);
-    }
+// 当前线程是否正在执行被 trace 的调用：trace 期间目标函数被原生代码（回调、未插装的库）再次调用时，
+// hook 再次进入这里，直接返回让原函数照常执行
+static thread_local bool t_in_trace = false;
 
-    double mem_size_mb = mem_size / (1024.0 * 1024.0);
-    LOGT("Virtual stack allocated at %p with size %.2f MB and permissions PROT_READ | PROT_WRITE", fakestack, mem_size_mb);
-    // 调用虚拟机执行目标函数，传入目标函数地址
-    qvm.call(nullptr, (uint64_t) address);
-    // 释放之前分配的虚拟堆栈内存
-    QBDI::alignedFree(fakestack);
+void vm_handle_add(void *address, DobbyRegisterContext *ctx) {
+    if (t_in_trace) {
+        return;
+    }
+    // 按 g_trace_config.policy 决定这次调用是否 trace，不 trace 时原函数照常执行。
+    // hook 一直挂着：其他线程的调用也会进入这里，由 admit 决定；达到次数上限后 admit 一直返回 false
+    uint32_t segment;
+    if (!traceSession().admit(address, g_trace_config.policy, segment)) {
+        return;
+    }
+    uint64_t now = get_tick_count64();
+    t_in_trace = true;
 
-    // 将虚拟机的日志数据写入文件
-    std::ofstream out;
+    LOGT("vm address %p segment %u", address, segment);
+    // 所有被 trace 的调用追加写入同一个文件，回调写入环形缓冲区，由写线程边跑边落盘
     std::string data = get_data_path(gContext); // 获取日志文件的路径
-    out.open(data + "/trace_log.txt", std::ios::out); // 打开或创建日志文件
-    out << vm_->logbuf.str(); // 将虚拟机日志缓冲区的内容写入文件
-    out.close(); // 关闭文件
+    bool binary = g_trace_config.binary();
+    const char *name = g_trace_config.granularity == TRACE_PROFILE ? "/trace_profile.txt"
+                       : binary ? "/trace_log.bin" : "/trace_log.txt";
+    bool durable = g_trace_config.durable && g_trace_config.stream.empty();
+    std::string path = data + name + (durable ? ".mmap" : g_trace_config.compress ? ".lz" : "");
+    // 覆盖率模式不写文件；流式导出在采集端连接之前打不开输出，这次调用不算 trace
+    bool traced = g_trace_config.granularity == TRACE_COVERAGE || traceSession().open(path, g_trace_config);
+    if (traced) {
+        trace_call(address, ctx, segment);
+    }
+    traceSession().finish(address, g_trace_config.policy, traced);
+    t_in_trace = false;
 
     // 记录并输出函数执行时间
-    LOGT("Read %ld times cost = %lfs\n", number, (double)(get_tick_count64() - now) / 1000);
+    LOGT("segment %u cost = %lfs\n", segment, (double)(get_tick_count64() - now) / 1000);
+}
+
+// 挂上 trace hook。VM 从目标地址开始执行，入口处的块必须在 hook 改写指令之前翻译好，之后一直使用缓存中的翻译，
+// 不会执行到 hook 的跳转。同一时间只有一个被 admit 的调用，池中预热的这个 vm 总是空闲的
+static bool install_trace_hook(void *target) {
+    if (!vmPool().warmUp(target, g_trace_config)) {
+        LOGT("failed to warm up vm for %p", target);
+        return false;
+    }
+    return DobbyInstrument(target, vm_handle_add) == 0;
 }
 
 
@@ -126,60 +187,14 @@ const char* tracedemo(){
 }
 
 void test_QBDI() {
-//    DobbyInstrument((void *) (Java_cn_mrack_xposed_nhook_NHook_sign1), vm_handle_add);
-    DobbyInstrument((void *) (Java_cn_mrack_xposed_nhook_NHook_sign1), vm_handle_add);
-//    DobbyInstrument((void *) (tracedemo), vm_handle_add);
+    // 提前创建虚拟机并翻译入口处的块，再挂 hook：第一次命中时不再付出初始化和翻译的开销
+    install_trace_hook((void *) (Java_cn_mrack_xposed_nhook_NHook_sign1));
+//    install_trace_hook((void *) (tracedemo));
     tracedemo();
 
 }
 
 
-unsigned char s[256];
-unsigned char t[256];
-
-
-void swap(unsigned char *p1, unsigned char *p2) {
-    unsigned char t = *p1;
-    *p1 = *p2;
-    *p2 = t;
-}
-
-void rc4_init(unsigned char *key, int key_len) {
-    int i, j = 0;
-
-    //Initial values of both vectors
-    for (i = 0; i < 256; i++) {
-        s[i] = i;
-        t[i] = key[i % key_len];
-    }
-    //Initial permutation
-    for (i = 0; i < 256; i++) {
-        j = (j + s[i] + t[i]) % 256;
-        swap(&s[i], &s[j]);
-    }
-}
-
-void rc4(unsigned char *key, int key_len, char *buff, int len) {
-    int i = 0;
-    unsigned long t1, t2;
-    unsigned char val;
-    unsigned char out;
-    t1 = 0;
-    t2 = 0;
-    rc4_init(key, key_len);
-
-    //process one byte at a time
-    for (i = 0; i < len; i++) {
-        t1 = (t1 + 1) % 256;
-        t2 = (t2 + s[t1]) % 256;
-        swap(&s[t1], &s[t2]);
-        val = (s[t1] + s[t2]) % 256;
-        out = *buff ^ val;
-        *buff = out;
-        buff++;
-    }
-}
-
 void sha1(){
     const std::string input = "abc";
 
@@ -0,0 +1,51 @@
+//
+// Created by Mrack on 2024/4/20.
+//
+
+#include "rc4.h"
+
+unsigned char s[256];
+unsigned char t[256];
+
+
+void swap(unsigned char *p1, unsigned char *p2) {
+    unsigned char t = *p1;
+    *p1 = *p2;
+    *p2 = t;
+}
+
+void rc4_init(unsigned char *key, int key_len) {
+    int i, j = 0;
+
+    //Initial values of both vectors
+    for (i = 0; i < 256; i++) {
+        s[i] = i;
+        t[i] = key[i % key_len];
+    }
+    //Initial permutation
+    for (i = 0; i < 256; i++) {
+        j = (j + s[i] + t[i]) % 256;
+        swap(&s[i], &s[j]);
+    }
+}
+
+void rc4(unsigned char *key, int key_len, char *buff, int len) {
+    int i = 0;
+    unsigned long t1, t2;
+    unsigned char val;
+    unsigned char out;
+    t1 = 0;
+    t2 = 0;
+    rc4_init(key, key_len);
+
+    //process one byte at a time
+    for (i = 0; i < len; i++) {
+        t1 = (t1 + 1) % 256;
+        t2 = (t2 + s[t1]) % 256;
+        swap(&s[t1], &s[t2]);
+        val = (s[t1] + s[t2]) % 256;
+        out = *buff ^ val;
+        *buff = out;
+        buff++;
+    }
+}
@@ -0,0 +1,15 @@
+//
+// Created by agent on 2026/10/17.
+//
+// demo 中的 RC4，从 qbdihook.cpp 移出，主机端的 tools/bench 也用它作为 trace 的负载
+//
+
+#ifndef XPOSEDNHOOK_RC4_H
+#define XPOSEDNHOOK_RC4_H
+
+void rc4_init(unsigned char *key, int key_len);
+
+// 用 key 对 buff 的 len 字节原地加解密
+void rc4(unsigned char *key, int key_len, char *buff, int len);
+
+#endif //XPOSEDNHOOK_RC4_H
@@ -0,0 +1,84 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 写寄存器指向内存的 dump 去重：按 (地址, 类型, 内容) 的 64 位哈希记录最近输出过的 dump，
+// 重复的 dump 只输出一行引用（"Same as dump #N ..." / TRACE_REC_DUMP_REF）。
+// 编号为段内完整输出的字符串 / hexdump 的序号（从 0 开始），trace_render 按同样的顺序计数。
+// 缓存是 4 路组相联、组内 LRU，容量固定，不在回调中分配内存。
+//
+
+#ifndef XPOSEDNHOOK_DUMP_CACHE_H
+#define XPOSEDNHOOK_DUMP_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#define DUMP_CACHE_SETS 256
+#define DUMP_CACHE_WAYS 4
+
+// 内容的 64 位哈希，每次 8 字节
+static inline uint64_t dumpHash(uint64_t address, uint8_t kind, const uint8_t *data, size_t len) {
+    const uint64_t m = 0x9e3779b97f4a7c15ull;
+    uint64_t h = (address ^ ((uint64_t) kind << 56) ^ len) * m;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        h = (h ^ word) * m;
+        h ^= h >> 29;
+    }
+    if (i < len) {
+        uint64_t word = 0;
+        memcpy(&word, data + i, len - i);
+        h = (h ^ word) * m;
+        h ^= h >> 29;
+    }
+    h ^= h >> 32;
+    return h * m;
+}
+
+class DumpCache {
+public:
+    // 新的段：清空缓存，编号从 0 开始
+    void reset() {
+        memset(entries, 0, sizeof(entries));
+        next = 0;
+        clock = 0;
+    }
+
+    // 查找 key：输出过时返回 true，id 为第一次输出时的编号；否则淘汰组内最久未用的一项，
+    // 记录为新的编号 id，返回 false（调用者输出完整的 dump）
+    bool lookup(uint64_t key, uint32_t &id) {
+        Entry *set = entries[(key >> 32) & (DUMP_CACHE_SETS - 1)];
+        Entry *victim = &set[0];
+        ++clock;
+        for (int i = 0; i < DUMP_CACHE_WAYS; ++i) {
+            Entry &entry = set[i];
+            if (entry.used != 0 && entry.key == key) {
+                entry.used = clock;
+                id = entry.id;
+                return true;
+            }
+            if (entry.used < victim->used) {
+                victim = &entry;
+            }
+        }
+        *victim = Entry{key, next, clock};
+        id = next++;
+        return false;
+    }
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t id;
+        uint64_t used;      // 最近一次使用的时间戳，0 为空
+    };
+
+    Entry entries[DUMP_CACHE_SETS][DUMP_CACHE_WAYS] = {};
+    uint32_t next = 0;
+    uint64_t clock = 0;
+};
+
+#endif //XPOSEDNHOOK_DUMP_CACHE_H
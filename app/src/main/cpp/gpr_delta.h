@@ -0,0 +1,142 @@
+//
+// Created by agent on 2026/10/17.
+//
+// GPR 增量编码：当前寄存器与上一次输出的快照按 128 位一组比较，得到变化位图，
+// 只输出位图和变化的寄存器。可选的 FPR 通道同样只输出变化的 V 寄存器 lane。
+// 设备端和主机端 tools 共用，不要引入 android / QBDI 头文件。
+//
+
+#ifndef XPOSEDNHOOK_GPR_DELTA_H
+#define XPOSEDNHOOK_GPR_DELTA_H
+
+#include <cstdint>
+
+#include "trace_record.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 逐条指令模式的增量不含 pc，pc 由 INST_PRE 中的地址给出
+#define TRACE_GPR_PC 33
+#define TRACE_GPR_MASK_ALL ((1ull << TRACE_GPR_COUNT) - 1)
+#define TRACE_GPR_MASK_NO_PC (TRACE_GPR_MASK_ALL & ~(1ull << TRACE_GPR_PC))
+
+#if defined(__aarch64__)
+// 8 个寄存器的变化位图：4 组 64 位比较结果逐级收窄到 8 个字节，再按位权相加
+static inline uint64_t gprDiff8(const uint64_t *cur, const uint64_t *last) {
+    uint32x4_t a = vcombine_u32(vmovn_u64(vceqq_u64(vld1q_u64(cur), vld1q_u64(last))),
+                                vmovn_u64(vceqq_u64(vld1q_u64(cur + 2), vld1q_u64(last + 2))));
+    uint32x4_t b = vcombine_u32(vmovn_u64(vceqq_u64(vld1q_u64(cur + 4), vld1q_u64(last + 4))),
+                                vmovn_u64(vceqq_u64(vld1q_u64(cur + 6), vld1q_u64(last + 6))));
+    uint8x8_t eq = vmovn_u16(vcombine_u16(vmovn_u32(a), vmovn_u32(b)));
+    static const uint8_t weights[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    return (uint8_t) ~vaddv_u8(vand_u8(eq, vld1_u8(weights)));
+}
+#elif defined(__SSE2__)
+// 2 个寄存器的变化位图：SSE2 没有 64 位比较，两个 32 位半都相等才算相等
+static inline uint64_t gprDiff2(const uint64_t *cur, const uint64_t *last) {
+    __m128i eq32 = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cur)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(last)));
+    __m128i eq64 = _mm_and_si128(eq32, _mm_shuffle_epi32(eq32, _MM_SHUFFLE(2, 3, 0, 1)));
+    return ~_mm_movemask_pd(_mm_castsi128_pd(eq64)) & 3;
+}
+#endif
+
+// cur 与 last 中前 TRACE_GPR_COUNT 个寄存器的变化位图
+static inline uint64_t gprDiffMask(const uint64_t *cur, const uint64_t *last) {
+    uint64_t mask = 0;
+    int i = 0;
+#if defined(__aarch64__)
+    for (; i + 8 <= TRACE_GPR_COUNT; i += 8) {
+        mask |= gprDiff8(cur + i, last + i) << i;
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= TRACE_GPR_COUNT; i += 2) {
+        mask |= gprDiff2(cur + i, last + i) << i;
+    }
+#endif
+    for (; i < TRACE_GPR_COUNT; ++i) {
+        mask |= (uint64_t) (cur[i] != last[i]) << i;
+    }
+    return mask;
+}
+
+// 写入 u64 位图 + 变化的寄存器值，并更新 last；select 为参与比较的寄存器
+static inline void putGprDelta(TraceRecordBuilder &rec, const uint64_t *cur, uint64_t *last,
+                               uint64_t select = TRACE_GPR_MASK_ALL) {
+    uint64_t mask = gprDiffMask(cur, last) & select;
+    rec.put<uint64_t>(mask);
+    for (uint64_t bits = mask; bits != 0; bits &= bits - 1) {
+        int i = __builtin_ctzll(bits);
+        rec.put<uint64_t>(cur[i]);
+        last[i] = cur[i];
+    }
+}
+
+// 读取增量并更新寄存器状态
+static inline void applyGprDelta(TracePayload &p, uint64_t *regs) {
+    uint64_t mask = p.get<uint64_t>() & TRACE_GPR_MASK_ALL;
+    for (uint64_t bits = mask; bits != 0; bits &= bits - 1) {
+        regs[__builtin_ctzll(bits)] = p.get<uint64_t>();
+    }
+}
+
+// ---------------- FPR 通道 ----------------
+// 只比较指令操作数中的 V 寄存器，每个寄存器按两个 64 位 lane 输出变化的部分
+
+// 一个 V 寄存器中变化的 lane：第 0 位为低 64 位，第 1 位为高 64 位
+static inline uint32_t fprLaneDiff(const uint64_t *cur, const uint64_t *last) {
+#if defined(__aarch64__)
+    uint64x2_t eq = vceqq_u64(vld1q_u64(cur), vld1q_u64(last));
+    return (uint32_t) (~vgetq_lane_u64(eq, 0) & 1) | (uint32_t) ((~vgetq_lane_u64(eq, 1) & 1) << 1);
+#elif defined(__SSE2__)
+    return (uint32_t) gprDiff2(cur, last);
+#else
+    return (uint32_t) (cur[0] != last[0]) | (uint32_t) (cur[1] != last[1]) << 1;
+#endif
+}
+
+// 一个 V 寄存器的变化
+struct FprChange {
+    uint8_t reg;
+    uint8_t lanes;
+    uint64_t value[2];
+};
+
+// regs 中的 V 寄存器与 last 比较，变化的写入 out 并更新 last，返回变化的寄存器个数。
+// fpr 为 FPRState 开头的 v0-v31，每个 16 字节
+static inline size_t collectFprChanges(const uint64_t *fpr, uint64_t (*last)[2], uint32_t regs, FprChange *out) {
+    size_t count = 0;
+    for (uint32_t bits = regs; bits != 0; bits &= bits - 1) {
+        int reg = __builtin_ctz(bits);
+        const uint64_t *cur = fpr + reg * 2;
+        uint32_t lanes = fprLaneDiff(cur, last[reg]);
+        if (lanes == 0) {
+            continue;
+        }
+        out[count++] = {(uint8_t) reg, (uint8_t) lanes, {cur[0], cur[1]}};
+        last[reg][0] = cur[0];
+        last[reg][1] = cur[1];
+    }
+    return count;
+}
+
+// TRACE_REC_FPR 的内容：u8 kind + count * (u8 reg, u8 lanes, 变化的 lane)
+static inline void putFprChanges(TraceRecordBuilder &rec, uint8_t kind, const FprChange *changes, size_t count) {
+    rec.begin(TRACE_REC_FPR, count);
+    rec.put<uint8_t>(kind);
+    for (size_t i = 0; i < count; ++i) {
+        rec.put<uint8_t>(changes[i].reg);
+        rec.put<uint8_t>(changes[i].lanes);
+        for (int lane = 0; lane < 2; ++lane) {
+            if (changes[i].lanes & (1 << lane)) {
+                rec.put<uint64_t>(changes[i].value[lane]);
+            }
+        }
+    }
+}
+
+#endif //XPOSEDNHOOK_GPR_DELTA_H
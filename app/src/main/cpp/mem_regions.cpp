@@ -0,0 +1,167 @@
+//
+// Created by agent on 2026/10/17.
+//
+
+#include "mem_regions.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dlfcn.h>
+#include <sys/syscall.h>
+
+// 快照未命中时两次重新加载的最小间隔
+#define MISS_RELOAD_INTERVAL_MS 50
+// 小于该值的寄存器值不当作指针，不触发重新加载
+#define MIN_POINTER 0x10000
+// 未映射地址与相邻匿名映射的最大距离，超出时认为不是新分配的内存（例如随机数、哈希值），不重新加载
+#define ANON_GAP_MAX (64ULL << 20)
+// 用户空间地址上限，之上的映射（例如 x86 的 vsyscall）不参与计算 mmap 区域
+#define USER_ADDRESS_END (1ULL << 48)
+
+#define PAGE_SHIFT_4K 12
+
+static uint64_t nowMs() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+bool MemoryRegions::load() {
+    FILE *fp = fopen("/proc/self/maps", "re");
+    if (fp == nullptr) {
+        return false;
+    }
+    regions.clear();
+    char line[4096];
+    while (fgets(line, sizeof(line), fp)) {
+        uint64_t start, end;
+        char perms[5] = {};
+        int pathStart = 0;
+        if (sscanf(line, "%" SCNx64 "-%" SCNx64 " %4s %*s %*s %*s %n", &start, &end, perms, &pathStart) != 3) {
+            continue;
+        }
+        bool readable = perms[0] == 'r';
+        const char *path = pathStart > 0 ? line + pathStart : "";
+        bool anonymous = *path == '\n' || *path == '\0' || strncmp(path, "[heap]", 6) == 0 ||
+                         strncmp(path, "[anon:", 6) == 0;
+        // 首尾相接且权限、类型相同的映射合并，readableBytes 一次查找即可得到连续长度
+        if (!regions.empty() && regions.back().end == start && regions.back().readable == readable &&
+            regions.back().anonymous == anonymous) {
+            regions.back().end = end;
+        } else {
+            regions.push_back({start, end, readable, anonymous});
+        }
+    }
+    fclose(fp);
+    std::sort(regions.begin(), regions.end(), [](const Region &a, const Region &b) { return a.start < b.start; });
+    // 可执行文件 / brk 堆与 mmap 区域之间是用户空间中最大的空洞
+    uint64_t widest = 0;
+    mmapFloor = 0;
+    for (size_t i = 1; i < regions.size() && regions[i].start < USER_ADDRESS_END; ++i) {
+        if (regions[i].start - regions[i - 1].end > widest) {
+            widest = regions[i].start - regions[i - 1].end;
+            mmapFloor = regions[i].start;
+        }
+    }
+    dirty = false;
+    generation++;
+    lastLoadMs = nowMs();
+    return true;
+}
+
+const MemoryRegions::Region *MemoryRegions::find(uint64_t address) {
+    if (dirty) {
+        load();
+    }
+    uint64_t page = address >> PAGE_SHIFT_4K;
+    PageSlot &slot = pageCache[page & (sizeof(pageCache) / sizeof(pageCache[0]) - 1)];
+    if (slot.page == page && slot.generation == generation) {
+        return slot.region < 0 ? nullptr : &regions[slot.region];
+    }
+
+    auto it = std::upper_bound(regions.begin(), regions.end(), address,
+                               [](uint64_t addr, const Region &r) { return addr < r.start; });
+    int32_t index = -1;
+    if (it != regions.begin() && address < (it - 1)->end) {
+        index = static_cast<int32_t>(it - 1 - regions.begin());
+    }
+    slot = {page, index, generation};
+    return index < 0 ? nullptr : &regions[index];
+}
+
+bool MemoryRegions::inAnonymousGap(uint64_t address) const {
+    if (address < mmapFloor && mmapFloor - address <= ANON_GAP_MAX) {
+        return true;
+    }
+    auto it = std::upper_bound(regions.begin(), regions.end(), address,
+                               [](uint64_t addr, const Region &r) { return addr < r.start; });
+    if (it != regions.end() && it->anonymous && it->start - address <= ANON_GAP_MAX) {
+        return true;
+    }
+    if (it != regions.begin()) {
+        const Region &prev = *(it - 1);
+        return prev.anonymous && address >= prev.end && address - prev.end <= ANON_GAP_MAX;
+    }
+    return false;
+}
+
+bool MemoryRegions::reloadOnMiss(uint64_t address) {
+    // 映射调用已经通过 invalidate 让快照失效；其余的未命中只有落在匿名映射附近时才可能是未观察到的新映射
+    if (address < MIN_POINTER || !inAnonymousGap(address)) {
+        return false;
+    }
+    if (nowMs() - lastLoadMs < MISS_RELOAD_INTERVAL_MS) {
+        return false;
+    }
+    return load();
+}
+
+bool MemoryRegions::isMapped(uint64_t address) {
+    if (find(address) != nullptr) {
+        return true;
+    }
+    if (!reloadOnMiss(address)) {
+        return false;
+    }
+    return find(address) != nullptr;
+}
+
+size_t MemoryRegions::readableBytes(uint64_t address, size_t max) {
+    const Region *region = find(address);
+    if (region == nullptr || !region->readable) {
+        return 0;
+    }
+    return std::min<uint64_t>(max, region->end - address);
+}
+
+bool MemoryRegions::isMappingCall(uint64_t target) {
+    static const uint64_t functions[] = {
+            reinterpret_cast<uint64_t>(dlsym(RTLD_DEFAULT, "mmap")),
+            reinterpret_cast<uint64_t>(dlsym(RTLD_DEFAULT, "mmap64")),
+            reinterpret_cast<uint64_t>(dlsym(RTLD_DEFAULT, "munmap")),
+            reinterpret_cast<uint64_t>(dlsym(RTLD_DEFAULT, "mprotect")),
+            reinterpret_cast<uint64_t>(dlsym(RTLD_DEFAULT, "mremap")),
+    };
+    for (uint64_t function: functions) {
+        if (function != 0 && function == target) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MemoryRegions::isMappingSyscall(uint64_t number) {
+    switch (number) {
+        case SYS_mmap:
+        case SYS_munmap:
+        case SYS_mprotect:
+        case SYS_mremap:
+        case SYS_brk:
+            return true;
+        default:
+            return false;
+    }
+}
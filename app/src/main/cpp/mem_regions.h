@@ -0,0 +1,72 @@
+//
+// Created by agent on 2026/10/17.
+//
+// /proc/self/maps 快照：判断寄存器值是否指向已映射 / 可读的内存，不再每次调用 mincore + process_vm_readv。
+// 观察到 mmap / munmap / mprotect / mremap 后标记失效，下次查询前重新加载。
+//
+
+#ifndef XPOSEDNHOOK_MEM_REGIONS_H
+#define XPOSEDNHOOK_MEM_REGIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class MemoryRegions {
+public:
+    // 重新加载快照
+    bool load();
+
+    // 内存映射可能已经改变，下次查询前重新加载
+    void invalidate() { dirty = true; }
+
+    // 地址所在页是否已映射（不论权限），与原来 mincore 的判断一致
+    bool isMapped(uint64_t address);
+
+    // 从 address 开始连续可读的字节数，最多 max
+    size_t readableBytes(uint64_t address, size_t max);
+
+    // 目标地址是否为会改变内存映射的 libc 函数（mmap / munmap / mprotect / mremap）
+    static bool isMappingCall(uint64_t target);
+
+    // 是否为会改变内存映射的系统调用号
+    static bool isMappingSyscall(uint64_t number);
+
+    // 快照重新加载的次数
+    uint64_t reloads() const { return generation; }
+
+private:
+    struct Region {
+        uint64_t start;
+        uint64_t end;
+        bool readable;
+        bool anonymous;     // 匿名映射：无文件路径、[heap]、[anon:...]
+    };
+
+    // 查找地址所在区间，未映射返回 nullptr
+    const Region *find(uint64_t address);
+
+    // 未映射的地址是否紧邻匿名映射（堆、malloc 的 mmap 区域）或位于 mmap 区域下方（新映射自顶向下分配）：
+    // 未观察到的映射变化只会出现在这些位置
+    bool inAnonymousGap(uint64_t address) const;
+
+    // 未命中快照且地址落在匿名映射附近时按时间限频重新加载，覆盖未观察到的映射变化（例如 malloc 内部的 mmap）
+    bool reloadOnMiss(uint64_t address);
+
+    std::vector<Region> regions;
+    bool dirty = true;
+    uint32_t generation = 0;
+    uint64_t lastLoadMs = 0;
+    // mmap 区域的最低地址：用户空间中最大的空洞之上的第一个映射
+    uint64_t mmapFloor = 0;
+
+    // 页号 -> 区间下标 的直接映射缓存，命中时不用二分查找
+    struct PageSlot {
+        uint64_t page;
+        int32_t region;     // -1 表示未映射
+        uint32_t generation;
+    };
+    PageSlot pageCache[256] = {};
+};
+
+#endif //XPOSEDNHOOK_MEM_REGIONS_H
@@ -0,0 +1,156 @@
+//
+// Created by agent on 2026/10/17.
+//
+
+#include "module_map.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <link.h>
+
+ModuleMap &moduleMap() {
+    static ModuleMap instance;
+    return instance;
+}
+
+uint32_t ModuleMap::intern(const char *path) {
+    auto it = ids.find(path);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    const char *slash = strrchr(path, '/');
+    uint32_t id = entries.size();
+    entries.push_back({path, slash ? slash + 1 : path, 0});
+    ids.emplace(path, id);
+    return id;
+}
+
+uint64_t ModuleMap::loaderSignature() {
+    uint64_t value = 0;
+    dl_iterate_phdr([](struct dl_phdr_info *info, size_t, void *data) {
+        auto value = static_cast<uint64_t *>(data);
+        *value = (*value ^ info->dlpi_addr) * 0x100000001b3ULL + 1;
+        return 0;
+    }, &value);
+    return value;
+}
+
+bool ModuleMap::refresh() {
+    uint64_t current = loaderSignature();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (loads.load(std::memory_order_relaxed) != 0 && current == signature) {
+            return false;
+        }
+    }
+    return load();
+}
+
+bool ModuleMap::load() {
+    // 先取得特征值再解析 maps：解析期间加载的模块会在下一次 refresh 时发现
+    uint64_t current = loaderSignature();
+    FILE *fp = fopen("/proc/self/maps", "re");
+    if (fp == nullptr) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    signature = current;
+    ranges.clear();
+    for (auto &entry: entries) {
+        entry.base = 0;
+    }
+
+    char line[4096];
+    while (fgets(line, sizeof(line), fp)) {
+        uint64_t start, end;
+        int pathOffset = 0;
+        if (sscanf(line, "%" SCNx64 "-%" SCNx64 " %*s %*s %*s %*s %n", &start, &end, &pathOffset) < 2 ||
+            pathOffset == 0) {
+            continue;
+        }
+        char *path = line + pathOffset;
+        path[strcspn(path, "\n")] = 0;
+        if (*path == 0) {
+            continue;   // 匿名映射不属于任何模块
+        }
+
+        uint32_t id = intern(path);
+        if (entries[id].base == 0 || start < entries[id].base) {
+            entries[id].base = start;
+        }
+        // 同一模块首尾相接的映射合并为一个区间
+        if (!ranges.empty() && ranges.back().module == id && ranges.back().end == start) {
+            ranges.back().end = end;
+        } else {
+            ranges.push_back({start, end, id});
+        }
+    }
+    fclose(fp);
+
+    std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) { return a.start < b.start; });
+    loads.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+bool ModuleMap::lookup(uint64_t address, uint32_t &module, uint64_t &offset) const {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), address,
+                               [](uint64_t addr, const Range &r) { return addr < r.start; });
+    if (it == ranges.begin()) {
+        return false;
+    }
+    --it;
+    if (address >= it->end) {
+        return false;
+    }
+    module = it->module;
+    offset = address - entries[module].base;
+    return true;
+}
+
+std::string ModuleMap::name(uint32_t module) const {
+    std::lock_guard<std::mutex> guard(lock);
+    return module < entries.size() ? entries[module].name : std::string();
+}
+
+uint64_t ModuleMap::base(uint32_t module) const {
+    std::lock_guard<std::mutex> guard(lock);
+    return module < entries.size() ? entries[module].base : 0;
+}
+
+std::string ModuleMap::path(uint32_t module) const {
+    std::lock_guard<std::mutex> guard(lock);
+    return module < entries.size() ? entries[module].path : std::string();
+}
+
+bool ModuleMap::find(const std::string &name, uint32_t &module) const {
+    std::lock_guard<std::mutex> guard(lock);
+    for (uint32_t id = 0; id < entries.size(); ++id) {
+        if (entries[id].base != 0 && (entries[id].name == name || entries[id].path == name)) {
+            module = id;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ModuleMap::extent(uint32_t module, uint64_t &start, uint64_t &end) const {
+    std::lock_guard<std::mutex> guard(lock);
+    bool found = false;
+    for (const auto &range: ranges) {
+        if (range.module != module) {
+            continue;
+        }
+        if (!found || range.start < start) {
+            start = range.start;
+        }
+        if (!found || range.end > end) {
+            end = range.end;
+        }
+        found = true;
+    }
+    return found;
+}
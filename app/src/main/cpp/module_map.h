@@ -0,0 +1,79 @@
+//
+// Created by agent on 2026/10/17.
+//
+// /proc/self/maps 的模块区间表：同一模块相邻的映射合并为一个区间，按起始地址排序后二分查找。
+// 查询结果是 模块 id + 模块内偏移，不再为每个地址缓存一个字符串。
+// 动态链接器加载 / 卸载模块后由 refresh 重新解析，generation 变化时使用者更新依赖模块地址的状态。
+//
+
+#ifndef XPOSEDNHOOK_MODULE_MAP_H
+#define XPOSEDNHOOK_MODULE_MAP_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ModuleMap {
+public:
+    // 重新解析 /proc/self/maps。模块 id 按路径分配，重新加载后保持不变
+    bool load();
+
+    // 动态链接器中的模块（dl_iterate_phdr 的数量和加载基址）与上次 load 时不同时重新加载，返回是否重新加载
+    bool refresh();
+
+    // 每次 load 加一
+    uint32_t generation() const { return loads.load(std::memory_order_acquire); }
+
+    // 查找地址所在模块，offset 相对模块加载基址（第一个映射的起始地址）
+    bool lookup(uint64_t address, uint32_t &module, uint64_t &offset) const;
+
+    // 模块文件名（不含目录）
+    std::string name(uint32_t module) const;
+
+    // 模块加载基址
+    uint64_t base(uint32_t module) const;
+
+    // 模块完整路径
+    std::string path(uint32_t module) const;
+
+    // 按文件名（或完整路径）查找当前已映射的模块
+    bool find(const std::string &name, uint32_t &module) const;
+
+    // 模块所有映射覆盖的地址范围 [start, end)
+    bool extent(uint32_t module, uint64_t &start, uint64_t &end) const;
+
+private:
+    // base 为 0 表示当前未映射
+    struct Module {
+        std::string path;
+        std::string name;
+        uint64_t base;
+    };
+
+    struct Range {
+        uint64_t start;
+        uint64_t end;
+        uint32_t module;
+    };
+
+    uint32_t intern(const char *path);
+
+    // 当前已加载模块的特征值
+    static uint64_t loaderSignature();
+
+    mutable std::mutex lock;
+    std::vector<Range> ranges;
+    std::vector<Module> entries;
+    std::unordered_map<std::string, uint32_t> ids;
+    // 上次 load 时的 loaderSignature
+    uint64_t signature = 0;
+    std::atomic<uint32_t> loads{0};
+};
+
+// 进程内共用的模块表
+ModuleMap &moduleMap();
+
+#endif //XPOSEDNHOOK_MODULE_MAP_H
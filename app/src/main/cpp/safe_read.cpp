@@ -0,0 +1,85 @@
+//
+// Created by agent on 2026/10/17.
+//
+
+#include "safe_read.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <csignal>
+#include <cstring>
+
+// 按 4K 分段拷贝，页大小为 16K 时同样正确，只是分段更细
+#define SAFE_READ_PAGE 4096
+
+struct ReadGuard {
+    sigjmp_buf env;
+    volatile bool active;
+};
+
+// 每个线程独立的保护区；safeRead 先写 active，保证 TLS 在异常发生前已经分配
+static thread_local ReadGuard guard;
+
+static struct sigaction oldSegv;
+static struct sigaction oldBus;
+
+static void faultHandler(int sig, siginfo_t *info, void *context) {
+    if (guard.active) {
+        guard.active = false;
+        // 不恢复信号掩码：处理器以 SA_NODEFER 安装，跳回后 SIGSEGV 也未被屏蔽，省掉一次 sigprocmask
+        siglongjmp(guard.env, 1);
+    }
+
+    // 不是我们的读取，交给之前的处理器
+    struct sigaction *old = sig == SIGSEGV ? &oldSegv : &oldBus;
+    if (old->sa_flags & SA_SIGINFO) {
+        if (old->sa_sigaction != nullptr) {
+            old->sa_sigaction(sig, info, context);
+        }
+    } else if (old->sa_handler == SIG_DFL) {
+        // 恢复默认处理，返回后重新执行出错的指令，按默认方式结束进程
+        struct sigaction dfl{};
+        dfl.sa_handler = SIG_DFL;
+        sigaction(sig, &dfl, nullptr);
+    } else if (old->sa_handler != SIG_IGN) {
+        old->sa_handler(sig);
+    }
+}
+
+void safeReadInstall() {
+    static bool installed = [] {
+        struct sigaction sa{};
+        sa.sa_sigaction = faultHandler;
+        sa.sa_flags = SA_SIGINFO | SA_NODEFER | SA_ONSTACK;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGSEGV, &sa, &oldSegv);
+        sigaction(SIGBUS, &sa, &oldBus);
+        return true;
+    }();
+    (void) installed;
+}
+
+size_t safeRead(void *buffer, uint64_t address, size_t len) {
+    auto dst = static_cast<uint8_t *>(buffer);
+    // 异常跳回后仍要用到，必须是 volatile
+    volatile size_t done = 0;
+
+    guard.active = false;
+    if (sigsetjmp(guard.env, 0) == 0) {
+        guard.active = true;
+        while (done < len) {
+            uint64_t cur = address + done;
+            size_t chunk = std::min<size_t>(len - done, SAFE_READ_PAGE - (cur & (SAFE_READ_PAGE - 1)));
+            memcpy(dst + done, reinterpret_cast<const void *>(cur), chunk);
+            done = done + chunk;
+        }
+    }
+    guard.active = false;
+    return done;
+}
+
+void safeReadScatter(SafeReadSlot *slots, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        slots[i].read = slots[i].length > 0 ? safeRead(slots[i].buffer, slots[i].address, slots[i].length) : 0;
+    }
+}
@@ -0,0 +1,31 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 进程内安全读内存：直接 memcpy，读到未映射 / 不可读的页时由线程局部的 SIGSEGV / SIGBUS
+// 保护跳回，返回已读到的字节数，不再为每次读取调用 process_vm_readv。
+//
+
+#ifndef XPOSEDNHOOK_SAFE_READ_H
+#define XPOSEDNHOOK_SAFE_READ_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 安装 SIGSEGV / SIGBUS 处理器，多次调用只安装一次；不在保护区内的异常交给之前的处理器
+void safeReadInstall();
+
+// 从 address 读取最多 len 字节，按页拷贝，遇到异常时停止，返回实际读到的字节数
+size_t safeRead(void *buffer, uint64_t address, size_t len);
+
+// 一次读取中的一个目标
+struct SafeReadSlot {
+    uint64_t address;
+    uint8_t *buffer;
+    size_t length;      // 要读取的字节数
+    size_t read;        // 实际读到的字节数
+};
+
+// 依次读取多个目标，某个目标出错不影响其余目标
+void safeReadScatter(SafeReadSlot *slots, size_t count);
+
+#endif //XPOSEDNHOOK_SAFE_READ_H
@@ -0,0 +1,70 @@
+//
+// Created by agent on 2026/10/17.
+//
+
+#include "stack_pool.h"
+#include "utils.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+StackPool &stackPool() {
+    static StackPool instance;
+    return instance;
+}
+
+// 部分 arm64 设备的页大小为 16K
+static size_t pageSize() {
+    static const size_t size = (size_t) sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+static VirtualStack *mapStack(size_t size, bool populate) {
+    size_t guard = pageSize();
+    size_t total = size + guard;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK | (populate ? MAP_POPULATE : 0);
+    void *mapping = mmap(nullptr, total, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mapping == MAP_FAILED) {
+        LOGE("stack pool: mmap %zu bytes failed", total);
+        return nullptr;
+    }
+    if (mprotect(mapping, guard, PROT_NONE) != 0) {
+        LOGE("stack pool: guard page mprotect failed");
+        munmap(mapping, total);
+        return nullptr;
+    }
+    return new VirtualStack{(uint8_t *) mapping, total, size};
+}
+
+VirtualStack *StackPool::acquire(size_t size, bool populate) {
+    size = (size + pageSize() - 1) & ~(pageSize() - 1);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto &stacks = idle[size];
+        if (!stacks.empty()) {
+            VirtualStack *stack = stacks.back();
+            stacks.pop_back();
+            return stack;
+        }
+    }
+    return mapStack(size, populate);
+}
+
+void StackPool::release(VirtualStack *stack) {
+    std::lock_guard<std::mutex> guard(lock);
+    idle[stack->size].push_back(stack);
+}
+
+bool StackPool::reserve(size_t size, bool populate) {
+    VirtualStack *stack = acquire(size, populate);
+    if (stack == nullptr) {
+        return false;
+    }
+    release(stack);
+    return true;
+}
+
+void useVirtualStack(QBDI::GPRState *state, const VirtualStack *stack) {
+    QBDI_GPR_SET(state, QBDI::REG_SP, (QBDI::rword) stack->top());
+    QBDI_GPR_SET(state, QBDI::REG_BP, QBDI_GPR_GET(state, QBDI::REG_SP));
+}
@@ -0,0 +1,52 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace 用的虚拟栈池：mmap 保留整块地址空间（MAP_NORESERVE，用到的页才占用内存），
+// 最低处一页为保护页，栈溢出时直接 SIGSEGV 而不是写坏相邻的堆。
+// 用完归还后按大小复用，trace 路径上不再分配 / 释放栈。
+//
+
+#ifndef XPOSEDNHOOK_STACK_POOL_H
+#define XPOSEDNHOOK_STACK_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "QBDI.h"
+
+struct VirtualStack {
+    uint8_t *mapping;       // mmap 的起始地址，即保护页
+    size_t mappingSize;
+    size_t size;            // 可用大小，不含保护页
+
+    // 栈顶（最高地址），栈向下增长
+    uint8_t *top() const { return mapping + mappingSize; }
+};
+
+class StackPool {
+public:
+    // 取出一个至少 size 字节的栈，没有空闲的时新建；populate 为 true 时新建的栈预先分配所有页，
+    // 执行中不再缺页（复用的栈用过的页本来就在）。失败返回 nullptr
+    VirtualStack *acquire(size_t size, bool populate);
+
+    // 归还栈，之后 acquire 同样大小时复用
+    void release(VirtualStack *stack);
+
+    // 预先建好一个空闲的栈
+    bool reserve(size_t size, bool populate);
+
+private:
+    std::mutex lock;
+    // 按页对齐后的可用大小 -> 空闲的栈
+    std::unordered_map<size_t, std::vector<VirtualStack *>> idle;
+};
+
+// 进程内共用的栈池
+StackPool &stackPool();
+
+// 让 VM 在 stack 上执行：sp 和 x29 指向栈顶，与 QBDI::allocateVirtualStack 一致
+void useVirtualStack(QBDI::GPRState *state, const VirtualStack *stack);
+
+#endif //XPOSEDNHOOK_STACK_POOL_H
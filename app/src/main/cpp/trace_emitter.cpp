@@ -0,0 +1,554 @@
+//
+// Created by agent on 2026/10/17.
+//
+
+#include "trace_emitter.h"
+#include "gpr_delta.h"
+#include "trace_format.h"
+#include "trace_stats.h"
+
+#include <algorithm>
+#include <cstring>
+
+// "名称=0x值 "
+static inline char *formatReg(char *out, const TracedReg &reg, uint64_t value) {
+    out = formatBytes(out, reg.name, reg.nameLen);
+    out = formatLiteral(out, "=0x");
+    out = formatHex(out, value);
+    *out++ = ' ';
+    return out;
+}
+
+// 一个寄存器 "名称=0x值 " 的最大长度
+#define TEXT_REG_MAX (sizeof(TracedReg::name) + 3 + 16 + 1)
+
+// ---------------- 模板 ----------------
+
+InstTemplate *TraceEmitter::prepare(const InstInfo &info, class vm *owner) {
+    auto &slot = templates[info.address];
+    if (slot) {
+        return slot.get();
+    }
+    slot.reset(new InstTemplate());
+    InstTemplate *tpl = slot.get();
+    tpl->owner = owner;
+    tpl->address = info.address;
+    tpl->accessMemory = options.traceMemory && info.mayAccessMemory;
+    if (options.traceRegisters) {
+        tpl->reads = info.reads;
+        tpl->writes = info.writes;
+    }
+    tpl->fprReads = info.fprReads;
+    tpl->fprWrites = info.fprWrites;
+    if (probes.size() < tpl->writes.size()) {
+        probes.resize(tpl->writes.size());
+    }
+
+    if (options.binary) {
+        // 预翻译时还没有 sink，在 begin 或第一次执行时输出
+        encodeInstDef(tpl, info);
+        if (sink != nullptr) {
+            defineTemplate(tpl);
+        }
+        return tpl;
+    }
+
+    // 输出符号名和偏移量，如果没有符号，则输出 "模块[0x偏移]"，都没有时仅输出地址和反汇编信息
+    std::string &head = tpl->head;
+    char number[16];
+    if (info.symbol != nullptr || info.module >= 0) {
+        head = info.symbol != nullptr ? info.symbol : info.moduleName;
+        head += "[0x";
+        head.append(number, formatHex(number, info.offset));
+        head += "]:0x";
+    } else {
+        head = "0x";
+    }
+    head.append(number, formatHex(number, info.address));
+    head += ": ";
+    head += info.disassembly;
+    return tpl;
+}
+
+// 编码指令定义：符号、反汇编和读写寄存器名，保存在模板中，由 defineTemplate 输出
+void TraceEmitter::encodeInstDef(InstTemplate *tpl, const InstInfo &info) {
+    auto &rec = record;
+    uint8_t symbolKind = TRACE_SYM_NONE;
+    uint32_t module = 0;
+    tpl->defModule = -1;
+    if (info.symbol != nullptr) {
+        symbolKind = TRACE_SYM_QBDI;
+    } else if (info.module >= 0) {
+        symbolKind = TRACE_SYM_MODULE;
+        module = (uint32_t) info.module;
+        tpl->defModule = info.module;
+        // 模块重新加载后基址可能变化，以最近一次插桩时为准
+        rec.begin(TRACE_REC_MODULE);
+        rec.put<uint32_t>(module);
+        rec.put<uint64_t>(info.moduleBase);
+        rec.putString16(info.moduleName.c_str());
+        moduleRecords[module].assign(reinterpret_cast<const char *>(rec.data()), rec.size());
+    }
+
+    rec.begin(TRACE_REC_INST_DEF);
+    rec.put<uint64_t>(info.address);
+    rec.put<uint64_t>(info.offset);
+    rec.put<uint32_t>(module);
+    rec.put<uint8_t>(symbolKind);
+    rec.put<uint8_t>(info.reads.size());
+    rec.put<uint8_t>(info.writes.size());
+    rec.putString16(info.symbol);
+    rec.putString16(info.disassembly);
+    for (const auto &reg: info.reads) {
+        rec.putString8(reg.name);
+    }
+    for (const auto &reg: info.writes) {
+        rec.putString8(reg.name);
+    }
+    // 块模式展开时按下标从寄存器状态中取值
+    rec.put<uint8_t>(info.size);
+    for (const auto &reg: info.reads) {
+        rec.put<uint8_t>(reg.ctxIdx);
+    }
+    for (const auto &reg: info.writes) {
+        rec.put<uint8_t>(reg.ctxIdx);
+    }
+    tpl->def.assign(reinterpret_cast<const char *>(rec.data()), rec.size());
+}
+
+// 输出模板的 INST_DEF 及其引用的模块，每个 trace 文件中每个地址只输出一次
+void TraceEmitter::defineTemplate(InstTemplate *tpl) {
+    if (tpl->epoch == epoch) {
+        return;
+    }
+    tpl->epoch = epoch;
+    if (tpl->defModule >= 0) {
+        auto module = (uint32_t) tpl->defModule;
+        if (module >= modulesDefined.size()) {
+            modulesDefined.resize(module + 1);
+        }
+        if (!modulesDefined[module]) {
+            modulesDefined[module] = true;
+            const std::string &def = moduleRecords[module];
+            sink->write(def.data(), def.size());
+        }
+    }
+    sink->write(tpl->def.data(), tpl->def.size());
+}
+
+// ---------------- 段 ----------------
+
+void TraceEmitter::begin(TraceSink *sink, uint32_t segment, TraceSink *index, uint64_t streamBase) {
+    this->sink = sink;
+    this->segment = segment;
+    indexSink = sink != nullptr ? index : nullptr;
+    this->streamBase = streamBase;
+    executed = 0;
+    nextCheckpoint = 0;
+    ++epoch;
+    textLen = 0;
+    dumps.reset();
+    modulesDefined.clear();
+    memset(lastGpr, 0, sizeof(lastGpr));
+    memset(lastFpr, 0, sizeof(lastFpr));
+}
+
+void TraceEmitter::writeSegmentBegin(uint64_t target, uint64_t timeMs) {
+    if (indexSink != nullptr) {
+        record.begin(TRACE_IDX_SEGMENT);
+        record.put<uint32_t>(segment);
+        record.put<uint64_t>(streamOffset());
+        emitIndex();
+    }
+    if (!options.binary) {
+        textCommit(formatSegmentBegin(textReserve(SEGMENT_LINE_MAX), segment, target, timeMs));
+        flushText();
+        return;
+    }
+    record.begin(TRACE_REC_SEGMENT);
+    record.put<uint32_t>(segment);
+    record.put<uint16_t>(options.gprDelta ? TRACE_FLAG_GPR_DELTA : 0);
+    record.put<uint64_t>(target);
+    record.put<uint64_t>(timeMs);
+    emitRecord();
+
+    // 块模式展开时需要块内每条指令的 INST_DEF，而块的回调中不逐条检查，这里一次输出已有的模板；
+    // 逐条指令模式在指令第一次执行时输出
+    if (options.blocks) {
+        for (auto &item: templates) {
+            defineTemplate(item.second.get());
+        }
+    }
+}
+
+void TraceEmitter::writeSegmentEnd(uint64_t durationUs) {
+    if (options.binary) {
+        record.begin(TRACE_REC_SEGMENT_END);
+        record.put<uint32_t>(segment);
+        record.put<uint64_t>(durationUs);
+        emitRecord();
+        return;
+    }
+    textCommit(formatSegmentEnd(textReserve(SEGMENT_LINE_MAX), segment, durationUs));
+    flushText();
+}
+
+void TraceEmitter::writeText(const char *data, size_t len) {
+    flushText();
+    sink->write(data, len);
+}
+
+void TraceEmitter::end() {
+    if (indexSink != nullptr) {
+        writeAddressTable();
+        record.begin(TRACE_IDX_SEGMENT_END);
+        record.put<uint32_t>(segment);
+        record.put<uint64_t>(executed);
+        emitIndex();
+        indexSink = nullptr;
+    }
+    sink = nullptr;
+}
+
+// ---------------- 文本缓冲 ----------------
+
+void TraceEmitter::flushText() {
+    if (textLen > 0) {
+        StatScope stat(options.stats, STAT_EMIT);
+        sink->write(text, textLen);
+        textLen = 0;
+    }
+}
+
+// 保证文本缓冲中还有 n 字节空间（n 不超过缓冲区大小），不够时先写出已有内容，返回写入位置
+char *TraceEmitter::textReserve(size_t n) {
+    if (textLen + n > sizeof(text)) {
+        flushText();
+    }
+    return text + textLen;
+}
+
+// 追加任意长度的内容，超过缓冲区大小时直接写入 sink
+void TraceEmitter::textAppend(const char *data, size_t len) {
+    if (len > sizeof(text)) {
+        flushText();
+        StatScope stat(options.stats, STAT_EMIT);
+        sink->write(data, len);
+        return;
+    }
+    textCommit(formatBytes(textReserve(len), data, len));
+}
+
+// 将 record 中拼好的记录写入 sink
+void TraceEmitter::emitRecord() {
+    StatScope stat(options.stats, STAT_EMIT);
+    sink->write(record.data(), record.size());
+}
+
+// ---------------- 索引 ----------------
+// 检查点和地址表写入 indexSink，偏移为 trace 文件中即将写出的位置
+
+uint64_t TraceEmitter::streamOffset() const {
+    return streamBase + sink->position() + textLen;
+}
+
+void TraceEmitter::emitIndex() {
+    indexSink->write(record.data(), record.size());
+}
+
+// 检查点：当前的指令序号、偏移和执行前的寄存器
+void TraceEmitter::writeCheckpoint(const uint64_t *gpr) {
+    record.begin(TRACE_IDX_CHECKPOINT);
+    record.put<uint64_t>(executed);
+    record.put<uint64_t>(streamOffset());
+    record.putBytes(gpr, TRACE_GPR_COUNT * sizeof(uint64_t));
+    emitIndex();
+    nextCheckpoint = executed + options.indexInterval;
+}
+
+// 逐条指令模式：指令执行前、输出任何内容之前调用，需要时写检查点，并更新地址表
+void TraceEmitter::indexInstruction(InstTemplate *tpl, const uint64_t *gpr) {
+    if (indexSink == nullptr) {
+        return;
+    }
+    if (executed >= nextCheckpoint) {
+        writeCheckpoint(gpr);
+    }
+    if (tpl->hitEpoch != epoch) {
+        tpl->hitEpoch = epoch;
+        tpl->firstHit = executed;
+        tpl->hits = 0;
+    }
+    tpl->lastHit = executed;
+    tpl->hits++;
+    executed++;
+}
+
+// 段结束：本段执行过的地址，每条记录最多 255 个
+void TraceEmitter::writeAddressTable() {
+    uint8_t count = 0;
+    for (const auto &item: templates) {
+        const InstTemplate *tpl = item.second.get();
+        if (tpl->hitEpoch != epoch) {
+            continue;
+        }
+        if (count == 0) {
+            record.begin(TRACE_IDX_ADDRESSES);
+        }
+        record.put(TraceIndexAddress{tpl->address, tpl->firstHit, tpl->lastHit, tpl->hits});
+        if (++count == UINT8_MAX) {
+            record.setAux(count);
+            emitIndex();
+            count = 0;
+        }
+    }
+    if (count > 0) {
+        record.setAux(count);
+        emitIndex();
+    }
+}
+
+// ---------------- dump ----------------
+
+// 探测结果是否与本段之前输出过的某个 dump 相同，相同时 id 为那个 dump 的编号。
+// 读取失败的不去重，也不占用编号
+bool TraceEmitter::repeatedDump(const PointerProbe &probe, uint32_t &id) {
+    if (!options.dedupDumps || probe.kind == TRACE_DUMP_INVALID) {
+        return false;
+    }
+    return dumps.lookup(dumpHash(probe.value, probe.kind, probe.buffer, probe.len), id);
+}
+
+// ---------------- 文本模式 ----------------
+
+// prefix + regs 中与上一次输出相比变化了的 V 寄存器 "v3=0x... " + "]"，没有变化时不输出
+void TraceEmitter::textFpr(const char *prefix, const uint64_t *fpr, uint32_t regs) {
+    FprChange changes[32];
+    size_t count = collectFprChanges(fpr, lastFpr, regs, changes);
+    if (count == 0) {
+        return;
+    }
+    textAppend(prefix, strlen(prefix));
+    for (size_t i = 0; i < count; ++i) {
+        char *p = textReserve(FPR_CHANGE_MAX);
+        textCommit(formatFprChange(p, changes[i].reg, changes[i].lanes, changes[i].value));
+    }
+    textAppend("]", 1);
+}
+
+void TraceEmitter::textPre(InstTemplate *tpl, const uint64_t *gpr, const uint64_t *fpr) {
+    indexInstruction(tpl, gpr);
+
+    // 插桩时已经生成的 "符号:地址: 反汇编"
+    textAppend(tpl->head.data(), tpl->head.size());
+
+    // 记录读取的寄存器状态
+    if (!tpl->reads.empty()) {
+        textAppend("\tr[", 3);
+        for (const auto &reg: tpl->reads) {
+            textCommit(formatReg(textReserve(TEXT_REG_MAX), reg, gpr[reg.ctxIdx]));
+        }
+        textAppend("]", 1);
+    }
+    if (tpl->fprReads != 0) {
+        textFpr("\tfr[", fpr, tpl->fprReads);
+    }
+    flushText();
+}
+
+void TraceEmitter::textPost(InstTemplate *tpl, const uint64_t *gpr, const uint64_t *fpr) {
+    // 记录写入的寄存器状态，有写入的寄存器时在同一行输出，之后换行
+    if (!tpl->writes.empty()) {
+        textAppend("\tw[", 3);
+        for (const auto &reg: tpl->writes) {
+            textCommit(formatReg(textReserve(TEXT_REG_MAX), reg, gpr[reg.ctxIdx]));
+        }
+        textAppend("]", 1);
+    }
+    if (tpl->fprWrites != 0) {
+        textFpr("\tfw[", fpr, tpl->fprWrites);
+    }
+    textAppend("\n", 1);
+
+    // 对可能为地址的寄存器值进行 hexdump 或字符串输出，仅在值为有效地址时执行
+    for (size_t i = 0; i < tpl->writes.size(); ++i) {
+        const auto &reg = tpl->writes[i];
+        const auto &probe = probes[i];
+        if (!probe.valid) {
+            continue;
+        }
+        char *p;
+        uint32_t id;
+        if (repeatedDump(probe, id)) {
+            textCommit(formatDumpRef(textReserve(DUMP_REF_LINE_MAX), reg.name, reg.nameLen, id, probe.value));
+            continue;
+        }
+        if (probe.kind == TRACE_DUMP_STRING) {
+            p = textReserve(9 + PROBE_MAX + 1);
+            p = formatLiteral(p, "Strings :");
+            p = formatBytes(p, probe.buffer, probe.len);
+            *p++ = '\n';
+        } else if (probe.kind == TRACE_DUMP_HEX) {
+            p = textReserve(12 + sizeof(reg.name) + 14 + 16 + 2 + hexdumpSize(PROBE_HEAD));
+            p = formatLiteral(p, "Hexdump for ");
+            p = formatBytes(p, reg.name, reg.nameLen);
+            p = formatLiteral(p, " at address 0x");
+            p = formatHex(p, probe.value);
+            p = formatLiteral(p, ":\n");
+            p = formatHexdump(p, probe.buffer, probe.len, probe.value);
+        } else {
+            p = textReserve(35 + 16 + 1);
+            p = formatLiteral(p, "Invalid memory access at address 0x");
+            p = formatHex(p, probe.value);
+            *p++ = '\n';
+        }
+        textCommit(p);
+    }
+}
+
+void TraceEmitter::textMemory(const TraceMemAccess *accesses, size_t count) {
+    if (count == 0) {
+        // 没有记录到访问时保持原来的空行
+        textAppend("\n", 1);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const TraceMemAccess &acc = accesses[i];
+        // "   mem[rw]:0x" + 地址 + " size:" + 大小 + " value:0x" + 值
+        char *p = textReserve(13 + 16 + 6 + 4 + 9 + 16);
+        if (acc.type == TRACE_MEM_READ) {
+            p = formatLiteral(p, "   mem[r]:0x");
+        } else if (acc.type == TRACE_MEM_WRITE) {
+            p = formatLiteral(p, "   mem[w]:0x");
+        } else {
+            p = formatLiteral(p, "   mem[rw]:0x");
+        }
+        p = formatHex(p, acc.address);
+        p = formatLiteral(p, " size:");
+        p = formatHex(p, acc.size);
+        p = formatLiteral(p, " value:0x");
+        p = formatHex(p, acc.value);
+        textCommit(p);
+    }
+    textCommit(formatLiteral(textReserve(2), "\n\n"));
+}
+
+// ---------------- 二进制记录模式 ----------------
+// 回调中只拼接定长记录，文本由主机端 tools/trace_render 还原
+
+// 输出 regs 中变化了的 V 寄存器 lane，没有变化时不输出
+void TraceEmitter::recordFpr(const uint64_t *fpr, uint8_t kind, uint32_t regs) {
+    FprChange changes[32];
+    size_t count = collectFprChanges(fpr, lastFpr, regs, changes);
+    if (count > 0) {
+        putFprChanges(record, kind, changes, count);
+        emitRecord();
+    }
+}
+
+// 指令执行前：地址 + 读寄存器的值；GPR 增量模式下为地址 + 除 pc 外的寄存器增量
+void TraceEmitter::recordPre(InstTemplate *tpl, const uint64_t *gpr, const uint64_t *fpr) {
+    auto &rec = record;
+    // 复用上一次 trace 中翻译好的块时，模板的 INST_DEF 还没有写入当前文件
+    defineTemplate(tpl);
+    indexInstruction(tpl, gpr);
+
+    if (options.gprDelta) {
+        rec.begin(TRACE_REC_INST_PRE);
+        rec.put<uint64_t>(tpl->address);
+        putGprDelta(rec, gpr, lastGpr, TRACE_GPR_MASK_NO_PC);
+    } else {
+        rec.begin(TRACE_REC_INST_PRE, tpl->reads.size());
+        rec.put<uint64_t>(tpl->address);
+        for (const auto &reg: tpl->reads) {
+            rec.put<uint64_t>(gpr[reg.ctxIdx]);
+        }
+    }
+    emitRecord();
+    if (tpl->fprReads != 0) {
+        recordFpr(fpr, TRACE_FPR_READ, tpl->fprReads);
+    }
+}
+
+// 指令执行后：写寄存器的值和这些值指向的内存
+void TraceEmitter::recordPost(InstTemplate *tpl, const uint64_t *gpr, const uint64_t *fpr) {
+    auto &rec = record;
+    if (tpl->fprWrites != 0) {
+        recordFpr(fpr, TRACE_FPR_WRITE, tpl->fprWrites);
+    }
+    if (options.gprDelta) {
+        rec.begin(TRACE_REC_INST_POST);
+        putGprDelta(rec, gpr, lastGpr, TRACE_GPR_MASK_NO_PC);
+    } else {
+        rec.begin(TRACE_REC_INST_POST, tpl->writes.size());
+        for (const auto &reg: tpl->writes) {
+            rec.put<uint64_t>(gpr[reg.ctxIdx]);
+        }
+    }
+    emitRecord();
+
+    // 按写寄存器的顺序输出 dump，序号对应 INST_DEF 中的写寄存器名
+    for (size_t index = 0; index < tpl->writes.size(); ++index) {
+        const auto &probe = probes[index];
+        uint32_t id;
+        if (probe.valid && repeatedDump(probe, id)) {
+            rec.begin(TRACE_REC_DUMP_REF, probe.kind);
+            rec.put<uint8_t>(index);
+            rec.put<uint64_t>(probe.value);
+            rec.put<uint32_t>(id);
+            emitRecord();
+        } else if (probe.valid) {
+            rec.begin(TRACE_REC_DUMP, probe.kind);
+            rec.put<uint8_t>(index);
+            rec.put<uint64_t>(probe.value);
+            rec.putBytes(probe.buffer, probe.len);
+            emitRecord();
+        }
+    }
+}
+
+void TraceEmitter::recordMemory(const TraceMemAccess *accesses, size_t count) {
+    // 没有访问时也输出 count 为 0 的记录，渲染后与文本模式一样留出空行
+    count = std::min<size_t>(count, UINT8_MAX);
+    record.begin(TRACE_REC_MEM, count);
+    for (size_t i = 0; i < count; ++i) {
+        record.put(accesses[i]);
+    }
+    emitRecord();
+}
+
+// ---------------- 块模式 ----------------
+// 每个块只在进出时各回调一次，记录寄存器增量和块内的内存访问，由 tools/trace_render 展开为逐条指令
+
+// 进入块：块的地址范围 + 寄存器增量；检查点在块开始处
+void TraceEmitter::blockEntry(uint64_t start, uint64_t end, uint64_t instructions, const uint64_t *gpr) {
+    if (indexSink != nullptr) {
+        if (executed >= nextCheckpoint) {
+            writeCheckpoint(gpr);
+        }
+        executed += instructions;
+    }
+    record.begin(TRACE_REC_BLOCK);
+    record.put<uint64_t>(start);
+    record.put<uint64_t>(end);
+    putGprDelta(record, gpr, lastGpr);
+    emitRecord();
+}
+
+// 块内的内存访问，每条记录最多 255 个
+void TraceEmitter::blockMemory(const TraceBlockMemAccess *accesses, size_t count) {
+    for (size_t i = 0; i < count; i += UINT8_MAX) {
+        size_t n = std::min<size_t>(count - i, UINT8_MAX);
+        record.begin(TRACE_REC_BLOCK_MEM, n);
+        for (size_t j = i; j < i + n; ++j) {
+            record.put(accesses[j]);
+        }
+        emitRecord();
+    }
+}
+
+// 离开块：寄存器增量
+void TraceEmitter::blockExit(const uint64_t *gpr) {
+    record.begin(TRACE_REC_BLOCK_EXIT);
+    putGprDelta(record, gpr, lastGpr);
+    emitRecord();
+}
@@ -0,0 +1,220 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace 的输出部分：vm.cpp 的回调从 QBDI 取出寄存器、内存访问和写寄存器的探测结果后交给 TraceEmitter，
+// 由它拼接文本行或二进制记录、维护 GPR / FPR 增量的基准、dump 去重和 sidecar 索引，写入 TraceSink。
+// 设备端和主机端测试（tools/tests）共用，不要引入 android / QBDI 头文件。
+//
+
+#ifndef XPOSEDNHOOK_TRACE_EMITTER_H
+#define XPOSEDNHOOK_TRACE_EMITTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "dump_cache.h"
+#include "trace_index.h"
+#include "trace_record.h"
+#include "trace_writer.h"
+
+class vm;
+
+// trace 中记录的寄存器：VM 状态中的下标 + 寄存器名
+struct TracedReg {
+    int16_t ctxIdx;
+    uint8_t nameLen;
+    char name[8];
+};
+
+// 插桩时从 QBDI 的指令分析中取出的、生成模板需要的信息
+struct InstInfo {
+    uint64_t address;
+    uint8_t size;
+    const char *disassembly;
+    // QBDI 解析出的符号，offset 为符号内偏移；没有符号时 module 为所在模块的 id（-1 为不在任何模块中），
+    // offset 为模块内偏移，moduleName / moduleBase 为该模块的文件名和加载基址
+    const char *symbol;
+    uint64_t offset;
+    int32_t module;
+    std::string moduleName;
+    uint64_t moduleBase;
+    // 操作数中的 GPR 读写，INST_DEF 中总是完整列出；V 寄存器位图
+    std::vector<TracedReg> reads;
+    std::vector<TracedReg> writes;
+    uint32_t fprReads;
+    uint32_t fprWrites;
+    bool mayAccessMemory;
+};
+
+// 插桩时为每条指令生成一次的 trace 模板，执行时的回调只按下标读寄存器
+struct InstTemplate {
+    class vm *owner;
+    uint64_t address;
+    bool accessMemory;              // 指令可能读写内存，执行后读取内存访问记录
+    std::string head;               // 文本模式的行首："符号:0x地址: 反汇编"
+    std::vector<TracedReg> reads;
+    std::vector<TracedReg> writes;
+    // 操作数中读写的 V 寄存器位图，仅在 traceFpr 时生成
+    uint32_t fprReads;
+    uint32_t fprWrites;
+    // 二进制模式：编码好的 INST_DEF 记录和其中引用的模块（-1 为没有），
+    // 复用已翻译的块时每个 trace 文件中再输出一次；epoch 为最近一次输出时的 epoch
+    std::string def;
+    int32_t defModule;
+    uint32_t epoch;
+    // 索引的地址表：本段中第一次 / 最后一次执行时的指令序号和次数，hitEpoch 不是当前 epoch 时无效
+    uint32_t hitEpoch;
+    uint64_t firstHit;
+    uint64_t lastHit;
+    uint64_t hits;
+};
+
+// 写寄存器指向内存的探测：开头读取的字节数，字符串最多读取的字节数
+#define PROBE_HEAD 32
+#define PROBE_MAX 256
+
+// 一个写寄存器的探测结果
+struct PointerProbe {
+    uint64_t value;
+    bool valid;             // 值是否为已映射的地址
+    TraceDumpKind kind;
+    size_t len;             // buffer 中要输出的字节数
+    uint8_t buffer[PROBE_MAX];
+};
+
+// 输出相关的选项，vm::init 时由 TraceConfig 得到
+struct TraceEmitOptions {
+    bool binary = false;            // 二进制记录，否则为文本
+    bool blocks = false;            // 块模式：段开始时输出全部模板的 INST_DEF
+    bool gprDelta = false;          // 二进制逐条指令模式：INST_PRE / INST_POST 记录 GPR 增量
+    bool traceRegisters = true;     // 模板中记录读写寄存器
+    bool traceMemory = true;        // 模板中记录指令是否访问内存
+    bool dedupDumps = false;
+    bool stats = false;
+    uint32_t indexInterval = TRACE_INDEX_INTERVAL;
+};
+
+// 寄存器状态按 trace 的布局传入：gpr 为 TRACE_GPR_COUNT 个 u64（x0-x28, x29, lr, sp, nzcv, pc），
+// fpr 为 v0-v31，每个两个 u64
+class TraceEmitter {
+public:
+    TraceEmitOptions options;
+
+    // 指令地址 -> 模板，插桩时生成
+    std::unordered_map<uint64_t, std::unique_ptr<InstTemplate>> templates;
+
+    // 执行后回调中写寄存器的探测结果，顺序同 tpl->writes，由调用者在 textPost / recordPost 之前填写
+    std::vector<PointerProbe> probes;
+
+    // 生成指令模板：文本行首或 INST_DEF、要记录的读写寄存器。同一地址被重新翻译时返回已有模板
+    InstTemplate *prepare(const InstInfo &info, class vm *owner);
+
+    // 开始一个段：增量基准、dump 编号、模块和模板的输出状态都重置。index 不为空时同时写索引，
+    // streamBase 为 sink 的位置 0 在 trace 文件中的偏移。sink 为空时（覆盖率模式）不输出任何内容
+    void begin(TraceSink *sink, uint32_t segment, TraceSink *index = nullptr, uint64_t streamBase = 0);
+
+    // 段开始 / 结束的分隔行或记录；段开始时写索引的段记录，块模式输出全部模板的 INST_DEF
+    void writeSegmentBegin(uint64_t target, uint64_t timeMs);
+
+    void writeSegmentEnd(uint64_t durationUs);
+
+    // 写出已缓冲的文本之后直接写入 sink（profile 的汇总表）
+    void writeText(const char *data, size_t len);
+
+    // 写出索引的地址表和段结束记录，之后不再写 sink
+    void end();
+
+    // ---- 逐条指令，文本 ----
+    // 指令执行前："符号:0x地址: 反汇编\tr[...]\tfr[...]"，写入 sink
+    void textPre(InstTemplate *tpl, const uint64_t *gpr, const uint64_t *fpr);
+
+    // 指令执行后："\tw[...]\tfw[...]\n" 和写寄存器指向的字符串 / hexdump，留在缓冲中
+    void textPost(InstTemplate *tpl, const uint64_t *gpr, const uint64_t *fpr);
+
+    // 内存访问行和结尾的空行，没有访问时也保留空行
+    void textMemory(const TraceMemAccess *accesses, size_t count);
+
+    // 把本次回调格式化好的文本交给 sink
+    void flushText();
+
+    // ---- 逐条指令，二进制 ----
+    void recordPre(InstTemplate *tpl, const uint64_t *gpr, const uint64_t *fpr);
+
+    void recordPost(InstTemplate *tpl, const uint64_t *gpr, const uint64_t *fpr);
+
+    // 最多 255 个访问，没有访问时也输出 count 为 0 的记录
+    void recordMemory(const TraceMemAccess *accesses, size_t count);
+
+    // ---- 块模式，只有二进制 ----
+    // 进入块 [start, end)，块内有 instructions 条指令
+    void blockEntry(uint64_t start, uint64_t end, uint64_t instructions, const uint64_t *gpr);
+
+    void blockMemory(const TraceBlockMemAccess *accesses, size_t count);
+
+    void blockExit(const uint64_t *gpr);
+
+    // 段内已执行的指令数（写索引时统计）
+    uint64_t instructions() const { return executed; }
+
+private:
+    char *textReserve(size_t n);
+
+    void textCommit(const char *end) { textLen = end - text; }
+
+    void textAppend(const char *data, size_t len);
+
+    void textFpr(const char *prefix, const uint64_t *fpr, uint32_t regs);
+
+    void emitRecord();
+
+    void emitIndex();
+
+    uint64_t streamOffset() const;
+
+    void writeCheckpoint(const uint64_t *gpr);
+
+    void indexInstruction(InstTemplate *tpl, const uint64_t *gpr);
+
+    void writeAddressTable();
+
+    void encodeInstDef(InstTemplate *tpl, const InstInfo &info);
+
+    void defineTemplate(InstTemplate *tpl);
+
+    void recordFpr(const uint64_t *fpr, uint8_t kind, uint32_t regs);
+
+    bool repeatedDump(const PointerProbe &probe, uint32_t &id);
+
+    // trace 输出，只在 begin 和 end 之间有效
+    TraceSink *sink = nullptr;
+    // 每次 begin 加一，用于判断模板的 INST_DEF 是否已经写入当前的 trace
+    uint32_t epoch = 0;
+    uint32_t segment = 0;
+
+    // 索引输出，不写索引时为空；段内已执行的指令数和下一个检查点的指令序号
+    TraceSink *indexSink = nullptr;
+    uint64_t streamBase = 0;
+    uint64_t executed = 0;
+    uint64_t nextCheckpoint = 0;
+
+    // 文本模式下每个回调的格式化缓冲，回调结束时写入 sink
+    char text[16 << 10];
+    size_t textLen = 0;
+
+    // 本段最近输出过的 dump，dedupDumps 时使用
+    DumpCache dumps;
+
+    // GPR 增量的基准：上一次输出后的寄存器状态；FPR 通道：上一次输出后的 v0-v31
+    uint64_t lastGpr[TRACE_GPR_COUNT] = {};
+    uint64_t lastFpr[32][2] = {};
+
+    // 模块 id -> 编码好的 TRACE_REC_MODULE，以及本段已经输出过的模块
+    std::unordered_map<uint32_t, std::string> moduleRecords;
+    std::vector<bool> modulesDefined;
+    TraceRecordBuilder record;
+};
+
+#endif //XPOSEDNHOOK_TRACE_EMITTER_H
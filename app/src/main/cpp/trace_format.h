@@ -0,0 +1,270 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace 文本格式化：查表输出十六进制，hexdump 整行用 SIMD 展开半字节，
+// 直接写入调用方提供的缓冲区，不经过 iostream。输出与原来 std::hex / std::setw 的格式逐字节一致。
+// 设备端回调和主机端 tools/trace_render 共用，不要引入 android / QBDI 头文件。
+//
+
+#ifndef XPOSEDNHOOK_TRACE_FORMAT_H
+#define XPOSEDNHOOK_TRACE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// hexdump 一行最多输出的字节数：地址（最多 16 位）+ ": " + 49 + " |" + 16 + "|\n"
+#define HEXDUMP_ROW_MAX 96
+// 一行十六进制部分的长度："xx " * 16 + 中间多出的一个空格
+#define HEXDUMP_HEX_WIDTH 49
+
+// 字节 -> 两个小写十六进制字符 / hexdump 右侧的 ASCII 字符
+struct HexTables {
+    char pair[256][2];
+    char ascii[256];
+    // hexdump 一行中第 p 个字符取自 "32 个十六进制字符 + 空格" 的下标，32 表示空格
+    uint8_t rowIndex[HEXDUMP_HEX_WIDTH + 15];
+
+    constexpr HexTables() : pair(), ascii(), rowIndex() {
+        const char digits[] = "0123456789abcdef";
+        for (int i = 0; i < 256; ++i) {
+            pair[i][0] = digits[i >> 4];
+            pair[i][1] = digits[i & 0xf];
+            ascii[i] = (i >= 0x20 && i <= 0x7e) ? (char) i : '.';
+        }
+        for (int p = 0; p < (int) sizeof(rowIndex); ++p) {
+            int q = p < 24 ? p : p - 1;
+            if (p == 24 || p >= HEXDUMP_HEX_WIDTH || q % 3 == 2) {
+                rowIndex[p] = 32;
+            } else {
+                rowIndex[p] = (q / 3) * 2 + q % 3;
+            }
+        }
+    }
+};
+
+inline constexpr HexTables hexTables{};
+
+// 追加一段字节
+inline char *formatBytes(char *out, const void *data, size_t len) {
+    memcpy(out, data, len);
+    return out + len;
+}
+
+// 追加 C 字符串（常量）
+template<size_t N>
+inline char *formatLiteral(char *out, const char (&str)[N]) {
+    return formatBytes(out, str, N - 1);
+}
+
+// 小写十六进制，无前导 0，与 std::hex 一致
+inline char *formatHex(char *out, uint64_t value) {
+    int digits = value == 0 ? 1 : (67 - __builtin_clzll(value)) >> 2;
+    char *end = out + digits;
+    char *p = end;
+    while (value >= 0x100) {
+        p -= 2;
+        memcpy(p, hexTables.pair[value & 0xff], 2);
+        value >>= 8;
+    }
+    if (value >= 0x10) {
+        memcpy(p - 2, hexTables.pair[value], 2);
+    } else {
+        p[-1] = hexTables.pair[value][1];
+    }
+    return end;
+}
+
+// 小写十六进制，不足 width 位时补 0，与 std::setw(width) << std::setfill('0') 一致
+inline char *formatHexPadded(char *out, uint64_t value, int width) {
+    int digits = value == 0 ? 1 : (67 - __builtin_clzll(value)) >> 2;
+    if (digits < width) {
+        memset(out, '0', width - digits);
+        out += width - digits;
+    }
+    return formatHex(out, value);
+}
+
+// 十进制，无前导 0
+inline char *formatDecimal(char *out, uint64_t value) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (n > 0) {
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+// 段的开始行："==== segment 3 target 0x7b2c01a2f0 time 1760000000000 ====\n"，time 为毫秒
+inline char *formatSegmentBegin(char *out, uint32_t segment, uint64_t target, uint64_t timeMs) {
+    out = formatLiteral(out, "==== segment ");
+    out = formatDecimal(out, segment);
+    out = formatLiteral(out, " target 0x");
+    out = formatHex(out, target);
+    out = formatLiteral(out, " time ");
+    out = formatDecimal(out, timeMs);
+    return formatLiteral(out, " ====\n");
+}
+
+// 段的结束行："==== segment 3 end 1234us ====\n"
+inline char *formatSegmentEnd(char *out, uint32_t segment, uint64_t durationUs) {
+    out = formatLiteral(out, "==== segment ");
+    out = formatDecimal(out, segment);
+    out = formatLiteral(out, " end ");
+    out = formatDecimal(out, durationUs);
+    return formatLiteral(out, "us ====\n");
+}
+
+// 段的开始 / 结束行的最大长度
+#define SEGMENT_LINE_MAX 96
+
+// 重复的 dump（dump_cache.h）："Same as dump #编号 for 寄存器 at address 0x地址"
+inline char *formatDumpRef(char *out, const char *reg, size_t regLen, uint32_t id, uint64_t address) {
+    out = formatLiteral(out, "Same as dump #");
+    out = formatDecimal(out, id);
+    out = formatLiteral(out, " for ");
+    memcpy(out, reg, regLen);
+    out += regLen;
+    out = formatLiteral(out, " at address 0x");
+    out = formatHex(out, address);
+    *out++ = '\n';
+    return out;
+}
+
+// 引用行的最大长度（寄存器名不超过 8 字节）
+#define DUMP_REF_LINE_MAX 80
+
+// 一个 V 寄存器中变化的 lane，后跟一个空格："v3=0x<128 位>"，只有一个 lane 变化时为 "v3.d[1]=0x<64 位>"
+inline char *formatFprChange(char *out, unsigned reg, uint32_t lanes, const uint64_t *value) {
+    *out++ = 'v';
+    if (reg >= 10) {
+        *out++ = (char) ('0' + reg / 10);
+    }
+    *out++ = (char) ('0' + reg % 10);
+    if (lanes == 3) {
+        out = formatLiteral(out, "=0x");
+        if (value[1] != 0) {
+            out = formatHex(out, value[1]);
+            out = formatHexPadded(out, value[0], 16);
+        } else {
+            out = formatHex(out, value[0]);
+        }
+    } else {
+        int lane = lanes == 2;
+        out = formatLiteral(out, ".d[");
+        *out++ = (char) ('0' + lane);
+        out = formatLiteral(out, "]=0x");
+        out = formatHex(out, value[lane]);
+    }
+    *out++ = ' ';
+    return out;
+}
+
+// 一个 FPR 变化的最大长度："v31=0x" + 32 位十六进制 + " "
+#define FPR_CHANGE_MAX 40
+
+// 完整 16 字节一行的十六进制部分："xx xx xx xx xx xx xx xx  xx ... xx "
+inline char *formatHexRow16(char *out, const uint8_t *row) {
+#if defined(__aarch64__)
+    // 半字节查表得到 32 个字符，再按 rowIndex 一次重排并插入空格
+    const uint8x16_t digits = vld1q_u8(reinterpret_cast<const uint8_t *>("0123456789abcdef"));
+    uint8x16_t bytes = vld1q_u8(row);
+    uint8x16_t hi = vqtbl1q_u8(digits, vshrq_n_u8(bytes, 4));
+    uint8x16_t lo = vqtbl1q_u8(digits, vandq_u8(bytes, vdupq_n_u8(0xf)));
+    uint8x16x3_t table = {{vzip1q_u8(hi, lo), vzip2q_u8(hi, lo), vdupq_n_u8(' ')}};
+    vst1q_u8(reinterpret_cast<uint8_t *>(out), vqtbl3q_u8(table, vld1q_u8(hexTables.rowIndex)));
+    vst1q_u8(reinterpret_cast<uint8_t *>(out + 16), vqtbl3q_u8(table, vld1q_u8(hexTables.rowIndex + 16)));
+    vst1q_u8(reinterpret_cast<uint8_t *>(out + 32), vqtbl3q_u8(table, vld1q_u8(hexTables.rowIndex + 32)));
+    out[48] = ' ';
+#else
+    char hex[33];
+#if defined(__SSE2__)
+    // 半字节 n -> '0' + n，大于 9 的再加 'a' - '0' - 10
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row));
+    __m128i mask = _mm_set1_epi8(0xf);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+    __m128i lo = _mm_and_si128(bytes, mask);
+    __m128i nine = _mm_set1_epi8(9);
+    __m128i zero = _mm_set1_epi8('0');
+    __m128i adjust = _mm_set1_epi8('a' - '0' - 10);
+    hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), adjust));
+    lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), adjust));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(hex), _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(hex + 16), _mm_unpackhi_epi8(hi, lo));
+#else
+    for (int i = 0; i < 16; ++i) {
+        memcpy(hex + i * 2, hexTables.pair[row[i]], 2);
+    }
+#endif
+    hex[32] = ' ';
+    for (int p = 0; p < HEXDUMP_HEX_WIDTH; ++p) {
+        out[p] = hex[hexTables.rowIndex[p]];
+    }
+#endif
+    return out + HEXDUMP_HEX_WIDTH;
+}
+
+// 16 字节一行的 ASCII 部分，不可打印字符输出为 '.'
+inline char *formatAsciiRow16(char *out, const uint8_t *row) {
+#if defined(__aarch64__)
+    uint8x16_t bytes = vld1q_u8(row);
+    uint8x16_t printable = vandq_u8(vcgeq_u8(bytes, vdupq_n_u8(0x20)), vcleq_u8(bytes, vdupq_n_u8(0x7e)));
+    vst1q_u8(reinterpret_cast<uint8_t *>(out), vbslq_u8(printable, bytes, vdupq_n_u8('.')));
+#else
+    for (int i = 0; i < 16; ++i) {
+        out[i] = hexTables.ascii[row[i]];
+    }
+#endif
+    return out + 16;
+}
+
+// 与原 hexdump_memory 相同的格式，每行 16 字节：
+//   "%08x: " + "xx " * 16（第 8 个后多一个空格）+ " |ascii|\n"，最后一行不足 16 字节时用空格补齐
+// out 至少需要 HEXDUMP_ROW_MAX * 行数 字节，返回写入后的位置
+inline char *formatHexdump(char *out, const uint8_t *data, size_t size, uint64_t address) {
+    for (size_t offset = 0; offset < size; offset += 16) {
+        out = formatHexPadded(out, address + offset, 8);
+        out = formatLiteral(out, ": ");
+        const uint8_t *row = data + offset;
+        if (size - offset >= 16) {
+            out = formatHexRow16(out, row);
+            out = formatLiteral(out, " |");
+            out = formatAsciiRow16(out, row);
+        } else {
+            size_t n = size - offset;
+            for (size_t i = 0; i < 16; ++i) {
+                if (i < n) {
+                    memcpy(out, hexTables.pair[row[i]], 2);
+                    out[2] = ' ';
+                } else {
+                    memset(out, ' ', 3);
+                }
+                out += 3;
+                if (i == 7) *out++ = ' ';
+            }
+            out = formatLiteral(out, " |");
+            for (size_t i = 0; i < 16; ++i) {
+                *out++ = i < n ? hexTables.ascii[row[i]] : ' ';
+            }
+        }
+        out = formatLiteral(out, "|\n");
+    }
+    return out;
+}
+
+// hexdump 输出的最大长度
+inline size_t hexdumpSize(size_t size) {
+    return (size + 15) / 16 * HEXDUMP_ROW_MAX;
+}
+
+#endif //XPOSEDNHOOK_TRACE_FORMAT_H
@@ -0,0 +1,44 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace 的 sidecar 索引（trace 文件名 + ".idx"），trace 时一同写出：
+// 每隔固定条数指令的检查点（指令序号、该指令在 trace 中的偏移、执行前的完整 GPR），
+// 以及每个段结束时每个地址第一次 / 最后一次执行的指令序号和次数。
+// tools/trace_seek 据此直接跳到第 N 条指令或某个地址的执行处，不用从头扫描 trace。
+// 记录格式与 trace_record.h 相同（TraceRecordHeader + payload），设备端和主机端共用。
+//
+
+#ifndef XPOSEDNHOOK_TRACE_INDEX_H
+#define XPOSEDNHOOK_TRACE_INDEX_H
+
+#include <cstdint>
+
+#include "trace_record.h"
+
+#define TRACE_INDEX_MAGIC "QBIX"
+#define TRACE_INDEX_VERSION 1
+// 默认每隔多少条指令一个检查点
+#define TRACE_INDEX_INTERVAL 16384
+
+// 偏移都是在 trace 文件（压缩时为解压后的数据）中的字节偏移；指令序号在段内从 0 开始，
+// 文本 trace 中即段内第几条指令行
+enum TraceIndexTag : uint8_t {
+    // 段开始：u32 段号, u64 段开始行 / TRACE_REC_SEGMENT 的偏移
+    TRACE_IDX_SEGMENT = 1,
+    // 检查点：u64 指令序号, u64 该指令行 / INST_PRE 记录的偏移（块模式为 BLOCK 记录）,
+    // TRACE_GPR_COUNT * u64 指令执行前的寄存器
+    TRACE_IDX_CHECKPOINT = 2,
+    // 段内执行过的地址：aux = 数量，aux * TraceIndexAddress，在段结束时输出
+    TRACE_IDX_ADDRESSES = 3,
+    // 段结束：u32 段号, u64 段内的指令数
+    TRACE_IDX_SEGMENT_END = 4,
+};
+
+struct __attribute__((packed)) TraceIndexAddress {
+    uint64_t address;
+    uint64_t first;     // 第一次 / 最后一次执行时的指令序号
+    uint64_t last;
+    uint64_t count;
+};
+
+#endif //XPOSEDNHOOK_TRACE_INDEX_H
@@ -0,0 +1,217 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace 输出的块压缩：LZ4 块格式（token + 字面量 + 16 位偏移 + 匹配长度），贪心匹配、4 字节哈希。
+// 输出按最多 64KB 原始数据切成互相独立的帧，每帧带帧头，可以按帧并行解压或跳转。
+// 设备端和主机端 tools 共用，不要引入 android / QBDI 头文件。
+//
+
+#ifndef XPOSEDNHOOK_TRACE_LZ_H
+#define XPOSEDNHOOK_TRACE_LZ_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#define TRACE_LZ_MAGIC "QBLZ"
+// 一帧最多的原始字节数，帧内偏移可以用 16 位表示
+#define TRACE_LZ_FRAME (64 << 10)
+// 最坏情况（不可压缩）下一帧压缩后的最大长度
+#define TRACE_LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+// 帧头，后面紧跟 storedSize 字节的帧内容
+struct __attribute__((packed)) TraceLzFrame {
+    char magic[4];          // "QBLZ"，便于在文件中定位帧和校验
+    uint32_t rawSize;       // 解压后的字节数，不超过 TRACE_LZ_FRAME
+    uint32_t storedSize;
+    uint32_t flags;         // TraceLzFlags
+};
+
+enum TraceLzFlags : uint32_t {
+    TRACE_LZ_STORED = 1,    // 压缩后反而更大，帧内容为原始数据
+};
+
+#define TRACE_LZ_MIN_MATCH 4
+// LZ4 块格式的约束：最后 5 个字节必须是字面量，最后一个匹配至少在结尾前 12 字节开始
+#define TRACE_LZ_LAST_LITERALS 5
+#define TRACE_LZ_MF_LIMIT 12
+#define TRACE_LZ_HASH_BITS 13
+
+// 压缩用的哈希表：4 字节内容 -> 在帧内最近出现的位置
+struct TraceLzTable {
+    uint16_t pos[1 << TRACE_LZ_HASH_BITS];
+};
+
+static inline uint32_t lzRead32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t lzRead64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lzHash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - TRACE_LZ_HASH_BITS);
+}
+
+// 长度超过 15 的部分：一串 255 + 余数
+static inline uint8_t *lzPutLength(uint8_t *op, size_t len) {
+    for (; len >= 255; len -= 255) {
+        *op++ = 255;
+    }
+    *op++ = (uint8_t) len;
+    return op;
+}
+
+// 从 ip 和 ref 开始的相同字节数，不超过 limit - ip
+static inline size_t lzMatchLength(const uint8_t *ip, const uint8_t *ref, const uint8_t *limit) {
+    const uint8_t *start = ip;
+    while (ip + 8 <= limit) {
+        uint64_t diff = lzRead64(ip) ^ lzRead64(ref);
+        if (diff != 0) {
+            return ip - start + (__builtin_ctzll(diff) >> 3);
+        }
+        ip += 8;
+        ref += 8;
+    }
+    while (ip < limit && *ip == *ref) {
+        ip++;
+        ref++;
+    }
+    return ip - start;
+}
+
+// 一个序列：字面量 [anchor, ip) + 匹配 (offset, matchLen)，matchLen 为 0 时只有字面量（最后一个序列）
+static inline uint8_t *lzPutSequence(uint8_t *op, const uint8_t *anchor, size_t literals, size_t offset,
+                                     size_t matchLen) {
+    uint8_t *token = op++;
+    size_t ml = matchLen != 0 ? matchLen - TRACE_LZ_MIN_MATCH : 0;
+    *token = (uint8_t) ((literals < 15 ? literals : 15) << 4 | (ml < 15 ? ml : 15));
+    if (literals >= 15) {
+        op = lzPutLength(op, literals - 15);
+    }
+    memcpy(op, anchor, literals);
+    op += literals;
+    if (matchLen == 0) {
+        return op;
+    }
+    *op++ = (uint8_t) offset;
+    *op++ = (uint8_t) (offset >> 8);
+    if (ml >= 15) {
+        op = lzPutLength(op, ml - 15);
+    }
+    return op;
+}
+
+// 压缩一帧（size 不超过 TRACE_LZ_FRAME），dst 至少 TRACE_LZ_BOUND(size) 字节，返回压缩后的长度
+static inline size_t lzCompress(const uint8_t *src, size_t size, uint8_t *dst, TraceLzTable &table) {
+    uint8_t *op = dst;
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    if (size > TRACE_LZ_MF_LIMIT) {
+        memset(table.pos, 0, sizeof(table.pos));
+        const uint8_t *mfLimit = src + size - TRACE_LZ_MF_LIMIT;
+        const uint8_t *matchLimit = src + size - TRACE_LZ_LAST_LITERALS;
+        // 连续找不到匹配时逐渐加大步长，不可压缩的数据也能很快跳过
+        unsigned misses = 0;
+        while (ip < mfLimit) {
+            uint32_t sequence = lzRead32(ip);
+            uint32_t h = lzHash(sequence);
+            const uint8_t *ref = src + table.pos[h];
+            table.pos[h] = (uint16_t) (ip - src);
+            if (ref >= ip || lzRead32(ref) != sequence) {
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            // 向前扩展匹配
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            size_t matchLen = TRACE_LZ_MIN_MATCH +
+                              lzMatchLength(ip + TRACE_LZ_MIN_MATCH, ref + TRACE_LZ_MIN_MATCH, matchLimit);
+            op = lzPutSequence(op, anchor, ip - anchor, ip - ref, matchLen);
+            ip += matchLen;
+            anchor = ip;
+            // 匹配内部的位置也放进哈希表，提高后续的命中率
+            if (ip < mfLimit) {
+                table.pos[lzHash(lzRead32(ip - 2))] = (uint16_t) (ip - 2 - src);
+            }
+        }
+    }
+    return lzPutSequence(op, anchor, src + size - anchor, 0, 0) - dst;
+}
+
+// 解压一帧，dst 有 capacity 字节。数据损坏（越界、偏移无效）时返回 false
+static inline bool lzDecompress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity, size_t &outSize) {
+    const uint8_t *ip = src;
+    const uint8_t *end = src + size;
+    uint8_t *op = dst;
+    uint8_t *outEnd = dst + capacity;
+    while (ip < end) {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            uint8_t b;
+            do {
+                if (ip >= end) {
+                    return false;
+                }
+                b = *ip++;
+                literals += b;
+            } while (b == 255);
+        }
+        if ((size_t) (end - ip) < literals || (size_t) (outEnd - op) < literals) {
+            return false;
+        }
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == end) {
+            break;  // 最后一个序列只有字面量
+        }
+
+        if (end - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | (size_t) ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (size_t) (op - dst)) {
+            return false;
+        }
+        size_t matchLen = token & 15;
+        if (matchLen == 15) {
+            uint8_t b;
+            do {
+                if (ip >= end) {
+                    return false;
+                }
+                b = *ip++;
+                matchLen += b;
+            } while (b == 255);
+        }
+        matchLen += TRACE_LZ_MIN_MATCH;
+        if ((size_t) (outEnd - op) < matchLen) {
+            return false;
+        }
+        const uint8_t *ref = op - offset;
+        if (offset >= matchLen) {
+            memcpy(op, ref, matchLen);
+            op += matchLen;
+        } else {
+            // 重叠的匹配（重复的短模式）逐字节复制
+            for (size_t i = 0; i < matchLen; ++i) {
+                *op++ = *ref++;
+            }
+        }
+    }
+    outSize = op - dst;
+    return true;
+}
+
+#endif //XPOSEDNHOOK_TRACE_LZ_H
@@ -0,0 +1,49 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 崩溃后仍可读的 trace 文件（TraceConfig::durable）：回调线程直接写入 MAP_SHARED 映射的文件，
+// 数据一写入就在 page cache 中，被 trace 的代码让进程崩溃或被 SIGKILL 也不会丢失。
+// 这里的"落盘"只到 page cache：不调用 fsync / msync，系统掉电或重启时没有写回的部分仍会丢失。
+// 文件开头一页是文件头，数据从 TRACE_MMAP_HEADER 处开始，按 segmentSize 分段预分配，
+// 文件长度通常大于实际数据；committed 为已完整写入的数据长度，每写完一条记录（文本模式为一个回调的输出）更新一次，
+// 读取时只读到 committed 为止。设备端和主机端 tools 共用，不要引入 android / QBDI 头文件。
+//
+
+#ifndef XPOSEDNHOOK_TRACE_MMAP_H
+#define XPOSEDNHOOK_TRACE_MMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#define TRACE_MMAP_MAGIC "QBMM"
+#define TRACE_MMAP_VERSION 1
+// 文件头占一页，数据段的文件偏移按页对齐
+#define TRACE_MMAP_HEADER 4096
+// 每次扩展文件并映射的大小
+#define TRACE_MMAP_SEGMENT (16 << 20)
+
+struct TraceMmapHeader {
+    char magic[4];          // "QBMM"
+    uint32_t version;
+    uint32_t headerSize;    // 数据开始的偏移
+    uint32_t segmentSize;
+    uint64_t committed;     // 已完整写入的数据长度，写入方每条记录之后以 release 语义更新
+};
+
+// 文件内容（mmap 的整个文件）是否为 durable trace，是则返回数据部分和已提交的长度
+inline bool durableTraceData(const uint8_t *file, size_t size, const uint8_t *&data, size_t &length) {
+    if (size < sizeof(TraceMmapHeader) || memcmp(file, TRACE_MMAP_MAGIC, 4) != 0) {
+        return false;
+    }
+    TraceMmapHeader header{};
+    memcpy(&header, file, sizeof(header));
+    if (header.headerSize > size) {
+        return false;
+    }
+    data = file + header.headerSize;
+    length = header.committed < size - header.headerSize ? header.committed : size - header.headerSize;
+    return true;
+}
+
+#endif //XPOSEDNHOOK_TRACE_MMAP_H
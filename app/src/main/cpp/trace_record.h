@@ -0,0 +1,259 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 二进制 trace 记录格式。设备端回调只做定长小端记录的拼接，不做任何文本格式化；
+// 主机端 tools/trace_render 根据这些记录还原出与文本模式一致的 trace_log.txt。
+// 本文件需要同时在 NDK 和主机 Linux 上编译，不要引入 android / QBDI 头文件。
+//
+
+#ifndef XPOSEDNHOOK_TRACE_RECORD_H
+#define XPOSEDNHOOK_TRACE_RECORD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "trace records are little-endian");
+
+#define TRACE_MAGIC "QBTR"
+#define TRACE_VERSION 4
+
+// 文件头，位于 trace_log.bin 起始处。文件是追加写入的容器，只在创建时写一次文件头，
+// 之后每次被 trace 的调用是一个以 TRACE_REC_SEGMENT 开始的段
+struct __attribute__((packed)) TraceFileHeader {
+    char magic[4];      // "QBTR"
+    uint16_t version;   // TRACE_VERSION
+    uint16_t flags;     // 保留，为 0；各段的标志在 TRACE_REC_SEGMENT 中
+};
+
+enum TraceFileFlags : uint16_t {
+    // INST_PRE / INST_POST 中是 GPR 增量而不是操作数寄存器的值
+    TRACE_FLAG_GPR_DELTA = 1,
+};
+
+// 每条记录的公共头，length 为 payload 字节数（不含记录头）
+struct __attribute__((packed)) TraceRecordHeader {
+    uint8_t tag;
+    uint8_t aux;        // 记录相关的小参数（数量 / 类型）
+    uint16_t length;
+};
+
+enum TraceRecordTag : uint8_t {
+    // 指令定义，每个地址只出现一次：
+    //   u64 address, u64 offset, u32 module, u8 symbolKind, u8 numRead, u8 numWrite,
+    //   str16 symbol, str16 disassembly, numRead * str8 读寄存器名, numWrite * str8 写寄存器名,
+    //   u8 指令长度, numRead * u8 读寄存器下标, numWrite * u8 写寄存器下标（下标即 GPRState 中的序号）
+    // offset 为符号内偏移（TRACE_SYM_QBDI）或模块内偏移（TRACE_SYM_MODULE），module 仅对后者有效
+    TRACE_REC_INST_DEF = 1,
+    // 指令执行前：aux = 读寄存器数量，u64 address + aux * u64 寄存器值（顺序同 INST_DEF）；
+    // TRACE_FLAG_GPR_DELTA 时 aux = 0，u64 address + GPR 增量（不含 pc）
+    TRACE_REC_INST_PRE = 2,
+    // 指令执行后：aux = 写寄存器数量，aux * u64 寄存器值（顺序同 INST_DEF）；
+    // TRACE_FLAG_GPR_DELTA 时 aux = 0，GPR 增量（不含 pc）
+    TRACE_REC_INST_POST = 3,
+    // 内存访问：aux = 访问数量，aux * TraceMemAccess
+    TRACE_REC_MEM = 4,
+    // 寄存器指向的内存：aux = TraceDumpKind，u8 写寄存器序号 + u64 address + 内容
+    TRACE_REC_DUMP = 5,
+    // 模块，在第一次被 INST_DEF 引用前出现：u32 module, u64 base, str16 name
+    TRACE_REC_MODULE = 6,
+
+    // 以下为块模式（TRACE_BLOCK）的记录，一个块是 QBDI 的一个 sequence：[start, end) 内连续执行的指令。
+    // GPR 增量：u64 mask（第 i 位表示 GPRState 第 i 个寄存器变化）+ 变化的 u64 值，
+    // 基准为上一条带增量的记录之后的寄存器状态，初始全为 0（见 gpr_delta.h）
+
+    // 块开始：u64 start, u64 end, 进入块时的 GPR 增量
+    TRACE_REC_BLOCK = 7,
+    // 块结束：离开块时的 GPR 增量（相对块开始）
+    TRACE_REC_BLOCK_EXIT = 8,
+    // 块内的内存访问，位于 BLOCK 和 BLOCK_EXIT 之间：aux = 访问数量，aux * TraceBlockMemAccess
+    TRACE_REC_BLOCK_MEM = 9,
+
+    // 可选的 FPR 通道：aux = 寄存器数量，u8 TraceFprKind + aux * (u8 V 寄存器号, u8 lane 位图, 每个 lane 一个 u64)。
+    // 只包含指令操作数中与上一次输出相比变化了的 V 寄存器 lane；READ 紧跟 INST_PRE，WRITE 紧接在 INST_POST 之前
+    TRACE_REC_FPR = 10,
+
+    // 段开始，一次被 trace 的调用：u32 段号, u16 TraceFileFlags, u64 trace 目标, u64 开始时间（CLOCK_REALTIME 毫秒）。
+    // INST_DEF / MODULE 和 GPR / FPR 增量的基准都只在段内有效，每个段开始时重置
+    TRACE_REC_SEGMENT = 11,
+    // 段结束：u32 段号, u64 耗时（微秒）。进程在 trace 中途退出时没有这条记录
+    TRACE_REC_SEGMENT_END = 12,
+
+    // 与本段之前的某个 DUMP 地址和内容都相同的 dump：aux = TraceDumpKind，u8 写寄存器序号 + u64 address + u32 编号。
+    // 编号为本段中 STRING / HEX 类型 DUMP 记录的序号（从 0 开始）
+    TRACE_REC_DUMP_REF = 13,
+};
+
+enum TraceFprKind : uint8_t {
+    TRACE_FPR_READ = 0,     // 指令执行前，读取的 V 寄存器
+    TRACE_FPR_WRITE = 1,    // 指令执行后，写入的 V 寄存器
+};
+
+// INST_DEF 中符号的来源
+enum TraceSymbolKind : uint8_t {
+    TRACE_SYM_NONE = 0,     // 只有地址
+    TRACE_SYM_QBDI = 1,     // QBDI 解析出的符号 + symbolOffset
+    TRACE_SYM_MODULE = 2,   // /proc/self/maps 中的模块 id + 模块内偏移，输出为 "模块[0x偏移]"
+};
+
+enum TraceDumpKind : uint8_t {
+    TRACE_DUMP_STRING = 0,  // 可打印字符串（不含结尾 0）
+    TRACE_DUMP_HEX = 1,     // hexdump 原始字节
+    TRACE_DUMP_INVALID = 2, // 地址有效但读取失败，无内容
+};
+
+enum TraceMemType : uint8_t {
+    TRACE_MEM_READ = 1,
+    TRACE_MEM_WRITE = 2,
+    TRACE_MEM_READ_WRITE = 3,
+};
+
+struct __attribute__((packed)) TraceMemAccess {
+    uint64_t address;
+    uint64_t value;
+    uint16_t size;
+    uint8_t type;       // TraceMemType
+    uint8_t flags;      // QBDI::MemoryAccessFlags
+};
+
+// 块内的内存访问，instAddress 为发起访问的指令
+struct __attribute__((packed)) TraceBlockMemAccess {
+    uint64_t instAddress;
+    TraceMemAccess access;
+};
+
+// GPR 增量中的寄存器个数：x0-x28, x29, lr, sp, nzcv, pc
+#define TRACE_GPR_COUNT 34
+
+#define TRACE_MAX_RECORD 8192
+#define TRACE_MAX_STRING 1024
+
+// 在栈上拼接一条记录，结束后通过 data()/size() 整体写出
+class TraceRecordBuilder {
+public:
+    void begin(uint8_t tag, uint8_t aux = 0) {
+        pos = sizeof(TraceRecordHeader);
+        buf[offsetof(TraceRecordHeader, tag)] = tag;
+        buf[offsetof(TraceRecordHeader, aux)] = aux;
+    }
+
+    void setAux(uint8_t aux) { buf[offsetof(TraceRecordHeader, aux)] = aux; }
+
+    template<typename T>
+    void put(T value) {
+        if (pos + sizeof(T) > sizeof(buf)) {
+            return;
+        }
+        memcpy(buf + pos, &value, sizeof(T));
+        pos += sizeof(T);
+    }
+
+    void putBytes(const void *data, size_t len) {
+        if (pos + len > sizeof(buf)) {
+            len = sizeof(buf) - pos;
+        }
+        memcpy(buf + pos, data, len);
+        pos += len;
+    }
+
+    // u8 长度前缀的字符串（寄存器名）
+    void putString8(const char *str) {
+        size_t len = str ? strnlen(str, 0xff) : 0;
+        put<uint8_t>(len);
+        putBytes(str, len);
+    }
+
+    // u16 长度前缀的字符串（符号 / 反汇编），过长时截断
+    void putString16(const char *str) {
+        size_t len = str ? strnlen(str, TRACE_MAX_STRING) : 0;
+        put<uint16_t>(len);
+        putBytes(str, len);
+    }
+
+    const uint8_t *data() {
+        auto length = (uint16_t) (pos - sizeof(TraceRecordHeader));
+        memcpy(buf + offsetof(TraceRecordHeader, length), &length, sizeof(length));
+        return buf;
+    }
+
+    size_t size() const { return pos; }
+
+private:
+    // 记录头按字节写入 buf，不通过 TraceRecordHeader 指针访问（编译器会把之后的 put 误判为越界写记录头）
+    uint8_t buf[TRACE_MAX_RECORD];
+    size_t pos = 0;
+};
+
+// 顺序读取记录，用于主机端工具
+class TraceRecordReader {
+public:
+    TraceRecordReader(const uint8_t *data, size_t size) : cur(data), end(data + size) {}
+
+    // 读取下一条记录；数据截断（例如进程崩溃）时返回 false
+    bool next(TraceRecordHeader &header, const uint8_t *&payload) {
+        if (end - cur < (ptrdiff_t) sizeof(TraceRecordHeader)) {
+            return false;
+        }
+        memcpy(&header, cur, sizeof(header));
+        if (end - cur < (ptrdiff_t) (sizeof(TraceRecordHeader) + header.length)) {
+            return false;
+        }
+        payload = cur + sizeof(TraceRecordHeader);
+        cur = payload + header.length;
+        return true;
+    }
+
+    const uint8_t *position() const { return cur; }
+
+private:
+    const uint8_t *cur;
+    const uint8_t *end;
+};
+
+// payload 内部的游标，越界时返回 0 / 空串而不是读出界
+class TracePayload {
+public:
+    TracePayload(const uint8_t *data, size_t size) : cur(data), end(data + size) {}
+
+    template<typename T>
+    T get() {
+        T value{};
+        if (end - cur >= (ptrdiff_t) sizeof(T)) {
+            memcpy(&value, cur, sizeof(T));
+            cur += sizeof(T);
+        } else {
+            cur = end;
+        }
+        return value;
+    }
+
+    // 剩余长度不足时返回 nullptr
+    const uint8_t *bytes(size_t len) {
+        if ((size_t) (end - cur) < len) {
+            cur = end;
+            return nullptr;
+        }
+        const uint8_t *p = cur;
+        cur += len;
+        return p;
+    }
+
+    // 读取长度前缀字符串，len 返回长度
+    template<typename L>
+    const char *string(size_t &len) {
+        len = get<L>();
+        const uint8_t *p = bytes(len);
+        if (p == nullptr) {
+            len = 0;
+        }
+        return reinterpret_cast<const char *>(p);
+    }
+
+    size_t remaining() const { return end - cur; }
+
+private:
+    const uint8_t *cur;
+    const uint8_t *end;
+};
+
+#endif //XPOSEDNHOOK_TRACE_RECORD_H
@@ -0,0 +1,91 @@
+//
+// Created by agent on 2026/10/17.
+//
+
+#include "trace_scope.h"
+#include "module_map.h"
+#include "utils.h"
+#include "elfio/elfio.hpp"
+
+// 在模块文件的 .dynsym / .symtab 中按名字精确查找符号，返回相对加载基址的 [start, end)
+static bool findSymbol(const std::string &path, const std::string &symbol, uint64_t &start, uint64_t &end) {
+    ELFIO::elfio elffile;
+    if (!elffile.load(path)) {
+        return false;
+    }
+    for (const char *table: {".dynsym", ".symtab"}) {
+        ELFIO::section *s = elffile.sections[table];
+        if (s == nullptr) {
+            continue;
+        }
+        ELFIO::symbol_section_accessor symbols(elffile, s);
+        std::string name;
+        ELFIO::Elf64_Addr value;
+        ELFIO::Elf_Xword size;
+        unsigned char bind, type, other;
+        ELFIO::Elf_Half sectionIndex;
+        for (ELFIO::Elf_Xword i = 0; i < symbols.get_symbols_num(); ++i) {
+            symbols.get_symbol(i, name, value, size, bind, type, sectionIndex, other);
+            if (size != 0 && sectionIndex != ELFIO::SHN_UNDEF && name == symbol) {
+                start = value;
+                end = value + size;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// 把一项规则解析为绝对地址区间
+static bool resolveRule(const TraceScopeRule &rule, QBDI::rword target, QBDI::Range<QBDI::rword> &range) {
+    uint32_t module;
+    uint64_t offset;
+    if (rule.module.empty()) {
+        if (!moduleMap().lookup(target, module, offset)) {
+            LOGW("trace scope: target %p is not in any module", (void *) target);
+            return false;
+        }
+    } else if (!moduleMap().find(rule.module, module)) {
+        LOGW("trace scope: module %s not loaded", rule.module.c_str());
+        return false;
+    }
+
+    uint64_t base = moduleMap().base(module);
+    uint64_t start, end;
+    if (!rule.symbol.empty()) {
+        if (!findSymbol(moduleMap().path(module), rule.symbol, start, end)) {
+            LOGW("trace scope: symbol %s not found in %s", rule.symbol.c_str(), moduleMap().name(module).c_str());
+            return false;
+        }
+        start += base;
+        end += base;
+    } else if (rule.end != 0) {
+        start = base + rule.start;
+        end = base + rule.end;
+    } else if (!moduleMap().extent(module, start, end)) {
+        return false;
+    }
+    range = QBDI::Range<QBDI::rword>(start, end);
+    return true;
+}
+
+QBDI::RangeSet<QBDI::rword> compileTraceScope(const TraceScope &scope, QBDI::rword target) {
+    QBDI::RangeSet<QBDI::rword> ranges;
+    QBDI::Range<QBDI::rword> range(0, 0);
+    if (scope.include.empty()) {
+        if (resolveRule(TraceScopeRule{}, target, range)) {
+            ranges.add(range);
+        }
+    }
+    for (const auto &rule: scope.include) {
+        if (resolveRule(rule, target, range)) {
+            ranges.add(range);
+        }
+    }
+    for (const auto &rule: scope.exclude) {
+        if (resolveRule(rule, target, range)) {
+            ranges.remove(range);
+        }
+    }
+    return ranges;
+}
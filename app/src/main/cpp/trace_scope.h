@@ -0,0 +1,67 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace 范围：按模块、模块内偏移区间、符号声明要 trace 的代码，再减去排除列表，
+// 编译为 QBDI::RangeSet 后只在这些地址上挂回调。范围外的代码仍在 VM 中执行，但没有任何回调。
+//
+
+#ifndef XPOSEDNHOOK_TRACE_SCOPE_H
+#define XPOSEDNHOOK_TRACE_SCOPE_H
+
+#include "QBDI.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 范围中的一项，按以下顺序取第一个生效的：
+//   symbol 非空    -> 模块中该符号的地址范围（ELF 符号表中的大小）
+//   end 非 0       -> 模块内偏移区间 [start, end)
+//   否则           -> 整个模块
+struct TraceScopeRule {
+    std::string module;     // 模块文件名，例如 "libil2cpp.so"；为空表示 trace 目标所在的模块
+    std::string symbol;
+    uint64_t start = 0;
+    uint64_t end = 0;
+};
+
+struct TraceScope {
+    // 为空时为 trace 目标所在的整个模块，即原来的行为
+    std::vector<TraceScopeRule> include;
+    std::vector<TraceScopeRule> exclude;
+
+    TraceScope &addModule(const char *module) {
+        include.push_back({module, "", 0, 0});
+        return *this;
+    }
+
+    TraceScope &addRange(const char *module, uint64_t start, uint64_t end) {
+        include.push_back({module, "", start, end});
+        return *this;
+    }
+
+    TraceScope &addSymbol(const char *module, const char *symbol) {
+        include.push_back({module, symbol, 0, 0});
+        return *this;
+    }
+
+    TraceScope &excludeModule(const char *module) {
+        exclude.push_back({module, "", 0, 0});
+        return *this;
+    }
+
+    TraceScope &excludeRange(const char *module, uint64_t start, uint64_t end) {
+        exclude.push_back({module, "", start, end});
+        return *this;
+    }
+
+    TraceScope &excludeSymbol(const char *module, const char *symbol) {
+        exclude.push_back({module, symbol, 0, 0});
+        return *this;
+    }
+};
+
+// 按当前的 moduleMap() 把范围编译为绝对地址区间，target 为 trace 的目标地址。
+// 找不到的模块 / 符号会被跳过并输出日志
+QBDI::RangeSet<QBDI::rword> compileTraceScope(const TraceScope &scope, QBDI::rword target);
+
+#endif //XPOSEDNHOOK_TRACE_SCOPE_H
@@ -0,0 +1,219 @@
+//
+// Created by agent on 2026/10/17.
+//
+
+#include "trace_session.h"
+#include "trace_record.h"
+#include "trace_index.h"
+#include "trace_lz.h"
+#include "trace_stats.h"
+#include "utils.h"
+
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+TraceSession &traceSession() {
+    static TraceSession instance;
+    return instance;
+}
+
+static uint64_t nowMs() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 已有的压缩 trace 解压后的长度：各帧 rawSize 之和，只读帧头
+static uint64_t compressedStreamSize(const char *path) {
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    uint64_t size = 0;
+    off_t pos = 0;
+    TraceLzFrame frame{};
+    while (pread(fd, &frame, sizeof(frame), pos) == sizeof(frame) && memcmp(frame.magic, TRACE_LZ_MAGIC, 4) == 0) {
+        size += frame.rawSize;
+        pos += sizeof(frame) + frame.storedSize;
+    }
+    close(fd);
+    return size;
+}
+
+void TraceSession::connectStream(const std::string &path, const TraceConfig &config) {
+    const char *slash = strrchr(path.c_str(), '/');
+    std::string name = slash != nullptr ? slash + 1 : path;
+    std::string address = config.stream;
+    int waitMs = config.streamWaitMs;
+    streamState.store(STREAM_CONNECTING, std::memory_order_relaxed);
+    LOGT("trace session: waiting for trace_collect on %s, not tracing until it connects", address.c_str());
+    // 会话是进程内的静态对象，线程分离，进程退出时不需要等它
+    std::thread([this, name, address, waitMs] {
+        SocketSink *sink = SocketSink::listen(address.c_str(), name.c_str(), waitMs);
+        if (sink == nullptr) {
+            LOGT("trace session: no collector connected on %s within %d ms, streaming disabled", address.c_str(),
+                 waitMs);
+            streamState.store(STREAM_FAILED, std::memory_order_release);
+            return;
+        }
+        socket.reset(sink);
+        LOGT("trace session: collector connected on %s", address.c_str());
+        streamState.store(STREAM_CONNECTED, std::memory_order_release);
+    }).detach();
+}
+
+bool TraceSession::open(const std::string &path, const TraceConfig &config) {
+    // 只在被 admit 的调用中打开，同一时间只有一个调用，不需要加锁
+    if (output != nullptr) {
+        return true;
+    }
+    bool streaming = !config.stream.empty();
+    if (streaming) {
+        int state = streamState.load(std::memory_order_acquire);
+        if (state == STREAM_IDLE) {
+            connectStream(path, config);
+        }
+        if (state != STREAM_CONNECTED) {
+            return false;
+        }
+    }
+    struct stat st{};
+    // 流式导出时每次连接是采集端的一个新文件
+    bool empty = streaming || stat(path.c_str(), &st) != 0 || st.st_size == 0;
+    if (config.durable && !streaming) {
+        durable.reset(MmapSink::open(path.c_str()));
+        if (!durable) {
+            LOGT("trace session: failed to open %s (existing file is not a durable trace?)", path.c_str());
+            return false;
+        }
+        empty = durable->position() == 0;
+        output = durable.get();
+    } else {
+        TraceSink *downstream;
+        if (streaming) {
+            downstream = socket.get();
+        } else {
+            file.reset(FileSink::open(path.c_str(), true));
+            if (!file) {
+                LOGT("trace session: failed to open %s", path.c_str());
+                return false;
+            }
+            downstream = file.get();
+        }
+        if (config.compress) {
+            compressor.reset(new CompressSink(downstream));
+            downstream = compressor.get();
+        }
+        writer.reset(new AsyncTraceWriter(downstream, config.ringSize));
+        output = writer.get();
+    }
+    if (config.binary() && empty) {
+        TraceFileHeader header{{'Q', 'B', 'T', 'R'}, TRACE_VERSION, 0};
+        output->write(&header, sizeof(header));
+    }
+    this->path = path;
+    stats = config.stats;
+
+    if (config.index) {
+        // 追加写入时，本次写出的数据从原有数据之后开始；durable trace 的 position 已经包含原有数据
+        base = empty || durable ? 0 : config.compress ? compressedStreamSize(path.c_str()) : (uint64_t) st.st_size;
+        std::string indexPath = path + ".idx";
+        // 流式导出时索引对应的是采集端的新文件，重新写
+        bool indexEmpty = streaming || stat(indexPath.c_str(), &st) != 0 || st.st_size == 0;
+        indexFile.reset(FileSink::open(indexPath.c_str(), !streaming));
+        if (!indexFile) {
+            LOGT("trace session: failed to open %s", indexPath.c_str());
+        } else if (indexEmpty) {
+            TraceFileHeader header{{'Q', 'B', 'I', 'X'}, TRACE_INDEX_VERSION, 0};
+            indexFile->write(&header, sizeof(header));
+        }
+    }
+    return true;
+}
+
+bool TraceSession::admit(void *target, const TracePolicy &policy, uint32_t &segment) {
+    std::lock_guard<std::mutex> guard(lock);
+    Counter &counter = counters[target];
+    uint64_t call = counter.calls++;
+    int state = streamState.load(std::memory_order_acquire);
+    if (state == STREAM_CONNECTING || state == STREAM_FAILED) {
+        return false;
+    }
+    if (busy || (policy.limit != 0 && counter.traced >= policy.limit)) {
+        return false;
+    }
+    if (policy.every > 1 && call % policy.every != 0) {
+        return false;
+    }
+    uint64_t now = nowMs();
+    if (counter.traced > 0 && now - counter.lastMs < policy.minIntervalMs) {
+        return false;
+    }
+    busy = true;
+    counter.traced++;
+    counter.previousMs = counter.lastMs;
+    counter.lastMs = now;
+    segment = segments++;
+    return true;
+}
+
+void TraceSession::close() {
+    // writer 的析构等写线程写完缓冲区中的数据，之后才能关闭它下游的压缩、文件和 socket
+    indexFile.reset();
+    durable.reset();
+    writer.reset();
+    compressor.reset();
+    file.reset();
+    if (socket) {
+        socket.reset();
+        // 采集端已经收到 END，之后的调用重新等待连接
+        streamState.store(STREAM_IDLE, std::memory_order_release);
+    }
+    output = nullptr;
+    base = 0;
+}
+
+bool TraceSession::finish(void *target, const TracePolicy &policy, bool traced) {
+    // 每个段结束时把数据交给内核（write / 映射的 page cache），进程随时被杀也只丢正在 trace 的段；
+    // 不调用 fsync / msync，系统掉电或重启时仍可能丢失
+    if (traced && output != nullptr) {
+        output->flush();
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    Counter &counter = counters[target];
+    if (!traced) {
+        busy = false;
+        // admit 时分配的段号和计数都还给之后的调用；同一时间只有一个被 admit 的调用，段号可以直接回退
+        counter.traced--;
+        counter.lastMs = counter.previousMs;
+        segments--;
+        return streamState.load(std::memory_order_acquire) != STREAM_FAILED;
+    }
+    LOGT("trace session: %u call(s) of %p traced, %u segment(s) in %s", counter.traced, target, segments,
+         path.c_str());
+    if (stats && !traceStats().write(path + ".stats")) {
+        LOGT("trace session: failed to write %s.stats", path.c_str());
+    }
+    if (socket) {
+        LOGT("trace session: streamed %llu bytes, waited for collector credit %llu times",
+             (unsigned long long) socket->sentBytes(), (unsigned long long) socket->waits());
+    }
+    if (compressor) {
+        LOGT("trace session: compressed %llu -> %llu bytes", (unsigned long long) compressor->rawBytes(),
+             (unsigned long long) compressor->storedBytes());
+    }
+    bool more = policy.limit == 0 || counter.traced < policy.limit;
+    if (!more) {
+        // 会话是静态对象，不会析构，这里关闭输出：durable trace 去掉预分配的尾部，压缩流写完最后一帧。
+        // 关闭期间 busy 保持为 true，别的调用不会 admit 并使用正在关闭的输出
+        guard.unlock();
+        close();
+        guard.lock();
+    }
+    busy = false;
+    return more;
+}
@@ -0,0 +1,94 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 多次 trace：按 TracePolicy 决定 hook 的每次命中是否 trace，被 trace 的调用依次写入
+// 同一个追加写入的 trace 文件，每次调用是一个编号的段。同一时间只 trace 一个调用，
+// 所有段共用一个写线程。
+//
+
+#ifndef XPOSEDNHOOK_TRACE_SESSION_H
+#define XPOSEDNHOOK_TRACE_SESSION_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "trace_writer.h"
+#include "vm.h"
+
+class TraceSession {
+public:
+    // 打开 trace 文件：已存在时追加，新文件写入二进制文件头。已经打开时直接返回。
+    // config.compress 时写线程把数据压缩为独立的 64KB 帧（trace_lz.h）后再写入文件，
+    // config.durable 时回调线程直接写入映射的文件（trace_mmap.h），config.stream 时不写文件，
+    // 发送给主机端采集（trace_stream.h），config.index 时同时打开索引文件 path + ".idx"。
+    // 流式导出时第一次 open 在后台线程上等待采集端连接并返回 false，连接之前不 trace，
+    // 超时没有连接则记为失败，之后不再等待
+    bool open(const std::string &path, const TraceConfig &config);
+
+    // hook 命中一次：按 policy 判断这次调用是否 trace，是则分配段号。
+    // 正在等待采集端连接或连接已失败时不 trace。返回 true 后必须调用 finish
+    bool admit(void *target, const TracePolicy &policy, uint32_t &segment);
+
+    // 被 admit 的调用结束，把段写入文件；traced 为 false（没能打开输出）时撤销这次 admit，
+    // 不占用 policy.limit 和段号。target 达到 policy.limit 时关闭输出（durable trace 去掉预分配的尾部，
+    // 流式导出发送 END），会话对象本身不会析构。返回之后的调用是否还可能被 trace
+    bool finish(void *target, const TracePolicy &policy, bool traced = true);
+
+    // 所有段共用的输出，open 之后有效
+    TraceSink *sink() { return output; }
+
+    // 索引输出，没有打开索引时为空；sink 的位置 0 在 trace 文件中的偏移
+    TraceSink *indexSink() { return indexFile.get(); }
+
+    uint64_t streamBase() const { return base; }
+
+private:
+    enum StreamState {
+        STREAM_IDLE,
+        STREAM_CONNECTING,
+        STREAM_CONNECTED,
+        STREAM_FAILED,
+    };
+
+    // 在后台线程上等待采集端连接，不阻塞被 hook 的线程
+    void connectStream(const std::string &path, const TraceConfig &config);
+
+    // 按打开的反序关闭所有输出，之后的 open 重新打开（追加）
+    void close();
+
+    struct Counter {
+        uint64_t calls = 0;
+        uint32_t traced = 0;
+        uint64_t lastMs = 0;
+        // admit 之前的 lastMs，撤销 admit 时恢复
+        uint64_t previousMs = 0;
+    };
+
+    std::mutex lock;
+    bool busy = false;
+    uint32_t segments = 0;
+    std::unordered_map<void *, Counter> counters;
+
+    std::string path;
+    std::unique_ptr<FileSink> file;
+    std::unique_ptr<SocketSink> socket;
+    // 后台线程连接好之后设置 socket，再以 release 写入 STREAM_CONNECTED
+    std::atomic<int> streamState{STREAM_IDLE};
+    std::unique_ptr<CompressSink> compressor;
+    std::unique_ptr<AsyncTraceWriter> writer;
+    std::unique_ptr<MmapSink> durable;
+    // writer 或 durable
+    TraceSink *output = nullptr;
+    std::unique_ptr<FileSink> indexFile;
+    uint64_t base = 0;
+    // 每段结束后写出 tracer 开销统计（trace 文件名 + ".stats"）
+    bool stats = false;
+};
+
+// 进程内共用的 trace 会话
+TraceSession &traceSession();
+
+#endif //XPOSEDNHOOK_TRACE_SESSION_H
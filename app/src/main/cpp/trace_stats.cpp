@@ -0,0 +1,91 @@
+//
+// Created by agent on 2026/10/17.
+//
+
+#include "trace_stats.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+thread_local TraceStats tlsStats;
+
+TraceStatsTotal &traceStats() {
+    static TraceStatsTotal instance;
+    return instance;
+}
+
+// 每秒的 tick 数
+static uint64_t statFrequency() {
+#if defined(__aarch64__)
+    uint64_t value;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(value));
+    return value;
+#else
+    return 1000000000;
+#endif
+}
+
+void TraceStatsTotal::collect(uint64_t wallUs) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (int i = 0; i < STAT_KIND_COUNT; ++i) {
+        total.ticks[i] += tlsStats.ticks[i];
+        total.calls[i] += tlsStats.calls[i];
+    }
+    for (int i = 0; i < STAT_SYSCALLS; ++i) {
+        total.syscallTicks[i] += tlsStats.syscallTicks[i];
+        total.syscallCalls[i] += tlsStats.syscallCalls[i];
+    }
+    segments++;
+    this->wallUs += wallUs;
+    memset(&tlsStats, 0, sizeof(tlsStats));
+}
+
+static const char *const STAT_NAMES[STAT_KIND_COUNT] = {
+        "pre", "post", "mem", "block", "analysis", "validate", "read", "emit",
+};
+
+bool TraceStatsTotal::write(const std::string &path) {
+    std::lock_guard<std::mutex> guard(lock);
+    FILE *out = fopen(path.c_str(), "we");
+    if (out == nullptr) {
+        return false;
+    }
+    double nsPerTick = 1e9 / (double) statFrequency();
+    auto ms = [&](uint64_t ticks) { return ticks * nsPerTick / 1e6; };
+    auto line = [&](const char *name, uint64_t ticks, uint64_t calls) {
+        fprintf(out, "%-12s %12" PRIu64 " %12.3f %10.1f %6.1f%%\n", name, calls, ms(ticks),
+                calls ? ticks * nsPerTick / calls : 0.0, wallUs ? ms(ticks) * 100000.0 / wallUs : 0.0);
+    };
+
+    fprintf(out, "# %" PRIu64 " traced call(s), %.3f ms wall time\n", segments, wallUs / 1000.0);
+    fprintf(out, "%-12s %12s %12s %10s %7s\n", "# callback", "calls", "ms", "ns/call", "wall");
+    for (int i = STAT_PRE; i <= STAT_BLOCK; ++i) {
+        line(STAT_NAMES[i], total.ticks[i], total.calls[i]);
+    }
+
+    // format 为回调中扣除 validate / read / emit 后剩下的部分，主要是文本格式化或记录编码；
+    // vm 为总耗时中扣除所有回调和插桩后剩下的部分，即 QBDI 翻译和执行被 trace 代码本身
+    fprintf(out, "%-12s %12s %12s %10s %7s\n", "# stage", "calls", "ms", "ns/call", "wall");
+    for (int i = STAT_ANALYSIS; i <= STAT_EMIT; ++i) {
+        line(STAT_NAMES[i], total.ticks[i], total.calls[i]);
+    }
+    uint64_t callbacks = total.ticks[STAT_PRE] + total.ticks[STAT_POST] + total.ticks[STAT_BLOCK];
+    uint64_t nested = total.ticks[STAT_VALIDATE] + total.ticks[STAT_READ] + total.ticks[STAT_EMIT];
+    uint64_t format = callbacks > nested ? callbacks - nested : 0;
+    line("format", format, 0);
+    uint64_t wallTicks = (uint64_t) (wallUs * 1000.0 / nsPerTick);
+    uint64_t inside = callbacks + total.ticks[STAT_ANALYSIS];
+    line("vm", wallTicks > inside ? wallTicks - inside : 0, 0);
+
+    fprintf(out, "%-12s %12s %12s %10s %7s\n", "# syscall", "calls", "ms", "ns/call", "wall");
+    for (int i = 0; i < STAT_SYSCALLS; ++i) {
+        if (total.syscallCalls[i] != 0) {
+            char name[16];
+            snprintf(name, sizeof(name), i == STAT_SYSCALLS - 1 ? ">=%d" : "%d", i);
+            line(name, total.syscallTicks[i], total.syscallCalls[i]);
+        }
+    }
+    fclose(out);
+    return true;
+}
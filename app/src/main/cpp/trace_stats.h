@@ -0,0 +1,107 @@
+//
+// Created by agent on 2026/10/17.
+//
+// tracer 自身的开销统计（TraceConfig::stats）：每种回调、每个阶段和每个系统调用的次数与耗时。
+// 计数在回调线程的 thread_local 中累加，不加锁；每次调用结束（vm::end）并入全局的合计，
+// trace 会话在每段结束后把合计写到 trace 文件名 + ".stats"。
+// 计时用 aarch64 的 cntvct_el0（其他平台为 CLOCK_MONOTONIC 纳秒），换算成纳秒只在输出时进行。
+//
+
+#ifndef XPOSEDNHOOK_TRACE_STATS_H
+#define XPOSEDNHOOK_TRACE_STATS_H
+
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string>
+
+enum TraceStatKind {
+    // 回调（包含其中的阶段）
+    STAT_PRE,           // 指令执行前
+    STAT_POST,          // 指令执行后，包含 STAT_MEM
+    STAT_MEM,           // 读取并输出内存访问
+    STAT_BLOCK,         // 块模式 / profile / 覆盖率模式的块回调
+    // 阶段
+    STAT_ANALYSIS,      // 插桩回调：生成指令模板（翻译时，每条指令一次）
+    STAT_VALIDATE,      // 写寄存器的值是否为可读地址（maps 快照查询）
+    STAT_READ,          // 读取寄存器指向的内存
+    STAT_EMIT,          // 写入 sink（环形缓冲区）
+    STAT_KIND_COUNT,
+};
+
+// 按调用号统计的系统调用（被 trace 代码中的 SVC），超出范围的计入最后一项
+#define STAT_SYSCALLS 512
+
+struct TraceStats {
+    uint64_t ticks[STAT_KIND_COUNT];
+    uint64_t calls[STAT_KIND_COUNT];
+    uint64_t syscallTicks[STAT_SYSCALLS];
+    uint64_t syscallCalls[STAT_SYSCALLS];
+    uint64_t svcStart;      // 当前 SVC 执行前的时间
+};
+
+// 当前线程的计数
+extern thread_local TraceStats tlsStats;
+
+static inline uint64_t statTicks() {
+#if defined(__aarch64__)
+    uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+// 作用域内的耗时计入 kind，enabled 为 false 时不读时钟
+class StatScope {
+public:
+    StatScope(bool enabled, TraceStatKind kind) : kind(kind), start(enabled ? statTicks() : 0) {}
+
+    ~StatScope() {
+        if (start != 0) {
+            tlsStats.ticks[kind] += statTicks() - start;
+            tlsStats.calls[kind]++;
+        }
+    }
+
+private:
+    TraceStatKind kind;
+    uint64_t start;
+};
+
+static inline void statSyscallBegin() {
+    tlsStats.svcStart = statTicks();
+}
+
+static inline void statSyscallEnd(uint64_t number) {
+    if (tlsStats.svcStart == 0) {
+        return;
+    }
+    size_t slot = number < STAT_SYSCALLS ? number : STAT_SYSCALLS - 1;
+    tlsStats.syscallTicks[slot] += statTicks() - tlsStats.svcStart;
+    tlsStats.syscallCalls[slot]++;
+    tlsStats.svcStart = 0;
+}
+
+// 所有线程、所有段的合计
+class TraceStatsTotal {
+public:
+    // 把当前线程的计数并入合计并清零，wallUs 为这次调用的总耗时
+    void collect(uint64_t wallUs);
+
+    // 写出合计，覆盖原有文件
+    bool write(const std::string &path);
+
+private:
+    std::mutex lock;
+    TraceStats total{};
+    uint64_t segments = 0;
+    uint64_t wallUs = 0;
+};
+
+TraceStatsTotal &traceStats();
+
+#endif //XPOSEDNHOOK_TRACE_STATS_H
@@ -0,0 +1,92 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace 流式导出（TraceConfig::stream）的协议：设备端在抽象 Unix socket 或本机 TCP 端口上监听，
+// 主机端 tools/trace_collect 连接（adb forward tcp:5555 localabstract:qbdi_trace）后接收并写入文件。
+// 设备 -> 主机为帧：TraceStreamFrame + length 字节负载，依次为 HELLO、若干 DATA、END；
+// 主机 -> 设备为 credit：每条 4 字节，授予设备端可以再发送的 DATA 负载字节数。
+// 连接后采集端先授予 TRACE_STREAM_WINDOW，之后每写完一个 DATA 帧归还相应的字节数，
+// 设备端 credit 用完时等待，写线程停下后环形缓冲区被填满，回调线程随之等待，不丢数据。
+// 设备端和主机端 tools 共用，不要引入 android / QBDI 头文件。
+//
+
+#ifndef XPOSEDNHOOK_TRACE_STREAM_H
+#define XPOSEDNHOOK_TRACE_STREAM_H
+
+#include <arpa/inet.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define TRACE_STREAM_MAGIC "QBST"
+#define TRACE_STREAM_VERSION 1
+// DATA 帧的最大负载
+#define TRACE_STREAM_FRAME (64 << 10)
+// 采集端初始授予的 credit，即传输中（已发送、未写入主机文件）的最大字节数
+#define TRACE_STREAM_WINDOW (4 << 20)
+// HELLO 中文件名的最大长度
+#define TRACE_STREAM_NAME_MAX 255
+
+enum TraceStreamType : uint32_t {
+    TRACE_STREAM_HELLO = 1,     // 负载：uint32 版本 + 文件名（不含目录，无结尾 0）
+    TRACE_STREAM_DATA = 2,      // 负载：trace 文件的下一段数据
+    TRACE_STREAM_END = 3,       // 正常结束，无负载；没有 END 就断开说明设备端进程已退出
+};
+
+struct TraceStreamFrame {
+    char magic[4];              // "QBST"
+    uint32_t type;              // TraceStreamType
+    uint32_t length;            // 负载字节数
+};
+
+// 解析地址："unix:名字" 为抽象 Unix socket，"tcp:端口" / "tcp:IPv4:端口" 为 TCP，地址默认为 127.0.0.1
+inline bool traceStreamAddress(const char *spec, sockaddr_storage &addr, socklen_t &len) {
+    memset(&addr, 0, sizeof(addr));
+    if (strncmp(spec, "unix:", 5) == 0) {
+        const char *name = spec + 5;
+        auto un = reinterpret_cast<sockaddr_un *>(&addr);
+        size_t n = strlen(name);
+        if (n == 0 || n >= sizeof(un->sun_path)) {
+            return false;
+        }
+        un->sun_family = AF_UNIX;
+        // sun_path[0] 为 0：抽象命名空间，不需要可写的目录
+        memcpy(un->sun_path + 1, name, n);
+        len = (socklen_t) (offsetof(sockaddr_un, sun_path) + 1 + n);
+        return true;
+    }
+    if (strncmp(spec, "tcp:", 4) == 0) {
+        const char *host = "127.0.0.1";
+        char buffer[64];
+        const char *port = spec + 4;
+        const char *colon = strrchr(port, ':');
+        if (colon != nullptr) {
+            size_t n = colon - port;
+            if (n >= sizeof(buffer)) {
+                return false;
+            }
+            memcpy(buffer, port, n);
+            buffer[n] = '\0';
+            host = buffer;
+            port = colon + 1;
+        }
+        char *end;
+        long value = strtol(port, &end, 10);
+        auto in = reinterpret_cast<sockaddr_in *>(&addr);
+        if (*port == '\0' || *end != '\0' || value <= 0 || value > 65535 ||
+            inet_pton(AF_INET, host, &in->sin_addr) != 1) {
+            return false;
+        }
+        in->sin_family = AF_INET;
+        in->sin_port = htons((uint16_t) value);
+        len = sizeof(sockaddr_in);
+        return true;
+    }
+    return false;
+}
+
+#endif //XPOSEDNHOOK_TRACE_STREAM_H
@@ -0,0 +1,475 @@
+//
+// Created by agent on 2026/10/17.
+//
+
+#include "trace_writer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 缓冲区有数据但不足一个 batch 时写线程的轮询间隔，以及最多等待几轮就写出零头
+#define WRITER_POLL_US 1000
+#define WRITER_MAX_IDLE 10
+// SocketSink 关闭时等待采集端断开的时间
+#define SOCKET_CLOSE_MS 1000
+
+FileSink::~FileSink() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+FileSink *FileSink::open(const char *path, bool append) {
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+    int fd = ::open(path, flags, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+    return new FileSink(fd);
+}
+
+bool FileSink::write(const void *data, size_t len) {
+    auto p = static_cast<const uint8_t *>(data);
+    while (len > 0) {
+        ssize_t n = ::write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool CompressSink::write(const void *data, size_t len) {
+    auto p = static_cast<const uint8_t *>(data);
+    while (len > 0) {
+        size_t n = std::min(len, sizeof(raw) - pending);
+        memcpy(raw + pending, p, n);
+        pending += n;
+        p += n;
+        len -= n;
+        if (pending == sizeof(raw) && !writeFrame()) {
+            return false;
+        }
+    }
+    return !failed;
+}
+
+void CompressSink::flush() {
+    if (pending > 0) {
+        writeFrame();
+    }
+    downstream->flush();
+}
+
+bool CompressSink::writeFrame() {
+    auto header = reinterpret_cast<TraceLzFrame *>(frame);
+    uint8_t *body = frame + sizeof(TraceLzFrame);
+    size_t size = lzCompress(raw, pending, body, table);
+    memcpy(header->magic, TRACE_LZ_MAGIC, 4);
+    header->rawSize = pending;
+    header->flags = 0;
+    if (size >= pending) {
+        // 不可压缩的数据原样保存，解压时直接复制
+        memcpy(body, raw, pending);
+        size = pending;
+        header->flags = TRACE_LZ_STORED;
+    }
+    header->storedSize = size;
+    rawTotal += pending;
+    storedTotal += sizeof(TraceLzFrame) + size;
+    pending = 0;
+    if (!failed && !downstream->write(frame, sizeof(TraceLzFrame) + size)) {
+        failed = true;
+    }
+    return !failed;
+}
+
+MmapSink::~MmapSink() {
+    if (segment != nullptr) {
+        munmap(segment, segmentSize);
+    }
+    munmap(header, TRACE_MMAP_HEADER);
+    // 正常关闭时去掉预分配的部分，失败时文件仍然可读
+    int ret = ftruncate(fd, (off_t) (TRACE_MMAP_HEADER + committed));
+    (void) ret;
+    close(fd);
+}
+
+MmapSink *MmapSink::open(const char *path) {
+    int fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+    // 先校验已有的文件头，不是 durable trace 的文件不做任何修改
+    TraceMmapHeader existing{};
+    ssize_t n = pread(fd, &existing, sizeof(existing), 0);
+    bool created = n == 0;
+    if (!created && (n != sizeof(existing) || memcmp(existing.magic, TRACE_MMAP_MAGIC, 4) != 0 ||
+                     existing.version != TRACE_MMAP_VERSION || existing.headerSize != TRACE_MMAP_HEADER ||
+                     existing.segmentSize == 0 || existing.segmentSize % TRACE_MMAP_HEADER != 0)) {
+        close(fd);
+        return nullptr;
+    }
+    void *p = MAP_FAILED;
+    if (!created || ftruncate(fd, TRACE_MMAP_HEADER) == 0) {
+        p = mmap(nullptr, TRACE_MMAP_HEADER, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (p == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    auto header = static_cast<TraceMmapHeader *>(p);
+    if (created) {
+        memcpy(header->magic, TRACE_MMAP_MAGIC, 4);
+        header->version = TRACE_MMAP_VERSION;
+        header->headerSize = TRACE_MMAP_HEADER;
+        header->segmentSize = TRACE_MMAP_SEGMENT;
+        header->committed = 0;
+    }
+    auto sink = new MmapSink(fd);
+    sink->header = header;
+    sink->segmentSize = header->segmentSize;
+    sink->committed = __atomic_load_n(&header->committed, __ATOMIC_ACQUIRE);
+    return sink;
+}
+
+bool MmapSink::mapSegment(uint64_t index) {
+    if (segment != nullptr) {
+        munmap(segment, segmentSize);
+        segment = nullptr;
+    }
+    off_t offset = (off_t) (TRACE_MMAP_HEADER + index * segmentSize);
+    off_t end = offset + segmentSize;
+    // 预先分配磁盘空间，写映射时不会因为空间不足收到 SIGBUS；文件系统不支持时退回扩展文件长度
+    if (posix_fallocate(fd, offset, segmentSize) != 0) {
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || (st.st_size < end && ftruncate(fd, end) != 0)) {
+            return false;
+        }
+    }
+    // MAP_POPULATE 一次建好所有页表项，写入时不再缺页
+    void *p = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    segment = static_cast<uint8_t *>(p);
+    segmentIndex = index;
+    return true;
+}
+
+bool MmapSink::write(const void *data, size_t len) {
+    auto p = static_cast<const uint8_t *>(data);
+    uint64_t pos = committed;
+    while (len > 0) {
+        uint64_t index = pos / segmentSize;
+        if (index != segmentIndex && !mapSegment(index)) {
+            return false;
+        }
+        size_t offset = pos % segmentSize;
+        size_t n = std::min<size_t>(len, segmentSize - offset);
+        memcpy(segment + offset, p, n);
+        pos += n;
+        p += n;
+        len -= n;
+    }
+    // 数据全部复制后才提交，读取方看到的 committed 之前都是完整的记录
+    __atomic_store_n(&header->committed, pos, __ATOMIC_RELEASE);
+    committed = pos;
+    return true;
+}
+
+SocketSink::~SocketSink() {
+    if (!failed && sendFrame(TRACE_STREAM_END, nullptr, 0)) {
+        // 采集端收到 END 后断开。先读完它归还的 credit 再关闭：接收缓冲区中还有未读数据时关闭 socket，
+        // 对端收到 ECONNRESET，还没读取的最后几帧和 END 随之丢失。采集端不响应时最多等待 SOCKET_CLOSE_MS
+        shutdown(fd, SHUT_WR);
+        pollfd wait{fd, POLLIN, 0};
+        uint8_t buffer[256];
+        while (poll(&wait, 1, SOCKET_CLOSE_MS) == 1 && recv(fd, buffer, sizeof(buffer), 0) > 0) {
+        }
+    }
+    close(fd);
+}
+
+SocketSink *SocketSink::listen(const char *address, const char *name, int timeoutMs) {
+    sockaddr_storage addr{};
+    socklen_t addrLen;
+    size_t nameLen = strlen(name);
+    if (!traceStreamAddress(address, addr, addrLen) || nameLen > TRACE_STREAM_NAME_MAX) {
+        return nullptr;
+    }
+    int server = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server < 0) {
+        return nullptr;
+    }
+    int one = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    pollfd wait{server, POLLIN, 0};
+    if (bind(server, reinterpret_cast<sockaddr *>(&addr), addrLen) != 0 || ::listen(server, 1) != 0 ||
+        poll(&wait, 1, timeoutMs) != 1) {
+        close(server);
+        return nullptr;
+    }
+    // 只接受一个采集端，之后不再监听
+    int fd = accept4(server, nullptr, nullptr, SOCK_CLOEXEC);
+    close(server);
+    if (fd < 0) {
+        return nullptr;
+    }
+    auto sink = new SocketSink(fd);
+    uint8_t hello[sizeof(uint32_t) + TRACE_STREAM_NAME_MAX];
+    uint32_t version = TRACE_STREAM_VERSION;
+    memcpy(hello, &version, sizeof(version));
+    memcpy(hello + sizeof(version), name, nameLen);
+    if (!sink->sendFrame(TRACE_STREAM_HELLO, hello, sizeof(version) + nameLen)) {
+        delete sink;
+        return nullptr;
+    }
+    return sink;
+}
+
+bool SocketSink::sendFrame(TraceStreamType type, const void *data, size_t len) {
+    TraceStreamFrame frame{{'Q', 'B', 'S', 'T'}, type, (uint32_t) len};
+    iovec parts[2] = {{&frame, sizeof(frame)}, {const_cast<void *>(data), len}};
+    msghdr msg{};
+    msg.msg_iov = parts;
+    msg.msg_iovlen = len > 0 ? 2 : 1;
+    while (msg.msg_iovlen > 0) {
+        // MSG_NOSIGNAL：采集端断开时返回 EPIPE 而不是用 SIGPIPE 杀掉进程
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failed = true;
+            return false;
+        }
+        while (msg.msg_iovlen > 0 && (size_t) n >= msg.msg_iov->iov_len) {
+            n -= (ssize_t) msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = static_cast<uint8_t *>(msg.msg_iov->iov_base) + n;
+            msg.msg_iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+bool SocketSink::awaitCredit(size_t len) {
+    if (credit < len) {
+        waitCount++;
+    }
+    while (credit < len) {
+        uint8_t buffer[256];
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            failed = true;
+            return false;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            pending[pendingLen++] = buffer[i];
+            if (pendingLen == sizeof(pending)) {
+                uint32_t grant;
+                memcpy(&grant, pending, sizeof(grant));
+                credit += grant;
+                pendingLen = 0;
+            }
+        }
+    }
+    return true;
+}
+
+bool SocketSink::write(const void *data, size_t len) {
+    auto p = static_cast<const uint8_t *>(data);
+    while (len > 0 && !failed) {
+        size_t n = std::min<size_t>(len, TRACE_STREAM_FRAME);
+        if (!awaitCredit(n) || !sendFrame(TRACE_STREAM_DATA, p, n)) {
+            break;
+        }
+        credit -= n;
+        sent += n;
+        p += n;
+        len -= n;
+    }
+    return !failed;
+}
+
+static size_t roundUpPow2(size_t n) {
+    size_t v = 4096;
+    while (v < n) {
+        v <<= 1;
+    }
+    return v;
+}
+
+TraceRing::TraceRing(size_t capacity) {
+    capacity = roundUpPow2(capacity);
+    buf.reset(new uint8_t[capacity]);
+    mask = capacity - 1;
+}
+
+size_t TraceRing::write(const void *data, size_t len) {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_acquire);
+    len = std::min(len, capacity() - (h - t));
+    if (len == 0) {
+        return 0;
+    }
+    size_t off = h & mask;
+    size_t first = std::min(len, capacity() - off);
+    memcpy(buf.get() + off, data, first);
+    memcpy(buf.get(), static_cast<const uint8_t *>(data) + first, len - first);
+    head.store(h + len, std::memory_order_release);
+    return len;
+}
+
+size_t TraceRing::peek(const uint8_t *&ptr) const {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    size_t off = t & mask;
+    ptr = buf.get() + off;
+    return std::min(h - t, capacity() - off);
+}
+
+void TraceRing::consume(size_t n) {
+    tail.store(tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+}
+
+AsyncTraceWriter::AsyncTraceWriter(TraceSink *downstream, size_t capacity, size_t batch)
+        : ring(capacity), downstream(downstream), batch(std::min(batch, ring.capacity() / 2)) {
+    thread = std::thread(&AsyncTraceWriter::run, this);
+}
+
+AsyncTraceWriter::~AsyncTraceWriter() {
+    close();
+}
+
+bool AsyncTraceWriter::write(const void *data, size_t len) {
+    auto p = static_cast<const uint8_t *>(data);
+    while (len > 0) {
+        size_t n = ring.write(p, len);
+        // 只计入真正进入缓冲区的字节，下游出错返回 false 后位置仍与已写出的数据一致
+        produced += n;
+        p += n;
+        len -= n;
+        if (n > 0) {
+            wake();
+        }
+        if (len > 0) {
+            // 缓冲区满：让出 CPU 等写线程，trace 速度被磁盘限制而不是丢数据
+            if (failed.load(std::memory_order_relaxed) || !thread.joinable()) {
+                return false;
+            }
+            stallCount++;
+            sched_yield();
+        }
+    }
+    return true;
+}
+
+void AsyncTraceWriter::flush() {
+    if (!thread.joinable()) {
+        return;
+    }
+    uint64_t seq = flushRequest.fetch_add(1, std::memory_order_acq_rel) + 1;
+    wake();
+    std::unique_lock<std::mutex> guard(lock);
+    flushed.wait(guard, [&] { return flushDone.load(std::memory_order_acquire) >= seq; });
+}
+
+void AsyncTraceWriter::close() {
+    if (!thread.joinable()) {
+        return;
+    }
+    stopping.store(true, std::memory_order_release);
+    wake();
+    thread.join();
+    downstream->flush();
+}
+
+void AsyncTraceWriter::wake() {
+    // 与 park() 中的 sleeping 写入和重新检查配对（Dekker 式的两个 seq_cst 栅栏），
+    // 写线程醒着时这里只有一次原子读，不加锁
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> guard(lock);
+        wakeup.notify_one();
+    }
+}
+
+void AsyncTraceWriter::park() {
+    std::unique_lock<std::mutex> guard(lock);
+    sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    wakeup.wait(guard, [&] {
+        return ring.readable() > 0 || stopping.load(std::memory_order_acquire) ||
+               flushRequest.load(std::memory_order_acquire) != flushDone.load(std::memory_order_relaxed);
+    });
+    sleeping.store(false, std::memory_order_relaxed);
+}
+
+void AsyncTraceWriter::drain() {
+    const uint8_t *ptr;
+    size_t n;
+    while ((n = ring.peek(ptr)) > 0) {
+        // 下游出错后继续消费，避免生产者永远等待
+        if (!failed.load(std::memory_order_relaxed) && !downstream->write(ptr, n)) {
+            failed.store(true, std::memory_order_relaxed);
+        }
+        ring.consume(n);
+    }
+}
+
+void AsyncTraceWriter::run() {
+    int idle = 0;
+    while (true) {
+        bool stop = stopping.load(std::memory_order_acquire);
+        uint64_t request = flushRequest.load(std::memory_order_acquire);
+        bool flushing = request != flushDone.load(std::memory_order_relaxed);
+        size_t avail = ring.readable();
+
+        // 攒够一个 batch 再写，保证大块顺序写；数据停留太久、flush 或退出时写出零头
+        if (avail >= batch || (avail > 0 && (idle >= WRITER_MAX_IDLE || stop || flushing))) {
+            drain();
+            idle = 0;
+            continue;
+        }
+        if (flushing) {
+            downstream->flush();
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                flushDone.store(request, std::memory_order_release);
+            }
+            flushed.notify_all();
+            continue;
+        }
+        if (stop) {
+            break;
+        }
+        if (avail == 0) {
+            // 没有数据时不轮询，等下一次 write / flush / close
+            park();
+            idle = 0;
+            continue;
+        }
+        usleep(WRITER_POLL_US);
+        idle++;
+    }
+}
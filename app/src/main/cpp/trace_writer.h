@@ -0,0 +1,226 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace 输出：回调线程只把数据拷进定长的无锁环形缓冲区，
+// 由后台写线程批量顺序写入文件，内存占用与 trace 长度无关。
+//
+
+#ifndef XPOSEDNHOOK_TRACE_WRITER_H
+#define XPOSEDNHOOK_TRACE_WRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "trace_lz.h"
+#include "trace_mmap.h"
+#include "trace_stream.h"
+
+// trace 数据的输出目标
+class TraceSink {
+public:
+    virtual ~TraceSink() = default;
+
+    // 写入全部数据，失败返回 false
+    virtual bool write(const void *data, size_t len) = 0;
+
+    // 把已写入的数据交给下一层（文件 / 内核）
+    virtual void flush() {}
+
+    // 已写入的总字节数，用于索引中的偏移；不统计时为 0
+    virtual uint64_t position() const { return 0; }
+};
+
+// 直接写文件描述符
+class FileSink : public TraceSink {
+public:
+    explicit FileSink(int fd) : fd(fd) {}
+
+    ~FileSink() override;
+
+    // 打开（创建）文件，失败返回 nullptr
+    static FileSink *open(const char *path, bool append = false);
+
+    bool write(const void *data, size_t len) override;
+
+private:
+    int fd;
+};
+
+// 压缩后写入下游：攒满 TRACE_LZ_FRAME 字节压缩为一个独立的帧，flush 时写出不足一帧的部分。
+// 放在 AsyncTraceWriter 和文件之间，压缩在写线程中进行
+class CompressSink : public TraceSink {
+public:
+    explicit CompressSink(TraceSink *downstream) : downstream(downstream) {}
+
+    bool write(const void *data, size_t len) override;
+
+    void flush() override;
+
+    // 原始 / 写出的字节数
+    uint64_t rawBytes() const { return rawTotal; }
+
+    uint64_t storedBytes() const { return storedTotal; }
+
+private:
+    bool writeFrame();
+
+    TraceSink *downstream;
+    bool failed = false;
+    size_t pending = 0;
+    uint64_t rawTotal = 0;
+    uint64_t storedTotal = 0;
+    uint8_t raw[TRACE_LZ_FRAME];
+    uint8_t frame[sizeof(TraceLzFrame) + TRACE_LZ_BOUND(TRACE_LZ_FRAME)];
+    TraceLzTable table;
+};
+
+// 写入 MAP_SHARED 映射的 durable trace 文件（trace_mmap.h）：直接复制到映射中，再更新文件头的 committed，
+// 除了每 TRACE_MMAP_SEGMENT 字节扩展一次文件外没有系统调用，不需要环形缓冲区和写线程。
+// 只保证数据进入 page cache，不做 fsync / msync。析构时把文件截断到已提交的长度。
+// 只能由一个线程写入
+class MmapSink : public TraceSink {
+public:
+    ~MmapSink() override;
+
+    // 打开（创建）文件，已有的 durable trace 从 committed 处继续写；已有其他内容的文件不会被覆盖，返回 nullptr
+    static MmapSink *open(const char *path);
+
+    bool write(const void *data, size_t len) override;
+
+    // 已提交的数据长度，即下一条记录在数据部分中的偏移
+    uint64_t position() const override { return committed; }
+
+private:
+    explicit MmapSink(int fd) : fd(fd) {}
+
+    // 映射（必要时扩展文件）第 index 个数据段，替换当前的映射
+    bool mapSegment(uint64_t index);
+
+    int fd;
+    TraceMmapHeader *header = nullptr;
+    uint32_t segmentSize = TRACE_MMAP_SEGMENT;
+    uint8_t *segment = nullptr;
+    uint64_t segmentIndex = UINT64_MAX;
+    uint64_t committed = 0;
+};
+
+// 通过 socket 发给主机端的 tools/trace_collect（trace_stream.h）：每次 write 拆成不超过 TRACE_STREAM_FRAME 的
+// DATA 帧发送，credit 不足时阻塞等待采集端归还。放在 AsyncTraceWriter 之后，由写线程批量发送；
+// 采集端断开后 write 返回 false，之后的数据被丢弃而 trace 照常进行。析构时发送 END，等待采集端读完后断开
+class SocketSink : public TraceSink {
+public:
+    ~SocketSink() override;
+
+    // 在 address（见 traceStreamAddress）上监听，最多等待 timeoutMs 毫秒直到采集端连接，
+    // 然后发送 HELLO，name 为采集端写入的文件名。失败返回 nullptr
+    static SocketSink *listen(const char *address, const char *name, int timeoutMs);
+
+    bool write(const void *data, size_t len) override;
+
+    // 已发送的 DATA 字节数，以及因 credit 不足而等待的次数
+    uint64_t sentBytes() const { return sent; }
+
+    uint64_t waits() const { return waitCount; }
+
+private:
+    explicit SocketSink(int fd) : fd(fd) {}
+
+    bool sendFrame(TraceStreamType type, const void *data, size_t len);
+
+    // 读取采集端的 credit，直到至少有 len 字节可用
+    bool awaitCredit(size_t len);
+
+    int fd;
+    bool failed = false;
+    uint64_t credit = 0;
+    uint64_t sent = 0;
+    uint64_t waitCount = 0;
+    // 不完整的 credit 消息
+    uint8_t pending[4] = {};
+    size_t pendingLen = 0;
+};
+
+// 单生产者单消费者无锁环形缓冲区，容量为 2 的幂
+class TraceRing {
+public:
+    explicit TraceRing(size_t capacity);
+
+    // 生产者：尽量写入，返回实际写入的字节数（空间不足时可能小于 len）
+    size_t write(const void *data, size_t len);
+
+    // 消费者：返回从读位置开始的连续可读字节数
+    size_t peek(const uint8_t *&ptr) const;
+
+    // 消费者：释放已处理的 n 个字节
+    void consume(size_t n);
+
+    size_t readable() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    std::unique_ptr<uint8_t[]> buf;
+    size_t mask;
+    // 生产者和消费者各自的位置放在不同缓存行，避免伪共享
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+// 回调线程写环形缓冲区，后台写线程批量写入下游 sink。
+// 写线程只在缓冲区有数据时轮询攒 batch，缓冲区空闲时睡在条件变量上，由 write / flush / close 唤醒
+class AsyncTraceWriter : public TraceSink {
+public:
+    // capacity: 环形缓冲区大小；batch: 攒够多少字节后写一次下游
+    explicit AsyncTraceWriter(TraceSink *downstream, size_t capacity = 8 << 20, size_t batch = 256 << 10);
+
+    ~AsyncTraceWriter() override;
+
+    // 缓冲区满时等待写线程腾出空间，不丢数据
+    bool write(const void *data, size_t len) override;
+
+    // 等待缓冲区中的数据全部写入下游
+    void flush() override;
+
+    // 写完剩余数据并停止写线程
+    void close();
+
+    // 生产者因缓冲区满而等待的次数
+    uint64_t stalls() const { return stallCount; }
+
+    uint64_t position() const override { return produced; }
+
+private:
+    void run();
+
+    // 写出缓冲区中当前所有数据
+    void drain();
+
+    // 写线程睡眠时唤醒它
+    void wake();
+
+    // 写线程：缓冲区为空且没有 flush / close 请求时睡眠
+    void park();
+
+    TraceRing ring;
+    TraceSink *downstream;
+    size_t batch;
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> failed{false};
+    std::atomic<uint64_t> flushRequest{0};
+    std::atomic<uint64_t> flushDone{0};
+    std::atomic<bool> sleeping{false};
+    std::mutex lock;
+    std::condition_variable wakeup;     // 写线程等待数据或请求
+    std::condition_variable flushed;    // flush() 等待写线程完成
+    uint64_t stallCount = 0;
+    uint64_t produced = 0;      // 已进入缓冲区的字节数
+};
+
+#endif //XPOSEDNHOOK_TRACE_WRITER_H
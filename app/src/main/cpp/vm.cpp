@@ -1,309 +1,655 @@
 #include "vm.h"
 #include "assert.h"
-#include "hexdump.h"
 #include "utils.h"
-
+#include "module_map.h"
+#include "safe_read.h"
+#include "gpr_delta.h"
+#include "trace_stats.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+#include <ctime>
 #include <unordered_map>
-#include <sys/uio.h>
 #include <unistd.h>
-#include <errno.h>
 #include <cstring>
-#include <sstream>
+#include <dlfcn.h>
 #include <string>
 
 using namespace std;
 using namespace QBDI;
 
 
-// 地址范围的结构体，用于缓存 maps 文件中的每个模块范围
-struct MemoryRange {
-    uint64_t startAddr;
-    uint64_t endAddr;
-    std::string pathname;
-};
+// 判断地址是否在有效内存页上，查 maps 快照，不再调用 sysconf + mincore
+static inline bool isValidAddress(class vm *thiz, uint64_t address) {
+    return thiz->regions.isMapped(address);
+}
 
-// 缓存地址范围和已解析的符号信息
-std::unordered_map<uint64_t, std::string> symbolCache;
-std::vector<MemoryRange> memoryRanges;
 
-// 从 /proc/self/maps 读取并缓存模块地址范围
-void loadMemoryRanges() {
-    std::ifstream mapsFile("/proc/self/maps");
-    std::string line;
+// 判断内存内容是否为有效的 ASCII 可打印字符串，且不为全空格
+bool isAsciiPrintableString(const uint8_t* data, size_t length) {
+    if (data == nullptr) {
+        LOGD("Error: data is NULL");
+        return false;  // 数据为空，返回无效字符串
+    }
 
-    while (std::getline(mapsFile, line)) {
-        std::istringstream iss(line);
-        std::string addrRange, perms, offset, dev, inode, pathname;
-        uint64_t startAddr, endAddr;
+    bool hasNonSpaceChar = false;  // 标记是否包含非空格字符
+    for (size_t i = 0; i < length; ++i) {
+        if (data[i] == '\0') {
+            return hasNonSpaceChar;  // 如果遇到终止符，且包含非空格字符，则认为是有效字符串
+        }
+        if (data[i] < 0x20 || data[i] > 0x7E) {
+            return false;  // 如果包含非 ASCII 可打印字符，视为无效字符串
+        }
+        if (data[i] != ' ') {
+            hasNonSpaceChar = true;  // 检测到非空格字符
+        }
+    }
+    return hasNonSpaceChar;  // 字符串没有终止符时，检查是否包含非空格字符
+}
 
-        // 解析 maps 文件的一行内容
-        iss >> addrRange >> perms >> offset >> dev >> inode;
-        if (!(iss >> pathname)) {
-            pathname = ""; // 如果没有路径，将其设为空字符串
+// 全部为可打印字符且没有遇到结尾 0，需要继续读取才能确定字符串长度
+static inline bool isPrintableRun(const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (data[i] < 0x20 || data[i] > 0x7E) {
+            return false;
         }
+    }
+    return true;
+}
 
+// 探测本条指令所有写寄存器指向的内存，结果在 emitter.probes 中，顺序同 tpl->writes。
+// 先统一读 PROBE_HEAD 字节，足够区分 hexdump 和短字符串；只有开头全是可打印字符的才再读到 PROBE_MAX
+static void probePointers(class vm *thiz, QBDI::GPRState *gprState, const InstTemplate *tpl) {
+    size_t count = tpl->writes.size();
+    if (thiz->readSlots.size() < count) {
+        thiz->readSlots.resize(count);
+    }
+    auto &probes = thiz->emitter.probes;
+    auto &slots = thiz->readSlots;
+    bool stats = thiz->config.stats;
+
+    {
+        StatScope stat(stats, STAT_VALIDATE);
+        for (size_t i = 0; i < count; ++i) {
+            auto &probe = probes[i];
+            probe.value = QBDI_GPR_GET(gprState, tpl->writes[i].ctxIdx);
+            probe.valid = isValidAddress(thiz, probe.value);
+            // 快照中不可读（例如保护页）的直接跳过，不去触发异常；快照过期时由 safeRead 兜底
+            bool readable = probe.valid && thiz->regions.readableBytes(probe.value, 1) > 0;
+            slots[i] = {probe.value, probe.buffer, readable ? (size_t) PROBE_HEAD : 0, 0};
+        }
+    }
+    {
+        StatScope stat(stats, STAT_READ);
+        safeReadScatter(slots.data(), count);
+    }
+
+    // 第二轮：开头 PROBE_HEAD 字节都是可打印字符的，继续读剩余部分
+    size_t more = 0;
+    for (size_t i = 0; i < count; ++i) {
+        probes[i].len = slots[i].read;
+        if (slots[i].read == PROBE_HEAD && isPrintableRun(probes[i].buffer, PROBE_HEAD)) {
+            slots[i] = {probes[i].value + PROBE_HEAD, probes[i].buffer + PROBE_HEAD, PROBE_MAX - PROBE_HEAD, 0};
+            more++;
+        } else {
+            slots[i].length = 0;
+        }
+    }
+    if (more > 0) {
+        StatScope stat(stats, STAT_READ);
+        safeReadScatter(slots.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            probes[i].len += slots[i].read;
+        }
+    }
 
-        size_t pos = pathname.find_last_of('/');
-        std::string filename = (pos == std::string::npos) ? pathname : pathname.substr(pos + 1);
+    // 读到的字节数 len -> 输出类型和长度
+    for (size_t i = 0; i < count; ++i) {
+        auto &probe = probes[i];
+        if (!probe.valid) {
+            continue;
+        }
+        size_t got = probe.len;
+        if (got == 0) {
+            probe.kind = TRACE_DUMP_INVALID;
+        } else if (isAsciiPrintableString(probe.buffer, got)) {
+            probe.kind = TRACE_DUMP_STRING;
+            probe.len = strnlen(reinterpret_cast<const char *>(probe.buffer), got);
+        } else {
+            probe.kind = TRACE_DUMP_HEX;
+            probe.len = std::min<size_t>(got, PROBE_HEAD);  // 显示32字节内容
+        }
+    }
+}
 
+static_assert(offsetof(QBDI::GPRState, pc) == TRACE_GPR_PC * sizeof(QBDI::rword),
+              "GPRState layout does not match TRACE_GPR_COUNT");
 
-        // 解析地址范围
-        std::replace(addrRange.begin(), addrRange.end(), '-', ' ');
-        std::istringstream addrStream(addrRange);
-        addrStream >> std::hex >> startAddr >> endAddr;
+// GPRState 开头的 TRACE_GPR_COUNT 个寄存器：x0-x28, x29, lr, sp, nzcv, pc
+static inline const uint64_t *gprWords(const QBDI::GPRState *gprState) {
+    return reinterpret_cast<const uint64_t *>(gprState);
+}
 
-        // 添加到缓存的内存范围
-        memoryRanges.push_back({startAddr, endAddr, filename});
-    }
+// FPRState 开头的 v0-v31，每个两个 u64
+static inline const uint64_t *fprWords(const QBDI::FPRState *fprState) {
+    return reinterpret_cast<const uint64_t *>(fprState);
 }
 
-// 从缓存中查找地址范围内的符号信息
-std::string getSymbolFromCache(uint64_t address) {
-    // 检查缓存
-    if (symbolCache.find(address) != symbolCache.end()) {
-        return symbolCache[address];
+// 操作数寄存器名（B0 / H0 / S0 / D0 / Q0 / V0）对应的 V 寄存器号，不是向量寄存器时返回 -1
+static int fprRegister(const char *name) {
+    if (name == nullptr || name[0] == 0 || strchr("BHSDQVbhsdqv", name[0]) == nullptr) {
+        return -1;
     }
+    char *end;
+    long reg = strtol(name + 1, &end, 10);
+    if (end == name + 1 || *end != 0 || reg < 0 || reg > 31) {
+        return -1;
+    }
+    return (int) reg;
+}
 
-    // 遍历已缓存的地址范围
-    for (const auto& range : memoryRanges) {
-        if (address >= range.startAddr && address < range.endAddr) {
-            uint64_t addrOffset = address - range.startAddr;
-            std::ostringstream symbolStream;
-            symbolStream << range.pathname << "[0x" << std::hex << addrOffset << "]";
-            std::string symbol = symbolStream.str();
-
-            // 将结果存入缓存
-            symbolCache[address] = symbol;
-            return symbol;
-        }
+// 本条指令的内存访问，转换为记录格式放在 thiz->accesses 中
+static size_t collectMemoryAccess(QBDI::VM *vm, class vm *thiz) {
+    auto accesses = vm->getInstMemoryAccess();
+    thiz->accesses.clear();
+    for (const auto &acc: accesses) {
+        thiz->accesses.push_back({acc.accessAddress, acc.value, acc.size,
+                                  static_cast<uint8_t>(acc.type), static_cast<uint8_t>(acc.flags)});
     }
+    return thiz->accesses.size();
+}
 
-    // 未找到时返回空字符串
-    symbolCache[address] = "";  // 记录无符号信息，避免重复查找
-    return "";
+// ---------------- 文本模式 ----------------
+
+// 显示指令执行前的寄存器状态
+QBDI::VMAction showPreInstruction(QBDI::VM *vm, QBDI::GPRState *gprState, QBDI::FPRState *fprState, void *data) {
+    auto tpl = (InstTemplate *) data;
+    auto thiz = tpl->owner;
+    StatScope stat(thiz->config.stats, STAT_PRE);
+    thiz->emitter.textPre(tpl, gprWords(gprState), fprWords(fprState));
+    return QBDI::VMAction::CONTINUE;
 }
 
-// 判断地址是否在有效内存页上
-bool isValidAddress(uint64_t address) {
-    if (address == 0x7603511e){
-//        LOGE("address : %p",address);
-//        return false;
+// 显示指令执行后的寄存器状态 打印字符串 hexdump，最后输出内存访问
+QBDI::VMAction showPostInstruction(QBDI::VM *vm, QBDI::GPRState *gprState, QBDI::FPRState *fprState, void *data) {
+    auto tpl = (InstTemplate *) data;
+    auto thiz = tpl->owner;
+    StatScope stat(thiz->config.stats, STAT_POST);
+    // 一次读取所有写寄存器指向的内存
+    if (!tpl->writes.empty()) {
+        probePointers(thiz, gprState, tpl);
     }
-    // 获取系统页大小
-    long pageSize = sysconf(_SC_PAGESIZE);
-    if (pageSize <= 0) {
-        return false;
+    thiz->emitter.textPost(tpl, gprWords(gprState), fprWords(fprState));
+    if (tpl->accessMemory) {
+        StatScope memStat(thiz->config.stats, STAT_MEM);
+        size_t count = collectMemoryAccess(vm, thiz);
+        thiz->emitter.textMemory(thiz->accesses.data(), count);
     }
+    thiz->emitter.flushText();
+    return QBDI::VMAction::CONTINUE;
+}
 
-    // 对齐地址到页大小
-    void* alignedAddress = reinterpret_cast<void*>(address & ~(pageSize - 1));
-    unsigned char vec;
+// ---------------- 二进制记录模式 ----------------
+// 回调中只拼接定长记录，文本由主机端 tools/trace_render 还原
 
-    // 使用 mincore 检查该地址是否为有效内存页
-    if (mincore(alignedAddress, pageSize, &vec) == 0) {
-        return true;  // 地址有效
-    }
-    return false;  // 地址无效
+static inline bool isTracedRead(const OperandAnalysis &op) {
+    return (op.regAccess == REGISTER_READ || op.regAccess == REGISTER_READ_WRITE) &&
+           op.regCtxIdx != -1 && op.type == OPERAND_GPR;
 }
 
+static inline bool isTracedWrite(const OperandAnalysis &op) {
+    return (op.regAccess == REGISTER_WRITE || op.regAccess == REGISTER_READ_WRITE) &&
+           op.regCtxIdx != -1 && op.type == OPERAND_GPR;
+}
 
-// 判断内存内容是否为有效的 ASCII 可打印字符串，且不为全空格
-bool isAsciiPrintableString(const uint8_t* data, size_t length) {
-    if (data == nullptr) {
-        LOGD("Error: data is NULL");
-        return false;  // 数据为空，返回无效字符串
-    }
+// 指令执行前：地址 + 读寄存器的值；GPR 增量模式下为地址 + 除 pc 外的寄存器增量
+QBDI::VMAction recordPreInstruction(QBDI::VM *vm, QBDI::GPRState *gprState, QBDI::FPRState *fprState, void *data) {
+    auto tpl = (InstTemplate *) data;
+    auto thiz = tpl->owner;
+    StatScope stat(thiz->config.stats, STAT_PRE);
+    thiz->emitter.recordPre(tpl, gprWords(gprState), fprWords(fprState));
+    return QBDI::VMAction::CONTINUE;
+}
 
-    bool hasNonSpaceChar = false;  // 标记是否包含非空格字符
-    for (size_t i = 0; i < length; ++i) {
-        if (data[i] == '\0') {
-            return hasNonSpaceChar;  // 如果遇到终止符，且包含非空格字符，则认为是有效字符串
-        }
-        if (data[i] < 0x20 || data[i] > 0x7E) {
-            return false;  // 如果包含非 ASCII 可打印字符，视为无效字符串
-        }
-        if (data[i] != ' ') {
-            hasNonSpaceChar = true;  // 检测到非空格字符
-        }
+// 指令执行后：写寄存器的值、这些值指向的内存，以及内存访问
+QBDI::VMAction recordPostInstruction(QBDI::VM *vm, QBDI::GPRState *gprState, QBDI::FPRState *fprState, void *data) {
+    auto tpl = (InstTemplate *) data;
+    auto thiz = tpl->owner;
+    StatScope stat(thiz->config.stats, STAT_POST);
+    if (!tpl->writes.empty()) {
+        probePointers(thiz, gprState, tpl);
     }
-    return hasNonSpaceChar;  // 字符串没有终止符时，检查是否包含非空格字符
+    thiz->emitter.recordPost(tpl, gprWords(gprState), fprWords(fprState));
+    if (tpl->accessMemory) {
+        StatScope memStat(thiz->config.stats, STAT_MEM);
+        size_t count = collectMemoryAccess(vm, thiz);
+        thiz->emitter.recordMemory(thiz->accesses.data(), count);
+    }
+    return QBDI::VMAction::CONTINUE;
 }
 
-// 使用 process_vm_readv 安全读取内存的函数
-bool safeReadMemory(uint64_t address, uint8_t* buffer, size_t length) {
-    struct iovec local_iov;
-    struct iovec remote_iov;
+// sequence [start, end) 中的指令数：按翻译缓存中每条指令的实际长度逐条累加，按起始地址缓存。
+// 取不到分析结果时按 A64 的 4 字节计
+static uint32_t sequenceInstructions(class vm *thiz, QBDI::VM *vm, uint64_t start, uint64_t end) {
+    auto &cached = thiz->sequenceLengths[start];
+    if (cached.end == end) {
+        return cached.instructions;
+    }
+    uint32_t count = 0;
+    for (uint64_t address = start; address < end; ++count) {
+        const InstAnalysis *analysis = vm->getCachedInstAnalysis(address, QBDI::ANALYSIS_INSTRUCTION);
+        address += analysis != nullptr && analysis->instSize != 0 ? analysis->instSize : 4;
+    }
+    cached = {end, count};
+    return count;
+}
 
-    local_iov.iov_base = buffer;
-    local_iov.iov_len = length;
+// ---------------- 块模式 ----------------
+// 每个块只在进出时各回调一次，记录寄存器增量和块内的内存访问，由 tools/trace_render 展开为逐条指令
 
-    remote_iov.iov_base = reinterpret_cast<void*>(address);
-    remote_iov.iov_len = length;
+// 进入块：块的地址范围 + 寄存器增量
+static QBDI::VMAction onBlockEntry(QBDI::VM *vm, const QBDI::VMState *vmState, QBDI::GPRState *gprState,
+                                   QBDI::FPRState *fprState, void *data) {
+    auto thiz = (class vm *) data;
+    StatScope stat(thiz->config.stats, STAT_BLOCK);
+    thiz->inBlock = thiz->scopeRanges.contains(vmState->sequenceStart);
+    if (!thiz->inBlock) {
+        return QBDI::VMAction::CONTINUE;
+    }
+    // 块模式的检查点在块开始处，指令序号按块内实际的指令数累加
+    uint32_t instructions = sequenceInstructions(thiz, vm, vmState->sequenceStart, vmState->sequenceEnd);
+    thiz->emitter.blockEntry(vmState->sequenceStart, vmState->sequenceEnd, instructions, gprWords(gprState));
+    return QBDI::VMAction::CONTINUE;
+}
 
-    ssize_t nread = process_vm_readv(getpid(), &local_iov, 1, &remote_iov, 1, 0);
-    if (nread == static_cast<ssize_t>(length)) {
-        return true;  // 成功读取
-    } else {
-        // 可以记录错误信息，便于调试
-//        LOGE("process_vm_readv failed at address 0x%lx: %s", address, strerror(errno));
-        return false;  // 读取失败
+// 离开块：块内全部内存访问 + 寄存器增量
+static QBDI::VMAction onBlockExit(QBDI::VM *vm, const QBDI::VMState *vmState, QBDI::GPRState *gprState,
+                                  QBDI::FPRState *fprState, void *data) {
+    auto thiz = (class vm *) data;
+    StatScope stat(thiz->config.stats, STAT_BLOCK);
+    if (!thiz->inBlock) {
+        return QBDI::VMAction::CONTINUE;
     }
+    thiz->inBlock = false;
+
+    auto accesses = vm->getBBMemoryAccess();
+    thiz->blockAccesses.clear();
+    for (const auto &acc: accesses) {
+        thiz->blockAccesses.push_back({acc.instAddress,
+                                       {acc.accessAddress, acc.value, acc.size,
+                                        static_cast<uint8_t>(acc.type), static_cast<uint8_t>(acc.flags)}});
+    }
+    thiz->emitter.blockMemory(thiz->blockAccesses.data(), thiz->blockAccesses.size());
+    thiz->emitter.blockExit(gprWords(gprState));
+    return QBDI::VMAction::CONTINUE;
 }
 
+// ---------------- profile 模式 ----------------
+// 每个 sequence 开始时回调一次，调用指令执行后回调一次，不格式化、不写 sink，段结束时才输出统计
 
-// 显示指令执行后的寄存器状态 打印字符串 hexdump
-QBDI::VMAction showPostInstruction(QBDI::VM *vm, QBDI::GPRState *gprState, QBDI::FPRState *fprState, void *data) {
+// sequence 开始：弹出已经返回的帧，范围内的指令计入当前调用路径
+static QBDI::VMAction onProfileSequence(QBDI::VM *vm, const QBDI::VMState *vmState, QBDI::GPRState *gprState,
+                                        QBDI::FPRState *fprState, void *data) {
     auto thiz = (class vm *) data;
+    StatScope stat(thiz->config.stats, STAT_BLOCK);
+    bool counted = thiz->scopeRanges.contains(vmState->sequenceStart);
+    thiz->profile->execute(vmState->sequenceStart, gprState->sp,
+                           sequenceInstructions(thiz, vm, vmState->sequenceStart, vmState->sequenceEnd), counted);
+    return QBDI::VMAction::CONTINUE;
+}
 
-    // 获取当前指令的分析信息，包括指令、符号、操作数等
-    const QBDI::InstAnalysis *instAnalysis = vm->getInstAnalysis(QBDI::ANALYSIS_INSTRUCTION | QBDI::ANALYSIS_SYMBOL | QBDI::ANALYSIS_DISASSEMBLY | QBDI::ANALYSIS_OPERANDS);
-
-    std::stringstream output;
-    std::stringstream regOutput;
+// BL / BLR 执行后：pc 为被调用函数，lr 为返回地址
+static QBDI::VMAction onProfileCall(QBDI::VM *vm, QBDI::GPRState *gprState, QBDI::FPRState *fprState, void *data) {
+    auto thiz = (class vm *) data;
+    thiz->profile->call(gprState->pc, gprState->lr, gprState->sp);
+    return QBDI::VMAction::CONTINUE;
+}
 
-    // 遍历操作数并记录写入的寄存器状态
-    for (int i = 0; i < instAnalysis->numOperands; ++i) {
-        auto op = instAnalysis->operands[i];
-        if (op.regAccess == REGISTER_WRITE || op.regAccess == REGISTER_READ_WRITE) {
-            if (op.regCtxIdx != -1 && op.type == OPERAND_GPR) {
-                // 获取寄存器值
-                uint64_t regValue = QBDI_GPR_GET(gprState, op.regCtxIdx);
-
-                // 输出寄存器名称和值
-                output << op.regName << "=0x" << std::hex << regValue << " ";
-                output.flush();
-
-                // 对可能为地址的寄存器值进行 hexdump 或字符串输出，仅在值为有效地址时执行
-                if (isValidAddress(regValue)) {
-                    const uint8_t* dataPtr = reinterpret_cast<const uint8_t*>(regValue);
-                    size_t maxLen = 256;  // 最大显示字节数
-                    uint8_t buffer[256];
-                    if (safeReadMemory(regValue, buffer, maxLen)) {
-                        if (isAsciiPrintableString(buffer, maxLen)) {
-                            regOutput << "Strings :" << std::string(reinterpret_cast<const char*>(buffer)) << "\n";
-                        } else {
-                            regOutput << "Hexdump for " << op.regName << " at address 0x" << std::hex << regValue << ":\n";
-                            hexdump_memory(regOutput, buffer, 32, regValue);  // 显示32字节内容
-                        }
-                    } else {
-                        regOutput << "Invalid memory access at address 0x" << std::hex << regValue << "\n";
-                    }
-                }
-            }
-        }
+// 函数名：动态符号表中正好在入口处的符号，否则为 "模块+0x偏移"
+static std::string functionName(uint64_t address) {
+    Dl_info info{};
+    if (dladdr((void *) address, &info) != 0 && info.dli_sname != nullptr && (uint64_t) info.dli_saddr == address) {
+        return info.dli_sname;
     }
+    char name[64];
+    uint32_t module;
+    uint64_t offset;
+    if (moduleMap().lookup(address, module, offset)) {
+        snprintf(name, sizeof(name), "+0x%" PRIx64, offset);
+        return moduleMap().name(module) + name;
+    }
+    snprintf(name, sizeof(name), "0x%" PRIx64, address);
+    return name;
+}
 
-    // 如果有写入的寄存器信息，格式化输出；否则，仅换行
-    if (!output.str().empty()) {
-        thiz->logbuf << "\tw[" << output.str() << "]" << std::endl;
-        thiz->logbuf << regOutput.str();
-    } else {
-        thiz->logbuf << std::endl;
-        thiz->logbuf << regOutput.str();
+// 段结束：按函数汇总的表和 folded stack 直接写入 sink
+static void writeProfile(class vm *thiz) {
+    std::unordered_map<uint64_t, std::string> names;
+    for (uint64_t function: thiz->profile->functions()) {
+        names.emplace(function, functionName(function));
     }
-    return QBDI::VMAction::CONTINUE;
+    std::string out;
+    thiz->profile->report(out, names);
+    thiz->emitter.writeText(out.data(), out.size());
 }
 
+// ---------------- 覆盖率模式 ----------------
 
-// 显示指令执行前的寄存器状态
-QBDI::VMAction showPreInstruction(QBDI::VM *vm, QBDI::GPRState *gprState, QBDI::FPRState *fprState, void *data) {
+// 进入块：范围内的块更新边位图，不做任何格式化和输出
+static QBDI::VMAction onCoverageBlock(QBDI::VM *vm, const QBDI::VMState *vmState, QBDI::GPRState *gprState,
+                                      QBDI::FPRState *fprState, void *data) {
     auto thiz = (class vm *) data;
+    StatScope stat(thiz->config.stats, STAT_BLOCK);
+    if (thiz->scopeRanges.contains(vmState->basicBlockStart)) {
+        thiz->coverageCursor.enter(*thiz->coverage, vmState->basicBlockStart);
+    }
+    return QBDI::VMAction::CONTINUE;
+}
 
-    // 获取当前指令的分析信息
-    const QBDI::InstAnalysis *instAnalysis = vm->getInstAnalysis(QBDI::ANALYSIS_INSTRUCTION | QBDI::ANALYSIS_SYMBOL | QBDI::ANALYSIS_DISASSEMBLY | QBDI::ANALYSIS_OPERANDS);
+// ---------------- 插桩 ----------------
 
-    // 输出符号名和偏移量，如果没有符号，则仅输出地址和反汇编信息
-    if (instAnalysis->symbol != nullptr) {
-        thiz->logbuf << instAnalysis->symbol << "[0x" << std::hex << instAnalysis->symbolOffset << "]:0x" << instAnalysis->address << ": " << instAnalysis->disassembly;
-    } else {
-        std::string symbolInfo = getSymbolFromCache(instAnalysis->address);
-        if (!symbolInfo.empty()) {
-            thiz->logbuf << symbolInfo << ":0x" << std::hex << instAnalysis->address << ": " << instAnalysis->disassembly;
-        } else {
-            // 如果 /proc/self/maps 中也找不到对应信息，仅输出地址和反汇编信息
-            thiz->logbuf << "0x" << std::hex << instAnalysis->address << ": " << instAnalysis->disassembly;
-        }
+// 生成指令模板：从指令分析中取出符号、模块和操作数，交给 emitter 生成文本行首或 INST_DEF。
+// 同一地址被重新翻译时复用已有模板
+static InstTemplate *buildTemplate(class vm *thiz, const InstAnalysis *instAnalysis) {
+    auto found = thiz->emitter.templates.find(instAnalysis->address);
+    if (found != thiz->emitter.templates.end()) {
+        return found->second.get();
+    }
+    InstInfo info{};
+    info.address = instAnalysis->address;
+    info.size = instAnalysis->instSize;
+    info.disassembly = instAnalysis->disassembly;
+    info.symbol = instAnalysis->symbol;
+    info.offset = instAnalysis->symbolOffset;
+    info.module = -1;
+    info.mayAccessMemory = instAnalysis->mayLoad || instAnalysis->mayStore;
+    uint32_t module;
+    uint64_t offset;
+    if (info.symbol == nullptr && moduleMap().lookup(instAnalysis->address, module, offset)) {
+        info.module = (int32_t) module;
+        info.offset = offset;
+        info.moduleName = moduleMap().name(module);
+        info.moduleBase = moduleMap().base(module);
     }
 
-    std::stringstream output;
-    // 遍历操作数并记录读取的寄存器状态
     for (int i = 0; i < instAnalysis->numOperands; ++i) {
-        auto op = instAnalysis->operands[i];
-        if (op.regAccess == QBDI::REGISTER_READ || op.regAccess == REGISTER_READ_WRITE) {
-            if (op.regCtxIdx != -1 && op.type == OPERAND_GPR) {
-                // 将寄存器名称和值添加到输出流
-                output << op.regName << "=0x" << std::hex << QBDI_GPR_GET(gprState, op.regCtxIdx) << " ";
-                output.flush();
-            }
+        const auto &op = instAnalysis->operands[i];
+        TracedReg reg{op.regCtxIdx, 0, {}};
+        strncpy(reg.name, op.regName ? op.regName : "", sizeof(reg.name) - 1);
+        reg.nameLen = strlen(reg.name);
+        if (isTracedRead(op)) {
+            info.reads.push_back(reg);
+        }
+        if (isTracedWrite(op)) {
+            info.writes.push_back(reg);
+        }
+        // 向量 / 浮点操作数只记录寄存器号，执行时和快照比较
+        int fpr = thiz->config.traceFpr && op.type == OPERAND_FPR ? fprRegister(op.regName) : -1;
+        if (fpr >= 0 && (op.regAccess & REGISTER_READ)) {
+            info.fprReads |= 1u << fpr;
+        }
+        if (fpr >= 0 && (op.regAccess & REGISTER_WRITE)) {
+            info.fprWrites |= 1u << fpr;
         }
     }
+    return thiz->emitter.prepare(info, thiz);
+}
+
+// 被 trace 代码直接发起的系统调用（x8 为调用号）改变了内存映射时，让 maps 快照失效
+// stats 时同时统计系统调用的耗时（SVC 执行前由 onSyscallEntry 记下开始时间）
+static QBDI::VMAction onSyscall(QBDI::VM *vm, QBDI::GPRState *gprState, QBDI::FPRState *fprState, void *data) {
+    auto thiz = (class vm *) data;
+    if (thiz->config.stats) {
+        statSyscallEnd(QBDI_GPR_GET(gprState, 8));
+    }
+    if (MemoryRegions::isMappingSyscall(QBDI_GPR_GET(gprState, 8))) {
+        thiz->regions.invalidate();
+    }
+    return QBDI::VMAction::CONTINUE;
+}
+
+static QBDI::VMAction onSyscallEntry(QBDI::VM *vm, QBDI::GPRState *gprState, QBDI::FPRState *fprState, void *data) {
+    statSyscallBegin();
+    return QBDI::VMAction::CONTINUE;
+}
 
-    // 如果有读取的寄存器信息，格式化输出
-    if (!output.str().empty()) {
-        thiz->logbuf << "\tr[" << output.str() << "]";
+// 调用未插桩的 libc mmap / munmap / mprotect / mremap 时让 maps 快照失效，返回后的查询会重新加载
+static QBDI::VMAction onExecTransferCall(QBDI::VM *vm, const QBDI::VMState *vmState, QBDI::GPRState *gprState,
+                                        QBDI::FPRState *fprState, void *data) {
+    auto thiz = (class vm *) data;
+    if (MemoryRegions::isMappingCall(QBDI_GPR_GET(gprState, QBDI::REG_PC))) {
+        thiz->regions.invalidate();
     }
     return QBDI::VMAction::CONTINUE;
 }
 
-// 显示指令执行时的内存访问
-QBDI::VMAction
-showMemoryAccess(QBDI::VM *vm, QBDI::GPRState *gprState, QBDI::FPRState *fprState,
-                 void *data) {
+// 插桩回调：每条指令翻译时调用一次，执行时的回调直接拿到模板，不再调用 getInstAnalysis
+static std::vector<InstrRuleDataCBK> instrumentInstruction(QBDI::VM *vm, const InstAnalysis *instAnalysis, void *data) {
     auto thiz = (class vm *) data;
-    if (vm->getInstMemoryAccess().empty()) {
-        thiz->logbuf << std::endl;
-    }
-    for (const auto &acc: vm->getInstMemoryAccess()) {
-        if (acc.type == MEMORY_READ) {
-            thiz->logbuf << "   mem[r]:0x" << std::hex << acc.accessAddress << " size:" << acc.size
-                         << " value:0x" << acc.value;
-        } else if (acc.type == MEMORY_WRITE) {
-            thiz->logbuf << "   mem[w]:0x" << std::hex << acc.accessAddress << " size:" << acc.size
-                         << " value:0x" << acc.value;
-        } else {
-            thiz->logbuf << "   mem[rw]:0x" << std::hex << acc.accessAddress << " size:" << acc.size
-                         << " value:0x" << acc.value;
+    StatScope stat(thiz->config.stats, STAT_ANALYSIS);
+    // 规则的范围可能包含已经移出 trace 范围的地址（模块卸载后），以当前的范围为准
+    if (!thiz->scopeRanges.contains(instAnalysis->address)) {
+        return {};
+    }
+    if (thiz->config.granularity == TRACE_PROFILE) {
+        // profile 模式不需要模板，只在调用指令上挂回调
+        if (instAnalysis->isCall) {
+            return {{QBDI::POSTINST, onProfileCall, thiz}};
         }
+        return {};
     }
-    thiz->logbuf << std::endl << std::endl;
-    return QBDI::VMAction::CONTINUE;
+    InstTemplate *tpl = buildTemplate(thiz, instAnalysis);
+    if (thiz->config.granularity == TRACE_BLOCK) {
+        return {};  // 块模式只需要 INST_DEF，执行时没有逐条指令的回调
+    }
+    bool binary = thiz->config.binary();
+    return {
+            {QBDI::PREINST, binary ? recordPreInstruction : showPreInstruction, tpl},
+            {QBDI::POSTINST, binary ? recordPostInstruction : showPostInstruction, tpl},
+    };
 }
 
-// 初始化虚拟机，并设置代码和内存回调
-QBDI::VM vm::init(void *address) {
+// 初始化虚拟机，并设置插桩规则
+bool vm::init(void *address) {
     uint32_t cid;
     QBDI::GPRState *state;
-    QBDI::VM qvm{};
 
-    loadMemoryRanges();//解析一次maps
+    target = address;
+    moduleMap().load();//解析一次maps
+    regions.load();
+    safeReadInstall();
 
     // 获取虚拟机的通用寄存器状态
     state = qvm.getGPRState();
+    initialGpr = *state;
+    initialFpr = *qvm.getFPRState();
 
     // 设置虚拟机选项，禁用本地监视器，绕过PAUTH（指针认证），启用BTI（分支目标指示）
     qvm.setOptions(QBDI::OPT_DISABLE_LOCAL_MONITOR | QBDI::OPT_BYPASS_PAUTH | QBDI::OPT_ENABLE_BTI);
     assert(state != nullptr);
 
-    // 设置记录内存访问的模式
-    qvm.recordMemoryAccess(QBDI::MEMORY_READ_WRITE);
+    // 设置记录内存访问的模式，内存访问在指令执行后的回调中读取；profile / 覆盖率模式不需要
+    bool profiling = config.granularity == TRACE_PROFILE;
+    bool covering = config.granularity == TRACE_COVERAGE;
+    if (!profiling && !covering && config.traceMemory) {
+        qvm.recordMemoryAccess(QBDI::MEMORY_READ_WRITE);
+    }
+    if (!config.traceRegisters) {
+        config.gprDelta = false;
+    }
+    TraceEmitOptions &output = emitter.options;
+    output.binary = config.binary();
+    output.blocks = config.granularity == TRACE_BLOCK;
+    output.gprDelta = config.gprDelta && config.granularity == TRACE_INSTRUCTION;
+    output.traceRegisters = config.traceRegisters;
+    output.traceMemory = config.traceMemory;
+    output.dedupDumps = config.dedupDumps;
+    output.stats = config.stats;
+    output.indexInterval = config.indexInterval;
+
+    // 根据传入地址对模块添加插装，确保指令回调和内存回调生效
+    scopeRanges = compileTraceScope(config.scope, reinterpret_cast<QBDI::rword>(address));
+    moduleGeneration = moduleMap().generation();
+    if (!instrumentModules()) {
+        return false;
+    }
 
-    // 添加指令执行前的回调
-    cid = qvm.addCodeCB(QBDI::PREINST, showPreInstruction, this);
-    assert(cid != QBDI::INVALID_EVENTID);
+    // 覆盖率模式只有一个块进入的回调，没有指令级的插桩
+    if (covering) {
+        coverage.reset(new CoverageMap());
+        coverage->reset();
+        cid = qvm.addVMEventCB(QBDI::BASIC_BLOCK_ENTRY, onCoverageBlock, this);
+        assert(cid != QBDI::INVALID_EVENTID);
+        return true;
+    }
 
-    // 添加指令执行后的回调
-    cid = qvm.addCodeCB(QBDI::POSTINST, showPostInstruction, this);
-    assert(cid != QBDI::INVALID_EVENTID);
+    // trace 范围内的指令翻译时生成模板，并挂上指令执行前后的回调
+    scopeRule = addScopeRule(scopeRanges);
+
+    // profile 模式：sequence 开始时计数并检查返回，调用指令上的回调维护影子栈
+    if (profiling) {
+        profile.reset(new CallProfile(config.profileNodes));
+        cid = qvm.addVMEventCB(QBDI::SEQUENCE_ENTRY, onProfileSequence, this);
+        assert(cid != QBDI::INVALID_EVENTID);
+        return true;
+    }
+
+    // 块模式：QBDI 的 sequence 是连续执行的一段指令，getBBMemoryAccess 在 SEQUENCE_EXIT 中取得其内存访问
+    if (config.granularity == TRACE_BLOCK) {
+        cid = qvm.addVMEventCB(QBDI::SEQUENCE_ENTRY, onBlockEntry, this);
+        assert(cid != QBDI::INVALID_EVENTID);
+        cid = qvm.addVMEventCB(QBDI::SEQUENCE_EXIT, onBlockExit, this);
+        assert(cid != QBDI::INVALID_EVENTID);
+    }
 
-    // 添加内存访问回调
-    cid = qvm.addMemAccessCB(MEMORY_READ_WRITE, showMemoryAccess, this);
+    // 观察内存映射变化：所有插装代码中的 SVC，以及对未插桩 libc 映射函数的调用
+    cid = qvm.addMnemonicCB("SVC", QBDI::POSTINST, onSyscall, this);
+    assert(cid != QBDI::INVALID_EVENTID);
+    if (config.stats) {
+        cid = qvm.addMnemonicCB("SVC", QBDI::PREINST, onSyscallEntry, this);
+        assert(cid != QBDI::INVALID_EVENTID);
+    }
+    cid = qvm.addVMEventCB(QBDI::EXEC_TRANSFER_CALL, onExecTransferCall, this);
     assert(cid != QBDI::INVALID_EVENTID);
 
-    // 根据传入地址对模块添加插装，确保指令回调和内存回调生效
-    bool ret = qvm.addInstrumentedModuleFromAddr(reinterpret_cast<QBDI::rword>(address));
+    return true;
+}
+
+// 段开始时间（毫秒）和耗时（微秒）
+static uint64_t clockUs(clockid_t clock) {
+    struct timespec ts{};
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool vm::instrumentModules() {
+    bool ret = qvm.addInstrumentedModuleFromAddr(reinterpret_cast<QBDI::rword>(target));
     assert(ret == true);
+    if (!ret) {
+        return false;
+    }
+    // trace 范围外的代码仍在 VM 中执行，只是不挂回调；范围涉及的其他模块也需要插装
+    if (scopeRanges.size() == 0) {
+        LOGT("trace scope is empty, nothing will be traced");
+    }
+    for (const auto &range: scopeRanges.getRanges()) {
+        qvm.addInstrumentedModuleFromAddr(range.start());
+    }
+    return true;
+}
+
+uint32_t vm::addScopeRule(const QBDI::RangeSet<QBDI::rword> &ranges) {
+    bool profiling = config.granularity == TRACE_PROFILE;
+    uint32_t id = qvm.addInstrRuleRangeSet(ranges, instrumentInstruction,
+                                           profiling ? QBDI::ANALYSIS_INSTRUCTION
+                                                     : QBDI::ANALYSIS_INSTRUCTION | QBDI::ANALYSIS_SYMBOL | QBDI::ANALYSIS_DISASSEMBLY | QBDI::ANALYSIS_OPERANDS,
+                                           this);
+    assert(id != QBDI::INVALID_EVENTID);
+    return id;
+}
+
+void vm::refreshModules() {
+    moduleMap().refresh();
+    uint32_t generation = moduleMap().generation();
+    if (generation == moduleGeneration) {
+        return;
+    }
+    moduleGeneration = generation;
+    regions.invalidate();
+
+    QBDI::RangeSet<QBDI::rword> ranges = compileTraceScope(config.scope, reinterpret_cast<QBDI::rword>(target));
+    if (ranges == scopeRanges) {
+        return;
+    }
+    LOGT("trace scope changed after module load/unload, updating %p", target);
+    QBDI::RangeSet<QBDI::rword> added = ranges, removed = scopeRanges;
+    added.remove(scopeRanges);
+    removed.remove(ranges);
+    scopeRanges = ranges;
+    // 只更新变化的部分，不清空整个翻译缓存：trace 目标入口处的块是在 hook 写入之前翻译的，
+    // 重新翻译会读到 hook 的跳转指令。移出范围的地址丢弃已翻译的块和模板，翻译时按 scopeRanges 过滤
+    for (const auto &range: removed.getRanges()) {
+        qvm.clearCache(range.start(), range.end());
+        auto &templates = emitter.templates;
+        for (auto it = templates.begin(); it != templates.end();) {
+            it = range.contains(it->first) ? templates.erase(it) : std::next(it);
+        }
+        for (auto it = sequenceLengths.begin(); it != sequenceLengths.end();) {
+            it = range.contains(it->first) ? sequenceLengths.erase(it) : std::next(it);
+        }
+    }
+    // 新加入范围的地址还没有翻译过，插装并挂规则即可
+    for (const auto &range: added.getRanges()) {
+        qvm.addInstrumentedModuleFromAddr(range.start());
+    }
+    if (scopeRule != QBDI::INVALID_EVENTID && added.size() != 0) {
+        addScopeRule(added);
+    }
+}
+
+void vm::begin(TraceSink *sink, uint32_t segment, TraceSink *index, uint64_t streamBase) {
+    refreshModules();
+    segmentStartUs = clockUs(CLOCK_MONOTONIC);
+    inBlock = false;
+    // 与新建的 VM 一样从初始寄存器状态开始，不带入上一次调用的残留值
+    qvm.setGPRState(&initialGpr);
+    qvm.setFPRState(&initialFpr);
+
+    // 覆盖率模式不写 sink，只清零位图
+    if (coverage) {
+        coverage->reset();
+        coverageCursor = CoverageCursor();
+        emitter.begin(nullptr, segment);
+        return;
+    }
 
-    return qvm;
+    uint64_t target = reinterpret_cast<uint64_t>(this->target);
+    if (profile) {
+        // 没有逐条指令的输出，不写索引；不输出段的分隔行，否则 folded stack 不能直接交给火焰图工具
+        emitter.begin(sink, segment);
+        profile->reset(target);
+        return;
+    }
+    emitter.begin(sink, segment, index, streamBase);
+    emitter.writeSegmentBegin(target, clockUs(CLOCK_REALTIME) / 1000);
+}
+
+void vm::end() {
+    uint64_t durationUs = clockUs(CLOCK_MONOTONIC) - segmentStartUs;
+    if (config.stats) {
+        // 本线程在这次调用中的计数并入合计
+        traceStats().collect(durationUs);
+    }
+    if (coverage) {
+        return;
+    }
+    if (profile) {
+        writeProfile(this);
+    } else {
+        emitter.writeSegmentEnd(durationUs);
+    }
+    emitter.end();
 }
 
 // 同步寄存器状态，将Dobby上下文寄存器值同步到虚拟机状态
@@ -10,19 +10,168 @@
 #include "nhook.h"
 #include "dobby/dobby.h"
 #include <sstream>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <vector>
+#include "trace_emitter.h"
+#include "trace_record.h"
+#include "trace_writer.h"
+#include "mem_regions.h"
+#include "safe_read.h"
+#include "trace_scope.h"
+#include "trace_index.h"
+#include "call_profile.h"
+#include "coverage.h"
 
 
 void syn_regs(DobbyRegisterContext *ctx, QBDI::GPRState *state);
 
 #define LOGT(...) __android_log_print(ANDROID_LOG_DEBUG, "TRACER", __VA_ARGS__)
 
+// trace 输出格式
+enum TraceFormat {
+    TRACE_FORMAT_TEXT,      // 文本，即原来的 trace_log.txt
+    TRACE_FORMAT_BINARY,    // 二进制记录 trace_log.bin，用 tools/trace_render 还原为文本
+};
+
+// trace 粒度
+enum TraceGranularity {
+    TRACE_INSTRUCTION,      // 每条指令执行前后各一次回调
+    TRACE_BLOCK,            // 每个块进出各一次回调，只输出二进制，由 tools/trace_render 展开为逐条指令
+    TRACE_PROFILE,          // 不输出 trace，只按调用路径统计指令数，段结束时输出按函数汇总的表和火焰图的 folded stack
+    TRACE_COVERAGE,         // 不输出任何内容，每个块进入时更新 AFL 式的边位图（coverage.h），调用结束后由调用者读取
+};
+
+// hook 命中时哪些调用被 trace，按命中的先后计数：
+// 第 1、1 + every、1 + 2 * every ... 次调用，最多 limit 次，且两次 trace 至少间隔 minIntervalMs
+struct TracePolicy {
+    uint32_t every = 1;
+    uint32_t limit = 1;             // 0 为不限；默认只 trace 第一次调用
+    uint32_t minIntervalMs = 0;
+};
+
+// trace 配置
+struct TraceConfig {
+    TraceFormat format = TRACE_FORMAT_TEXT;
+    TraceGranularity granularity = TRACE_INSTRUCTION;
+    // 回调线程与写线程之间的环形缓冲区大小，trace 占用的内存与长度无关
+    size_t ringSize = 8 << 20;
+    // 只 trace 这些地址，默认为目标所在的整个模块
+    TraceScope scope;
+    // 二进制逐条指令模式：INST_PRE / INST_POST 记录除 pc 外全部 GPR 的增量，而不只是操作数寄存器，
+    // 任意一条指令处的完整寄存器状态都可以还原
+    bool gprDelta = true;
+    // 输出指令操作数中 V 寄存器变化的 lane（文本中为 fr[] / fw[]），用于观察 NEON / 浮点代码
+    bool traceFpr = false;
+    // 逐条指令模式下分别关闭寄存器或内存访问的记录，只保留另一部分和指令本身；
+    // 不记录寄存器时也不做 gprDelta，主要用于分别测量两类回调的开销（tools/bench）
+    bool traceRegisters = true;
+    bool traceMemory = true;
+    // 被 trace 函数使用的虚拟栈大小，只保留地址空间，用到的页才占用内存；
+    // prefaultStack 时新建的栈预先分配所有页，执行中不再缺页
+    size_t stackSize = 8 << 20;
+    bool prefaultStack = false;
+    // 多次 trace 同一个 hook 目标，每次调用是 trace 文件中的一个段
+    TracePolicy policy;
+    // 写线程把输出压缩为独立的 64KB 帧，文件名加上 .lz，用 tools/trace_decompress 解压，trace_render 可以直接读取
+    bool compress = false;
+    // 回调线程直接写入 MAP_SHARED 映射的文件（trace_mmap.h），文件名加上 .mmap：每条记录写完即提交，
+    // 被 trace 的代码让进程崩溃或被杀时，trace 保留到最后一条完整的记录。没有写线程，不压缩（忽略 compress）
+    bool durable = false;
+    // 不写本地文件，而是在这个地址上等待 tools/trace_collect 连接，把 trace 流式发给主机（trace_stream.h）：
+    // "unix:qbdi_trace" 为抽象 Unix socket（adb forward tcp:5555 localabstract:qbdi_trace），"tcp:5555" 为本机端口。
+    // 主机写得慢时 tracer 等待而不丢数据。设置后忽略 durable，索引仍写在本地
+    std::string stream;
+    // 第一次命中时在后台线程上等待采集端连接的最长时间，等待期间的调用不 trace，超时后不再 trace
+    int streamWaitMs = 10000;
+    // 同时写出 sidecar 索引（trace 文件名 + ".idx"），每 indexInterval 条指令一个检查点，用 tools/trace_seek 查询。
+    // 块模式只有检查点，没有地址表
+    bool index = false;
+    uint32_t indexInterval = TRACE_INDEX_INTERVAL;
+    // 段内地址和内容都与之前某次相同的字符串 / hexdump 只输出一行引用 "Same as dump #N ..."，
+    // 循环中反复 dump 同一块缓冲区时 trace 可以小一个数量级。默认关闭，保持原有的文本输出
+    bool dedupDumps = false;
+    // 统计 tracer 自身每种回调、每个阶段和系统调用的耗时，写到 trace 文件名 + ".stats"（trace_stats.h）
+    bool stats = false;
+    // profile 模式最多记录的调用路径数，内存在创建 VM 时一次分配（每条约 40 字节）
+    uint32_t profileNodes = PROFILE_DEFAULT_NODES;
+
+    // 块模式总是输出二进制记录；profile 模式输出的是文本的汇总表和 folded stack，与 format 无关
+    bool binary() const {
+        return granularity != TRACE_PROFILE && (format == TRACE_FORMAT_BINARY || granularity == TRACE_BLOCK);
+    }
+};
+
 class vm {
 
 public:
-    QBDI::VM init(void *address);
+    explicit vm(const TraceConfig &config) : config(config) {}
+
+    // 创建后调用一次：设置选项、插桩范围和回调。之后可以多次 begin / call / end，
+    // 已翻译的块和指令模板一直保留
+    bool init(void *address);
+
+    // 开始一次 trace，即 trace 文件中编号为 segment 的段：写入段开始记录，
+    // 寄存器状态和增量基准恢复为新建时的状态，模块加载 / 卸载后刷新 trace 范围。index 不为空时同时写索引，
+    // streamBase 为 sink 的位置 0 在 trace 文件中的偏移
+    void begin(TraceSink *sink, uint32_t segment, TraceSink *index = nullptr, uint64_t streamBase = 0);
 
-    std::stringstream logbuf;
+    // 写入段结束记录，之后不再写 sink
+    void end();
+
+    TraceConfig config;
+    QBDI::VM qvm;
+    // init 时的 trace 目标
+    void *target = nullptr;
+
+    // 当前段的开始时间（CLOCK_MONOTONIC 微秒）
+    uint64_t segmentStartUs = 0;
+
+    // 文本行 / 二进制记录的拼接和写出，以及指令地址 -> 模板（插桩规则中生成）
+    TraceEmitter emitter;
+
+    // 判断寄存器值是否为有效指针用的 maps 快照
+    MemoryRegions regions;
+    // 执行后回调中写寄存器指向内存的读取请求，按最多写寄存器数分配一次后复用
+    std::vector<SafeReadSlot> readSlots;
+    // 从 QBDI 取出的内存访问，转换为记录格式后交给 emitter，分配一次后复用
+    std::vector<TraceMemAccess> accesses;
+    std::vector<TraceBlockMemAccess> blockAccesses;
+
+    // 编译后的 trace 范围，块模式下过滤范围外的块；编译时的模块表版本和 init 时挂的插桩规则
+    QBDI::RangeSet<QBDI::rword> scopeRanges;
+    uint32_t moduleGeneration = 0;
+    uint32_t scopeRule = QBDI::INVALID_EVENTID;
+    // 块模式下当前块是否在 trace 范围内
+    bool inBlock = false;
+    // 块 / profile 模式：sequence 起始地址 -> 结束地址和其中的指令数，第一次执行时按指令的实际长度统计
+    struct SequenceLength {
+        uint64_t end;
+        uint32_t instructions;
+    };
+    std::unordered_map<uint64_t, SequenceLength> sequenceLengths;
+
+    // profile 模式的影子栈和计数，其他模式为空
+    std::unique_ptr<CallProfile> profile;
+
+    // 覆盖率模式：本次调用的边位图，begin 时清零；其他模式为空
+    std::unique_ptr<CoverageMap> coverage;
+    CoverageCursor coverageCursor;
 private:
+    // 对 trace 目标所在模块和 trace 范围涉及的模块添加插装
+    bool instrumentModules();
+
+    // 在 ranges 上挂指令插桩规则，返回规则 id
+    uint32_t addScopeRule(const QBDI::RangeSet<QBDI::rword> &ranges);
+
+    // 上次 begin 之后动态链接器加载 / 卸载过模块时，重新加载模块表和 maps 快照；
+    // trace 范围变化时为新加入的地址插装、挂规则，丢弃移出范围的地址上已翻译的块
+    void refreshModules();
+
+    // 新建 VM 时的寄存器状态，begin 时恢复
+    QBDI::GPRState initialGpr;
+    QBDI::FPRState initialFpr;
 };
 
 
@@ -0,0 +1,68 @@
+//
+// Created by agent on 2026/10/17.
+//
+
+#include "vm_pool.h"
+#include "stack_pool.h"
+#include "utils.h"
+
+VmPool &vmPool() {
+    static VmPool instance;
+    return instance;
+}
+
+// 新建并初始化，放入 target 的 vm 列表，但不放入空闲列表
+vm *VmPool::create(void *target, const TraceConfig &config) {
+    // init 会解析 maps 和 ELF 符号，不持有锁
+    std::unique_ptr<vm> instance(new vm(config));
+    if (!instance->init(target)) {
+        LOGT("vm pool: init failed for %p", target);
+        return nullptr;
+    }
+    vm *result = instance.get();
+    std::lock_guard<std::mutex> guard(lock);
+    slots[target].all.push_back(std::move(instance));
+    LOGT("vm pool: %zu vm(s) for %p", slots[target].all.size(), target);
+    return result;
+}
+
+vm *VmPool::acquire(void *target, const TraceConfig &config) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        Slot &slot = slots[target];
+        if (!slot.idle.empty()) {
+            vm *instance = slot.idle.back();
+            slot.idle.pop_back();
+            return instance;
+        }
+        if (slot.warm) {
+            LOGT("vm pool: no idle vm for hooked target %p", target);
+            return nullptr;
+        }
+    }
+    return create(target, config);
+}
+
+void VmPool::release(vm *instance) {
+    std::lock_guard<std::mutex> guard(lock);
+    slots[instance->target].idle.push_back(instance);
+}
+
+bool VmPool::warmUp(void *target, const TraceConfig &config, const std::vector<QBDI::rword> &entries) {
+    vm *instance = create(target, config);
+    if (instance == nullptr) {
+        return false;
+    }
+    instance->qvm.precacheBasicBlock(reinterpret_cast<QBDI::rword>(target));
+    for (QBDI::rword entry: entries) {
+        if (!instance->qvm.precacheBasicBlock(entry)) {
+            LOGT("vm pool: failed to precache %p", (void *) entry);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        slots[target].warm = true;
+    }
+    release(instance);
+    return stackPool().reserve(config.stackSize, config.prefaultStack);
+}
@@ -0,0 +1,50 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 按 trace 目标缓存初始化好的 vm：QBDI 的翻译缓存和指令模板在多次调用之间保留，
+// 同一个函数被反复 trace 时只有第一次需要解析 maps、注册回调和翻译基本块。
+// 取出的 vm 归还之前不会再给别的调用；TraceSession 同一时间只 admit 一个调用，
+// 被 trace 的线程再次进入 hook 时直接执行原函数，所以每个目标实际只用到一个 vm。
+//
+
+#ifndef XPOSEDNHOOK_VM_POOL_H
+#define XPOSEDNHOOK_VM_POOL_H
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "vm.h"
+
+class VmPool {
+public:
+    // 取出 target 的一个空闲 vm，没有时新建并 init。config 只在新建时使用，
+    // 同一个 target 的 vm 沿用第一次的配置。target 经过 warmUp 时不再新建（翻译入口会读到 hook 的跳转），
+    // 没有空闲的 vm 或失败返回 nullptr
+    vm *acquire(void *target, const TraceConfig &config);
+
+    // 归还 acquire 取出的 vm
+    void release(vm *instance);
+
+    // 预先为 target 建好一个空闲 vm 和虚拟栈，并翻译 target 和 entries 处的基本块，
+    // 第一次 trace 时也不需要翻译这些块。target 上要挂 hook 时必须在挂之前调用，之后翻译入口会读到 hook 的跳转
+    bool warmUp(void *target, const TraceConfig &config, const std::vector<QBDI::rword> &entries = {});
+
+private:
+    struct Slot {
+        std::vector<std::unique_ptr<vm>> all;
+        std::vector<vm *> idle;
+        // warmUp 过，target 上可能已经挂了 hook
+        bool warm = false;
+    };
+
+    vm *create(void *target, const TraceConfig &config);
+
+    std::mutex lock;
+    std::unordered_map<void *, Slot> slots;
+};
+
+// 进程内共用的 vm 池
+VmPool &vmPool();
+
+#endif //XPOSEDNHOOK_VM_POOL_H
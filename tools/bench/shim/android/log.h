@@ -0,0 +1,31 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 主机端 tools/bench 编译设备端代码用：__android_log_print 输出到 stderr
+//
+
+#ifndef XPOSEDNHOOK_BENCH_ANDROID_LOG_H
+#define XPOSEDNHOOK_BENCH_ANDROID_LOG_H
+
+#include <cstdarg>
+#include <cstdio>
+
+enum {
+    ANDROID_LOG_DEBUG = 3,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+};
+
+__attribute__((format(printf, 3, 4)))
+static inline int __android_log_print(int, const char *tag, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s: ", tag);
+    int ret = vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return ret;
+}
+
+#endif //XPOSEDNHOOK_BENCH_ANDROID_LOG_H
@@ -0,0 +1,19 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 主机端 tools/bench 编译设备端代码用：只有 utils.h 等头文件声明中出现的类型，benchmark 不调用 JNI
+//
+
+#ifndef XPOSEDNHOOK_BENCH_JNI_H
+#define XPOSEDNHOOK_BENCH_JNI_H
+
+#include <cstdint>
+
+typedef int32_t jint;
+typedef class _jobject *jobject;
+typedef jobject jclass;
+typedef jobject jstring;
+struct JNIEnv;
+struct JavaVM;
+
+#endif //XPOSEDNHOOK_BENCH_JNI_H
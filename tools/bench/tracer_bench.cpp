@@ -0,0 +1,369 @@
+//
+// Created by agent on 2026/10/17.
+//
+// tracer 吞吐量基准：demo 的 RC4 / MD5 / SHA1 分别原生执行、只在 QBDI 中执行（每条指令一个空回调），
+// 以及在 vm.cpp 的各种回调配置下 trace，输出每秒指令数、每条指令的 trace 字节数和峰值 RSS。
+// trace 经 AsyncTraceWriter 写入只计数的 sink，不受磁盘影响。
+// -o 把结果写成 CSV，-b 与之前的 CSV 比较，吞吐量下降或 trace 变大超过 -t 百分比时返回 1。
+//
+// 用法: tracer_bench [-w rc4,md5,sha1] [-c native,qbdi,full,regs,mem,binary,block] [-l 字节数]
+//                    [-r 次数] [-o result.csv] [-b baseline.csv] [-t 百分比]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "vm.h"
+#include "stack_pool.h"
+#include "trace_writer.h"
+
+extern "C" size_t bench_prepare(size_t len);
+extern "C" uint64_t bench_rc4(size_t len);
+extern "C" uint64_t bench_md5(size_t len);
+extern "C" uint64_t bench_sha1(size_t len);
+
+using Clock = std::chrono::steady_clock;
+
+struct Workload {
+    const char *name;
+    uint64_t (*function)(size_t);
+};
+
+static const Workload WORKLOADS[] = {
+        {"rc4",  bench_rc4},
+        {"md5",  bench_md5},
+        {"sha1", bench_sha1},
+};
+
+// native / qbdi 之外的配置都是 TraceConfig 的变体
+static const char *const CONFIGS[] = {"native", "qbdi", "full", "regs", "mem", "binary", "block"};
+
+static bool traceConfig(const std::string &name, TraceConfig &config) {
+    if (name == "regs") {
+        config.traceMemory = false;
+    } else if (name == "mem") {
+        config.traceRegisters = false;
+    } else if (name == "binary") {
+        config.format = TRACE_FORMAT_BINARY;
+    } else if (name == "block") {
+        config.granularity = TRACE_BLOCK;
+    } else if (name != "full") {
+        return false;
+    }
+    return true;
+}
+
+// 只统计字节数的 sink
+class CountingSink : public TraceSink {
+public:
+    bool write(const void *, size_t len) override {
+        bytes += len;
+        return true;
+    }
+
+    uint64_t position() const override { return bytes; }
+
+    uint64_t bytes = 0;
+};
+
+struct Result {
+    std::string workload;
+    std::string config;
+    uint64_t instructions;      // 每次调用执行的指令数
+    double seconds;             // 每次调用的耗时
+    double bytesPerInst;
+    uint64_t peakRssKb;
+
+    double ips() const { return seconds > 0 ? instructions / seconds : 0; }
+};
+
+// 把峰值 RSS 重置为当前 RSS，内核不支持时峰值是进程启动以来的
+static bool resetPeakRss() {
+    int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write(fd, "5", 1) == 1;
+    close(fd);
+    return ok;
+}
+
+static uint64_t peakRssKb() {
+    FILE *status = fopen("/proc/self/status", "re");
+    if (status == nullptr) {
+        return 0;
+    }
+    char line[256];
+    uint64_t kb = 0;
+    while (fgets(line, sizeof(line), status)) {
+        if (sscanf(line, "VmHWM: %" SCNu64, &kb) == 1) {
+            break;
+        }
+    }
+    fclose(status);
+    return kb;
+}
+
+static double elapsed(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static QBDI::VMAction countInstruction(QBDI::VMInstanceRef, QBDI::GPRState *, QBDI::FPRState *, void *data) {
+    ++*(uint64_t *) data;
+    return QBDI::CONTINUE;
+}
+
+static double runNative(const Workload &workload, size_t len, int runs) {
+    double seconds = 0;
+    for (int i = 0; i <= runs; ++i) {
+        bench_prepare(len);
+        auto start = Clock::now();
+        workload.function(len);
+        // 第一次为预热，不计时
+        seconds += i == 0 ? 0 : elapsed(start);
+    }
+    return seconds / runs;
+}
+
+// 只在 QBDI 中执行，每条指令一个空回调，同时得到指令数
+static double runQbdi(const Workload &workload, size_t len, int runs, uint64_t &instructions) {
+    QBDI::VM qvm;
+    qvm.addInstrumentedModuleFromAddr((QBDI::rword) workload.function);
+    uint64_t count = 0;
+    qvm.addCodeCB(QBDI::PREINST, countInstruction, &count);
+    VirtualStack *stack = stackPool().acquire(8 << 20, false);
+    QBDI::GPRState initial = *qvm.getGPRState();
+    double seconds = 0;
+    for (int i = 0; i <= runs; ++i) {
+        bench_prepare(len);
+        *qvm.getGPRState() = initial;
+        useVirtualStack(qvm.getGPRState(), stack);
+        count = 0;
+        auto start = Clock::now();
+        QBDI::rword ret;
+        qvm.call(&ret, (QBDI::rword) workload.function, {(QBDI::rword) len});
+        seconds += i == 0 ? 0 : elapsed(start);
+        instructions = count;
+    }
+    stackPool().release(stack);
+    return seconds / runs;
+}
+
+// 在 vm 中 trace，与 qbdihook 的 trace_call 相同：同一个 vm 多次 begin / call / end，每次一个段
+static double runTrace(const Workload &workload, const TraceConfig &config, size_t len, int runs, uint64_t &bytes) {
+    std::unique_ptr<vm> instance(new vm(config));
+    if (!instance->init((void *) workload.function)) {
+        return 0;
+    }
+    CountingSink counter;
+    AsyncTraceWriter writer(&counter, config.ringSize);
+    VirtualStack *stack = stackPool().acquire(config.stackSize, config.prefaultStack);
+    double seconds = 0;
+    for (int i = 0; i <= runs; ++i) {
+        bench_prepare(len);
+        uint64_t before = counter.bytes;
+        auto start = Clock::now();
+        instance->begin(&writer, i);
+        useVirtualStack(instance->qvm.getGPRState(), stack);
+        QBDI::rword ret;
+        instance->qvm.call(&ret, (QBDI::rword) workload.function, {(QBDI::rword) len});
+        instance->end();
+        // 计入写线程处理完这一段的时间
+        writer.flush();
+        if (i != 0) {
+            seconds += elapsed(start);
+            bytes = counter.bytes - before;
+        }
+    }
+    writer.close();
+    stackPool().release(stack);
+    return seconds / runs;
+}
+
+static std::vector<std::string> split(const char *list) {
+    std::vector<std::string> items;
+    std::string item;
+    for (const char *p = list;; ++p) {
+        if (*p == ',' || *p == '\0') {
+            if (!item.empty()) {
+                items.push_back(item);
+            }
+            item.clear();
+            if (*p == '\0') {
+                break;
+            }
+        } else {
+            item += *p;
+        }
+    }
+    return items;
+}
+
+#define CSV_HEADER "workload,config,instructions,seconds,ips,bytes_per_inst,peak_rss_kb\n"
+
+static bool writeCsv(const char *path, const std::vector<Result> &results) {
+    FILE *out = fopen(path, "we");
+    if (out == nullptr) {
+        return false;
+    }
+    fputs(CSV_HEADER, out);
+    for (const Result &r: results) {
+        fprintf(out, "%s,%s,%" PRIu64 ",%.9f,%.0f,%.3f,%" PRIu64 "\n", r.workload.c_str(), r.config.c_str(),
+                r.instructions, r.seconds, r.ips(), r.bytesPerInst, r.peakRssKb);
+    }
+    fclose(out);
+    return true;
+}
+
+// 与基准 CSV 比较，返回回归的项数；native 只作参照，不参与比较
+static int compareBaseline(const char *path, const std::vector<Result> &results, double percent) {
+    FILE *in = fopen(path, "re");
+    if (in == nullptr) {
+        fprintf(stderr, "cannot open baseline %s\n", path);
+        return -1;
+    }
+    std::map<std::string, std::pair<double, double>> baseline;
+    char line[512];
+    while (fgets(line, sizeof(line), in)) {
+        char workload[64], config[64];
+        uint64_t instructions, rss;
+        double seconds, ips, bytesPerInst;
+        if (sscanf(line, "%63[^,],%63[^,],%" SCNu64 ",%lf,%lf,%lf,%" SCNu64, workload, config, &instructions,
+                   &seconds, &ips, &bytesPerInst, &rss) == 7) {
+            baseline[std::string(workload) + "/" + config] = {ips, bytesPerInst};
+        }
+    }
+    fclose(in);
+
+    int regressions = 0;
+    double slower = 1 - percent / 100, larger = 1 + percent / 100;
+    for (const Result &r: results) {
+        auto it = baseline.find(r.workload + "/" + r.config);
+        if (r.config == "native" || it == baseline.end()) {
+            continue;
+        }
+        double ips = it->second.first, bytesPerInst = it->second.second;
+        if (r.ips() < ips * slower) {
+            printf("REGRESSION %s/%s: %.3f Minst/s, baseline %.3f (%.1f%%)\n", r.workload.c_str(),
+                   r.config.c_str(), r.ips() / 1e6, ips / 1e6, 100 * (r.ips() / ips - 1));
+            regressions++;
+        }
+        if (bytesPerInst > 0 && r.bytesPerInst > bytesPerInst * larger) {
+            printf("REGRESSION %s/%s: %.2f bytes/inst, baseline %.2f\n", r.workload.c_str(), r.config.c_str(),
+                   r.bytesPerInst, bytesPerInst);
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> workloads = {"rc4", "md5", "sha1"};
+    std::vector<std::string> configs(std::begin(CONFIGS), std::end(CONFIGS));
+    size_t len = 16 << 10;
+    int runs = 5;
+    const char *csv = nullptr;
+    const char *baseline = nullptr;
+    double percent = 10;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:c:l:r:o:b:t:")) != -1) {
+        switch (opt) {
+            case 'w':
+                workloads = split(optarg);
+                break;
+            case 'c':
+                configs = split(optarg);
+                break;
+            case 'l':
+                len = strtoull(optarg, nullptr, 0);
+                break;
+            case 'r':
+                runs = std::max(1, atoi(optarg));
+                break;
+            case 'o':
+                csv = optarg;
+                break;
+            case 'b':
+                baseline = optarg;
+                break;
+            case 't':
+                percent = atof(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-w rc4,md5,sha1] [-c native,qbdi,full,regs,mem,binary,block] "
+                                "[-l bytes] [-r runs] [-o result.csv] [-b baseline.csv] [-t percent]\n", argv[0]);
+                return 2;
+        }
+    }
+    len = bench_prepare(len);
+    if (!resetPeakRss()) {
+        fprintf(stderr, "warning: cannot reset peak RSS, peak_rss_kb is cumulative\n");
+    }
+
+    std::vector<Result> results;
+    printf("%-6s %-8s %12s %12s %10s %10s %12s\n", "work", "config", "inst", "Minst/s", "slowdown", "bytes/inst",
+           "peak RSS KB");
+    for (const std::string &name: workloads) {
+        const Workload *workload = nullptr;
+        for (const Workload &w: WORKLOADS) {
+            if (name == w.name) {
+                workload = &w;
+            }
+        }
+        if (workload == nullptr) {
+            fprintf(stderr, "unknown workload %s\n", name.c_str());
+            return 2;
+        }
+        // 先在 QBDI 中执行一次得到指令数，各配置的吞吐量都按它计算
+        uint64_t instructions = 0;
+        runQbdi(*workload, len, 1, instructions);
+        double nativeSeconds = 0;
+        for (const std::string &config: configs) {
+            resetPeakRss();
+            Result result{name, config, instructions, 0, 0, 0};
+            TraceConfig traceCfg;
+            if (config == "native") {
+                result.seconds = nativeSeconds = runNative(*workload, len, runs);
+            } else if (config == "qbdi") {
+                result.seconds = runQbdi(*workload, len, runs, result.instructions);
+            } else if (traceConfig(config, traceCfg)) {
+                uint64_t bytes = 0;
+                result.seconds = runTrace(*workload, traceCfg, len, runs, bytes);
+                result.bytesPerInst = instructions ? (double) bytes / instructions : 0;
+            } else {
+                fprintf(stderr, "unknown config %s\n", config.c_str());
+                return 2;
+            }
+            result.peakRssKb = peakRssKb();
+            printf("%-6s %-8s %12" PRIu64 " %12.3f %9.1fx %10.2f %12" PRIu64 "\n", name.c_str(), config.c_str(),
+                   result.instructions, result.ips() / 1e6,
+                   nativeSeconds > 0 ? result.seconds / nativeSeconds : 0.0, result.bytesPerInst,
+                   result.peakRssKb);
+            fflush(stdout);
+            results.push_back(result);
+        }
+    }
+
+    if (csv != nullptr && !writeCsv(csv, results)) {
+        fprintf(stderr, "cannot write %s\n", csv);
+        return 2;
+    }
+    if (baseline != nullptr) {
+        int regressions = compareBaseline(baseline, results, percent);
+        if (regressions != 0) {
+            return regressions < 0 ? 2 : 1;
+        }
+        printf("no regression beyond %.1f%% against %s\n", percent, baseline);
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+//
+// Created by agent on 2026/10/17.
+//
+// tracer_bench 的负载：demo 中的 RC4 / MD5 / SHA1，单独编译为 libbench_workloads.so，
+// 插桩范围（目标所在模块）与设备上 trace libnhook.so 中的函数时一样只有这些代码。
+// 每个函数处理 len 字节的输入，返回结果的第一个字节，避免被优化掉。
+// 输入由 bench_prepare 在 VM 外生成，trace 中只有算法本身
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "md5.h"
+#include "rc4.h"
+#include "sha1.hpp"
+
+#define BENCH_MAX_LEN (1 << 20)
+
+static unsigned char input[BENCH_MAX_LEN];
+
+static size_t clamp(size_t len) {
+    return len < sizeof(input) ? len : sizeof(input);
+}
+
+// 重新生成输入（rc4 原地加密会改写它），返回实际使用的长度
+extern "C" __attribute__((visibility("default"))) size_t bench_prepare(size_t len) {
+    for (size_t i = 0; i < sizeof(input); ++i) {
+        input[i] = (unsigned char) (i * 131 + 7);
+    }
+    return clamp(len);
+}
+
+extern "C" __attribute__((visibility("default"))) uint64_t bench_rc4(size_t len) {
+    len = clamp(len);
+    unsigned char key[] = "bench_rc4_key";
+    rc4(key, sizeof(key) - 1, (char *) input, (int) len);
+    return input[0];
+}
+
+extern "C" __attribute__((visibility("default"))) uint64_t bench_md5(size_t len) {
+    len = clamp(len);
+    MD5_CTX context;
+    unsigned char digest[16];
+    MD5Init(&context);
+    MD5Update(&context, input, (unsigned) len);
+    MD5Final(digest, &context);
+    return digest[0];
+}
+
+extern "C" __attribute__((visibility("default"))) uint64_t bench_sha1(size_t len) {
+    len = clamp(len);
+    SHA1 checksum;
+    checksum.update(std::string((const char *) input, len));
+    return (uint8_t) checksum.final()[0];
+}
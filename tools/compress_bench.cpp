@@ -0,0 +1,187 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace 写入吞吐量对比：同样的数据经 AsyncTraceWriter 直接写文件，和经 CompressSink 压缩后写文件。
+// 输入为真实的 trace 文件，或生成的类 trace 文本；-b 把文件写入限速，模拟手机闪存的写带宽。
+// 结束后解压压缩输出并与原始数据比较。
+//
+// 用法: compress_bench [-i trace_log.txt] [-o 输出目录] [-n 生成的 MB 数] [-b 写带宽 MB/s]
+//
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "trace_format.h"
+#include "trace_frames.h"
+#include "trace_reader.h"
+#include "trace_writer.h"
+
+using Clock = std::chrono::steady_clock;
+
+// 按带宽限速的下游，模拟慢速存储
+class ThrottleSink : public TraceSink {
+public:
+    ThrottleSink(TraceSink *downstream, double bytesPerSecond)
+            : downstream(downstream), bytesPerSecond(bytesPerSecond), start(Clock::now()) {}
+
+    bool write(const void *data, size_t len) override {
+        written += len;
+        if (bytesPerSecond > 0) {
+            auto due = start + std::chrono::duration<double>(written / bytesPerSecond);
+            std::this_thread::sleep_until(std::chrono::time_point_cast<Clock::duration>(due));
+        }
+        return downstream->write(data, len);
+    }
+
+    void flush() override { downstream->flush(); }
+
+private:
+    TraceSink *downstream;
+    double bytesPerSecond;
+    Clock::time_point start;
+    uint64_t written = 0;
+};
+
+// 生成类似文本模式输出的 trace：指令行 + 寄存器 + 偶尔的内存访问
+static std::string generateTrace(size_t size) {
+    static const char *ops[] = {"ldr x8, [x19, #0x10]", "add w9, w9, #0x1", "eor w10, w10, w11", "str x8, [sp, #0x20]",
+                                "cmp w9, w20", "b.ne #0x7b2c01a300", "ldrb w11, [x21, x9]", "bl #0x7b2c01b000"};
+    std::mt19937_64 rng(1);
+    std::string out;
+    out.reserve(size + 256);
+    char line[512];
+    uint64_t pc = 0x7b2c01a2f0;
+    while (out.size() < size) {
+        uint64_t r = rng();
+        char *q = formatLiteral(line, "libnhook.so[0x");
+        q = formatHex(q, pc - 0x7b2c000000);
+        q = formatLiteral(q, "]:0x");
+        q = formatHex(q, pc);
+        q = formatLiteral(q, ": ");
+        const char *op = ops[r % 8];
+        q = formatBytes(q, op, strlen(op));
+        q = formatLiteral(q, "\tr[X8=0x");
+        q = formatHex(q, (r >> 8) & 0xffff);
+        q = formatLiteral(q, " ]\tw[X9=0x");
+        q = formatHex(q, 0x7b00000000 + (r & 0xfffff0));
+        q = formatLiteral(q, " ]\n");
+        if (r % 4 == 0) {
+            q = formatLiteral(q, "   mem[r]:0x");
+            q = formatHex(q, 0x7ff0000000 + (r >> 40));
+            q = formatLiteral(q, " size:8 value:0x");
+            q = formatHex(q, r >> 3);
+            q = formatLiteral(q, "\n\n");
+        }
+        out.append(line, q - line);
+        pc = (r % 8 == 5) ? pc - 0x40 : pc + 4;
+    }
+    out.resize(size);
+    return out;
+}
+
+struct Result {
+    double seconds;
+    uint64_t written;
+    uint64_t stalls;
+};
+
+// 按回调的粒度（一行一次 write）把 data 写入 path
+static Result run(const std::string &data, const std::string &path, bool compress, double bandwidth) {
+    FileSink *file = FileSink::open(path.c_str());
+    if (file == nullptr) {
+        perror(path.c_str());
+        exit(1);
+    }
+    ThrottleSink throttle(file, bandwidth);
+    std::unique_ptr<CompressSink> compressor(compress ? new CompressSink(&throttle) : nullptr);
+    TraceSink *downstream = compress ? (TraceSink *) compressor.get() : &throttle;
+
+    auto start = Clock::now();
+    AsyncTraceWriter writer(downstream);
+    const char *p = data.data();
+    const char *end = p + data.size();
+    while (p < end) {
+        const char *nl = static_cast<const char *>(memchr(p, '\n', end - p));
+        const char *next = nl ? nl + 1 : end;
+        writer.write(p, next - p);
+        p = next;
+    }
+    writer.close();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    delete file;
+
+    uint64_t written = compress ? compressor->storedBytes() : data.size();
+    return {seconds, written, writer.stalls()};
+}
+
+int main(int argc, char **argv) {
+    const char *input = nullptr;
+    std::string dir = "/tmp";
+    size_t megabytes = 256;
+    double bandwidth = 0;
+    int c;
+    while ((c = getopt(argc, argv, "i:o:n:b:")) != -1) {
+        switch (c) {
+            case 'i':
+                input = optarg;
+                break;
+            case 'o':
+                dir = optarg;
+                break;
+            case 'n':
+                megabytes = strtoul(optarg, nullptr, 10);
+                break;
+            case 'b':
+                bandwidth = atof(optarg) * 1e6;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-i trace] [-o dir] [-n MB] [-b MB/s]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    std::string data;
+    if (input != nullptr) {
+        MappedFile file;
+        if (!file.open(input)) {
+            return 1;
+        }
+        data.assign(reinterpret_cast<const char *>(file.data), file.size);
+    } else {
+        data = generateTrace(megabytes << 20);
+    }
+
+    printf("%-10s %10s %10s %8s %10s %8s\n", "mode", "trace MB", "file MB", "sec", "trace MB/s", "stalls");
+    for (bool compress: {false, true}) {
+        std::string path = dir + (compress ? "/compress_bench.lz" : "/compress_bench.raw");
+        Result r = run(data, path, compress, bandwidth);
+        printf("%-10s %10.1f %10.1f %8.2f %10.1f %8" PRIu64 "\n", compress ? "lz" : "raw", data.size() / 1e6,
+               r.written / 1e6, r.seconds, data.size() / 1e6 / r.seconds, r.stalls);
+
+        if (compress) {
+            MappedFile file;
+            file.open(path.c_str());
+            std::vector<FrameInfo> frames;
+            std::vector<uint8_t> out(scanFrames(file.data, file.size, frames));
+            auto start = Clock::now();
+            bool ok = decompressFrames(frames, out.data(), std::thread::hardware_concurrency());
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            ok = ok && out.size() == data.size() && memcmp(out.data(), data.data(), data.size()) == 0;
+            printf("decompress %zu frames in %.2fs (%.1f MB/s), round trip %s\n", frames.size(), seconds,
+                   data.size() / 1e6 / seconds, ok ? "ok" : "MISMATCH");
+            if (!ok) {
+                return 1;
+            }
+        }
+        unlink(path.c_str());
+    }
+    return 0;
+}
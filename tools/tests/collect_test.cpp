@@ -0,0 +1,146 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace_collect 与设备端 SocketSink（trace_stream.h 的协议）：
+// 正常结束时收到 END，文件与发送的数据逐字节相同，窗口小于数据量时设备端等待过 credit，trace_collect 返回 0；
+// 设备端在两个帧之间或一个 DATA 帧中间断开时，文件中只有完整的 DATA 帧，trace_collect 返回 1。
+//
+// 用法: collect_test trace_collect 的路径
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test_check.h"
+#include "trace_stream.h"
+#include "trace_writer.h"
+
+static const char *collector;
+
+// 后台启动 trace_collect，窗口为最小值，使设备端必须等待 credit
+static pid_t startCollector(const std::string &dir, const std::string &address) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        execl(collector, collector, "-d", dir.c_str(), "-w", "65536", address.c_str(), (char *) nullptr);
+        _exit(127);
+    }
+    return pid;
+}
+
+static int waitCollector(pid_t pid) {
+    int status;
+    if (waitpid(pid, &status, 0) != pid) {
+        return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// 正常的流：SocketSink 拆帧发送，析构时发送 END
+static void checkStream(const std::string &dir, const std::string &address) {
+    std::string data;
+    uint64_t state = 7;
+    for (size_t i = 0; i < (3 << 20); ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        // 一半是重复的文本，一半是随机字节
+        data.push_back(i % 2 ? (char) (state >> 56) : "trace "[i % 6]);
+    }
+
+    pid_t pid = startCollector(dir, address);
+    std::unique_ptr<SocketSink> sink(SocketSink::listen(address.c_str(), "trace_log.bin", 10000));
+    CHECK(sink != nullptr);
+    if (sink) {
+        // 大小不一的写入，包括超过一帧的
+        size_t sizes[] = {1, 100, 70000, 4096, 200000};
+        for (size_t pos = 0, i = 0; pos < data.size(); ++i) {
+            size_t n = std::min(sizes[i % 5], data.size() - pos);
+            CHECK(sink->write(data.data() + pos, n));
+            pos += n;
+        }
+        CHECK(sink->sentBytes() == data.size());
+        CHECK(sink->waits() > 0);
+        sink.reset();
+    }
+    CHECK(waitCollector(pid) == 0);
+    std::string received;
+    CHECK(readFile(dir + "/trace_log.bin", received));
+    CHECK(received == data);
+}
+
+// 手写的设备端：监听、等待 trace_collect 连接
+static int acceptCollector(const std::string &address) {
+    sockaddr_storage addr{};
+    socklen_t len;
+    if (!traceStreamAddress(address.c_str(), addr, len)) {
+        return -1;
+    }
+    int server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    pollfd wait{server, POLLIN, 0};
+    if (server < 0 || bind(server, reinterpret_cast<sockaddr *>(&addr), len) != 0 || listen(server, 1) != 0 ||
+        poll(&wait, 1, 10000) != 1) {
+        close(server);
+        return -1;
+    }
+    int fd = accept(server, nullptr, nullptr);
+    close(server);
+    return fd;
+}
+
+// 帧头 + 负载的前 sent 个字节
+static bool sendFrame(int fd, TraceStreamType type, const std::string &payload, size_t sent) {
+    TraceStreamFrame frame{{'Q', 'B', 'S', 'T'}, type, (uint32_t) payload.size()};
+    return send(fd, &frame, sizeof(frame), MSG_NOSIGNAL) == sizeof(frame) &&
+           (sent == 0 || send(fd, payload.data(), sent, MSG_NOSIGNAL) == (ssize_t) sent);
+}
+
+// 设备端进程退出：发送完整的帧后断开，最后一个帧可能只发送了一部分。
+// 断开前读完 trace_collect 归还的 credit（初始窗口 + 每个完整的 DATA 帧一条），
+// 接收缓冲区中有未读数据时关闭 Unix socket 会让对端丢弃还没读取的数据，结果不确定
+static void checkTruncated(const std::string &dir, const std::string &address, const char *name, size_t partial) {
+    std::string hello(4, '\0');
+    uint32_t version = TRACE_STREAM_VERSION;
+    memcpy(hello.data(), &version, sizeof(version));
+    hello += name;
+    std::string first(1000, 'a'), second(2000, 'b'), last(3000, 'c');
+
+    pid_t pid = startCollector(dir, address);
+    int fd = acceptCollector(address);
+    CHECK(fd >= 0);
+    if (fd >= 0) {
+        CHECK(sendFrame(fd, TRACE_STREAM_HELLO, hello, hello.size()));
+        CHECK(sendFrame(fd, TRACE_STREAM_DATA, first, first.size()));
+        CHECK(sendFrame(fd, TRACE_STREAM_DATA, second, second.size()));
+        if (partial != 0) {
+            CHECK(sendFrame(fd, TRACE_STREAM_DATA, last, partial));
+        }
+        uint32_t grants[3];
+        CHECK(recv(fd, grants, sizeof(grants), MSG_WAITALL) == sizeof(grants));
+        CHECK(grants[1] == first.size() && grants[2] == second.size());
+        close(fd);
+    }
+    CHECK(waitCollector(pid) == 1);
+    std::string received;
+    CHECK(readFile(dir + "/" + name, received));
+    CHECK(received == first + second);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s trace_collect\n", argv[0]);
+        return 2;
+    }
+    collector = argv[1];
+    std::string dir = testDirectory();
+    std::string address = "unix:nhook_collect_test_" + std::to_string(getpid());
+
+    checkStream(dir, address);
+    checkTruncated(dir, address, "between_frames.txt", 0);
+    checkTruncated(dir, address, "inside_frame.txt", 1234);
+    return testResult("collect_test");
+}
@@ -0,0 +1,170 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace_diff 的对齐结果：按块序列生成的小 trace 上检查加载地址不同时仍然对齐、数据差异、
+// 控制流分叉后重新同步的位置、多执行一轮循环、一边提前结束、同一个文件中的两段和压缩的 trace；
+// 由 TraceEmitter 生成的、远大于一个解析块的 trace 上，只改一个内存值时报告的指令序号与顺序数出的相同。
+//
+// 用法: diff_test trace_diff 的路径
+//
+
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "test_check.h"
+#include "trace_fixture.h"
+#include "trace_text.h"
+#include "trace_writer.h"
+
+static const char *differ;
+
+static std::string runDiff(const std::string &a, const std::string &b, const std::string &args = "") {
+    std::string output;
+    std::string command = std::string("'") + differ + "' '" + a + "' '" + b + "' " + args;
+    CHECK(runCommand(command, output) == 0);
+    return output;
+}
+
+static bool contains(const std::string &output, const std::string &text) {
+    if (output.find(text) != std::string::npos) {
+        return true;
+    }
+    fprintf(stderr, "missing \"%s\" in:\n%s\n", text.c_str(), output.c_str());
+    return false;
+}
+
+// 一个段：blocks 为依次执行的块，块 j 是 libdemo.so 中偏移 0x1000 + j * 0x100 开始的 3 条连续指令，
+// 第二条指令写一次内存。寄存器值只由块号和块内位置决定；changed 为段内指令序号，该指令读到的值不同
+static std::string segment(uint32_t number, uint64_t base, const std::vector<int> &blocks,
+                           uint64_t changed = UINT64_MAX) {
+    char line[256];
+    snprintf(line, sizeof(line), "==== segment %u target 0x%" PRIx64 " time 1 ====\n", number, base + 0x1000);
+    std::string trace = line;
+    uint64_t n = 0;
+    for (int block: blocks) {
+        for (int i = 0; i < 3; ++i, ++n) {
+            uint64_t offset = 0x1000 + block * 0x100 + i * 4;
+            uint64_t value = block * 16 + i;
+            snprintf(line, sizeof(line), "libdemo.so[0x%" PRIx64 "]:0x%" PRIx64 ": \tadd\tx0, x0, #1\tr[X0=0x%" PRIx64
+                     " ]\tw[X0=0x%" PRIx64 " ]\n", offset, base + offset, n == changed ? value ^ 0xff00 : value,
+                     value + 1);
+            trace += line;
+            if (i == 1) {
+                snprintf(line, sizeof(line), "   mem[w]:0x7000 size:8 value:0x%" PRIx64 "\n\n", value);
+                trace += line;
+            }
+        }
+    }
+    snprintf(line, sizeof(line), "==== segment %u end 5us ====\n", number);
+    return trace + line;
+}
+
+static std::string save(const std::string &dir, const char *name, const std::string &trace) {
+    std::string path = dir + "/" + name;
+    CHECK(writeFile(path, trace));
+    return path;
+}
+
+static void checkSmall(const std::string &dir) {
+    const std::vector<int> flow = {0, 1, 2, 3, 4, 5, 6, 7};
+    std::string a = save(dir, "a.txt", segment(0, 0x7a00000000, flow));
+
+    // 另一个进程：加载地址不同，按 "模块[0x偏移]" 对齐
+    std::string moved = save(dir, "moved.txt", segment(0, 0x7b00000000, flow));
+    std::string output = runDiff(a, moved);
+    CHECK(contains(output, "24 aligned instructions, 0 control flow divergence(s), 0 aligned instruction(s)"));
+    CHECK(contains(output, "no difference\n"));
+
+    // 数据：第 4 条指令（块 1 的第二条）读到的值不同
+    std::string data = save(dir, "data.txt", segment(0, 0x7a00000000, flow, 4));
+    output = runDiff(a, data);
+    CHECK(contains(output, "0 control flow divergence(s), 1 aligned instruction(s) with different"));
+    CHECK(contains(output, "first difference is in data at A #4 / B #4\n"));
+    CHECK(contains(output, "    r X0: 0x11 | 0xff11\n"));
+
+    // 控制流：块 2 换成块 9，之后重新同步
+    std::string branch = save(dir, "branch.txt", segment(0, 0x7a00000000, {0, 1, 9, 3, 4, 5, 6, 7}));
+    output = runDiff(a, branch);
+    CHECK(contains(output, "first difference is in control flow at A #6 / B #6\n"));
+    CHECK(contains(output, "control flow divergence 0 at A #6 / B #6\n"));
+    CHECK(contains(output, "  resync at A #9 / B #9 (A runs 3 instructions, B 3)\n"));
+
+    // 多执行一轮循环（块 1、2）
+    std::string loop = save(dir, "loop.txt", segment(0, 0x7a00000000, {0, 1, 2, 1, 2, 3, 4, 5, 6, 7}));
+    output = runDiff(a, loop);
+    CHECK(contains(output, "control flow divergence 0 at A #9 / B #9\n"));
+    CHECK(contains(output, "  resync at A #9 / B #15 (A runs 0 instructions, B 6)\n"));
+
+    // B 提前结束
+    std::string shorter = save(dir, "short.txt", segment(0, 0x7a00000000, {0, 1, 2, 3, 4, 5}));
+    output = runDiff(a, shorter);
+    CHECK(contains(output, "control flow divergence 0 at A #18 / B #18\n"));
+    CHECK(contains(output, "  B ends, A has 6 more instructions\n"));
+
+    // 同一个文件中的两段，默认比较各自的最后一段
+    std::string both = save(dir, "both.txt", segment(0, 0x7a00000000, flow) + segment(1, 0x7a00000000, flow, 4));
+    CHECK(contains(runDiff(both, both, "-s 0 -S 1"), "first difference is in data at A #4 / B #4\n"));
+    CHECK(contains(runDiff(both, both), "no difference\n"));
+
+    // 压缩的 trace 与未压缩的结果相同
+    std::string trace, compressed;
+    readFile(data, trace);
+    StringSink sink(&compressed);
+    {
+        CompressSink compressor(&sink);
+        compressor.write(trace.data(), trace.size());
+        compressor.flush();
+    }
+    std::string lz = save(dir, "data.txt.lz", compressed);
+    std::string plain = runDiff(a, data);
+    std::string packed = runDiff(a, lz);
+    // 第二行是 B 的文件名
+    CHECK(plain.substr(plain.find('\n', plain.find('\n') + 1)) == packed.substr(packed.find('\n', packed.find('\n') + 1)));
+}
+
+// 多个解析块：只改 trace 后部的一个内存值，报告的指令序号为顺序数出的该指令的序号
+static void checkLarge(const std::string &dir) {
+    std::string trace, index;
+    FakeTracer tracer(31);
+    FixtureOptions options;
+    options.instructions = 20000;
+    tracer.run(options, trace, index);
+    CHECK(trace.size() > (3 << 20));
+
+    size_t mem = trace.find("   mem[w]:", trace.size() * 4 / 5);
+    CHECK(mem != std::string::npos);
+    uint64_t n = 0;
+    for (size_t pos = 0; pos < mem;) {
+        size_t eol = trace.find('\n', pos);
+        n += isInstructionLine(std::string_view(trace).substr(pos, eol - pos));
+        pos = eol + 1;
+    }
+    std::string changed = trace;
+    size_t value = changed.find(" value:0x", mem) + 9;
+    changed[value] = changed[value] == '1' ? '2' : '1';
+
+    std::string a = save(dir, "large_a.txt", trace);
+    std::string b = save(dir, "large_b.txt", changed);
+    std::string output = runDiff(a, b, "-t 4");
+    char expected[96];
+    snprintf(expected, sizeof(expected), "first difference is in data at A #%" PRIu64 " / B #%" PRIu64 "\n", n - 1,
+             n - 1);
+    CHECK(contains(output, "0 control flow divergence(s), 1 aligned instruction(s) with different"));
+    CHECK(contains(output, expected));
+    CHECK(contains(runDiff(a, a, "-t 4"), "no difference\n"));
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s trace_diff\n", argv[0]);
+        return 2;
+    }
+    differ = argv[1];
+    std::string dir = testDirectory();
+    checkSmall(dir);
+    checkLarge(dir);
+    return testResult("diff_test");
+}
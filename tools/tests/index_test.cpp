@@ -0,0 +1,234 @@
+//
+// Created by agent on 2026/10/17.
+//
+// sidecar 索引（trace_index.h）与 trace 内容一致：两个段追加写入同一个文件（第二段从原文件末尾开始），
+// 检查点的偏移落在该指令的指令行 / INST_PRE 记录上，检查点中的寄存器与从段开始重新扫描 trace 得到的
+// 寄存器状态相同（二进制为 GPR 增量累加，文本为指令行中的读寄存器），地址表与扫描得到的执行次数相同。
+// trace 和索引都由设备端的 TraceEmitter 生成（trace_fixture.h）。压缩后的文件按解压后的偏移检查。
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "test_check.h"
+#include "trace_fixture.h"
+#include "trace_frames.h"
+#include "trace_text.h"
+#include "trace_writer.h"
+
+struct Checkpoint {
+    uint64_t instruction;
+    uint64_t offset;
+    uint64_t regs[TRACE_GPR_COUNT];
+};
+
+struct Segment {
+    uint32_t number = 0;
+    uint64_t offset = 0;
+    uint64_t instructions = 0;
+    bool ended = false;
+    std::vector<Checkpoint> checkpoints;
+    // 地址 -> (第一次, 最后一次, 次数)
+    std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> addresses;
+};
+
+static std::vector<Segment> loadIndex(const std::string &index) {
+    std::vector<Segment> segments;
+    TraceFileHeader header{};
+    CHECK(index.size() >= sizeof(header));
+    memcpy(&header, index.data(), sizeof(header));
+    CHECK(memcmp(header.magic, TRACE_INDEX_MAGIC, 4) == 0 && header.version == TRACE_INDEX_VERSION);
+    TraceRecordReader reader(reinterpret_cast<const uint8_t *>(index.data()) + sizeof(header),
+                             index.size() - sizeof(header));
+    TraceRecordHeader rec{};
+    const uint8_t *payload;
+    while (reader.next(rec, payload)) {
+        TracePayload p(payload, rec.length);
+        if (rec.tag == TRACE_IDX_SEGMENT) {
+            segments.emplace_back();
+            segments.back().number = p.get<uint32_t>();
+            segments.back().offset = p.get<uint64_t>();
+            continue;
+        }
+        CHECK(!segments.empty());
+        if (segments.empty()) {
+            continue;
+        }
+        Segment &segment = segments.back();
+        if (rec.tag == TRACE_IDX_CHECKPOINT) {
+            Checkpoint cp{};
+            cp.instruction = p.get<uint64_t>();
+            cp.offset = p.get<uint64_t>();
+            for (auto &reg: cp.regs) {
+                reg = p.get<uint64_t>();
+            }
+            segment.checkpoints.push_back(cp);
+        } else if (rec.tag == TRACE_IDX_ADDRESSES) {
+            for (int i = 0; i < rec.aux; ++i) {
+                auto a = p.get<TraceIndexAddress>();
+                uint64_t address = a.address, first = a.first, last = a.last, count = a.count;
+                CHECK(segment.addresses.count(address) == 0);
+                segment.addresses[address] = {first, last, count};
+            }
+        } else if (rec.tag == TRACE_IDX_SEGMENT_END) {
+            CHECK(p.get<uint32_t>() == segment.number);
+            segment.instructions = p.get<uint64_t>();
+            segment.ended = true;
+        }
+        CHECK(p.remaining() == 0);
+    }
+    CHECK(reader.position() == reinterpret_cast<const uint8_t *>(index.data()) + index.size());
+    return segments;
+}
+
+// 扫描得到的地址表
+static void countAddress(std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> &table, uint64_t address,
+                         uint64_t instruction) {
+    auto it = table.find(address);
+    if (it == table.end()) {
+        table[address] = {instruction, instruction, 1};
+    } else {
+        std::get<1>(it->second) = instruction;
+        std::get<2>(it->second)++;
+    }
+}
+
+// 二进制 GPR 增量 trace：从段开始累加增量，每个检查点处的状态应当与检查点中的寄存器相同
+static void checkBinary(const std::string &trace, const std::vector<Segment> &segments) {
+    auto data = reinterpret_cast<const uint8_t *>(trace.data());
+    for (const Segment &segment: segments) {
+        TraceRecordHeader rec{};
+        memcpy(&rec, data + segment.offset, sizeof(rec));
+        CHECK(rec.tag == TRACE_REC_SEGMENT);
+
+        TraceRecordReader reader(data + segment.offset, trace.size() - segment.offset);
+        const uint8_t *payload;
+        uint64_t regs[TRACE_GPR_COUNT] = {};
+        uint64_t instruction = 0;
+        size_t next = 0;
+        std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> scanned;
+        while (reader.next(rec, payload)) {
+            TracePayload p(payload, rec.length);
+            uint64_t offset = payload - sizeof(rec) - data;
+            if (rec.tag == TRACE_REC_SEGMENT_END) {
+                break;
+            }
+            if (rec.tag == TRACE_REC_INST_PRE) {
+                uint64_t address = p.get<uint64_t>();
+                applyGprDelta(p, regs);
+                regs[TRACE_GPR_PC] = address;
+                countAddress(scanned, address, instruction);
+                if (next < segment.checkpoints.size() && segment.checkpoints[next].instruction == instruction) {
+                    const Checkpoint &cp = segment.checkpoints[next++];
+                    CHECK(cp.offset == offset);
+                    CHECK(memcmp(cp.regs, regs, sizeof(regs)) == 0);
+                }
+                instruction++;
+            } else if (rec.tag == TRACE_REC_INST_POST) {
+                applyGprDelta(p, regs);
+            }
+        }
+        CHECK(next == segment.checkpoints.size());
+        CHECK(segment.ended && segment.instructions == instruction);
+        CHECK(scanned == segment.addresses);
+    }
+}
+
+// 文本 trace：检查点指向的行是第 N 条指令行，行中的读寄存器值与检查点中的寄存器相同
+static void checkText(const std::string &trace, const std::vector<Segment> &segments) {
+    std::string_view data(trace);
+    static const std::map<std::string_view, int> NAMES = {{"X29", 29}, {"LR", 30}, {"SP", 31}, {"NZCV", 32}};
+    for (const Segment &segment: segments) {
+        CHECK(isSegmentLine(data.substr(segment.offset)));
+        // 段开始行之后逐行扫描
+        size_t pos = data.find('\n', segment.offset) + 1;
+        uint64_t instruction = 0;
+        size_t next = 0;
+        std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> scanned;
+        while (pos < data.size()) {
+            size_t eol = data.find('\n', pos);
+            std::string_view line = data.substr(pos, eol - pos);
+            if (isSegmentLine(line)) {
+                break;
+            }
+            if (isInstructionLine(line)) {
+                uint64_t address = 0;
+                CHECK(parseInstructionAddress(line, address));
+                countAddress(scanned, address, instruction);
+                if (next < segment.checkpoints.size() && segment.checkpoints[next].instruction == instruction) {
+                    const Checkpoint &cp = segment.checkpoints[next++];
+                    CHECK(cp.offset == pos);
+                    CHECK(cp.regs[TRACE_GPR_PC] == address);
+                    forEachRegister(line, "\tr[", [&](std::string_view name, uint64_t value, std::string_view) {
+                        auto it = NAMES.find(name);
+                        int idx = it != NAMES.end() ? it->second : atoi(std::string(name.substr(1)).c_str());
+                        CHECK(cp.regs[idx] == value);
+                    });
+                }
+                instruction++;
+            }
+            pos = eol + 1;
+        }
+        CHECK(next == segment.checkpoints.size());
+        CHECK(segment.ended && segment.instructions == instruction);
+        CHECK(scanned == segment.addresses);
+    }
+}
+
+// 两个段：第二个段模拟重新打开已有文件追加，streamBase 为原文件长度
+static void generate(bool binary, std::string &trace, std::string &index) {
+    FakeTracer tracer(binary ? 11 : 12);
+    FixtureOptions options;
+    options.binary = binary;
+    options.gprDelta = binary;
+    options.index = true;
+    options.indexInterval = 97;
+    options.instructions = 3000;
+    trace = binary ? FakeTracer::binaryHeader() : std::string();
+    index = FakeTracer::indexHeader();
+    tracer.run(options, trace, index);
+
+    std::string appended;
+    options.segment = 1;
+    options.instructions = 2000;
+    options.streamBase = trace.size();
+    tracer.run(options, appended, index);
+    trace += appended;
+}
+
+int main() {
+    std::string trace, index;
+    generate(true, trace, index);
+    std::vector<Segment> segments = loadIndex(index);
+    CHECK(segments.size() == 2);
+    CHECK(segments.size() == 2 && segments[1].offset > segments[0].offset);
+    CHECK(segments.size() == 2 && segments[0].checkpoints.size() == (3000 + 96) / 97);
+    checkBinary(trace, segments);
+
+    // 压缩后索引中的偏移是解压后的偏移
+    std::string compressed;
+    StringSink compressedSink(&compressed);
+    {
+        CompressSink compressor(&compressedSink);
+        compressor.write(trace.data(), trace.size());
+        compressor.flush();
+    }
+    auto data = reinterpret_cast<const uint8_t *>(compressed.data());
+    std::vector<FrameInfo> frames;
+    std::string unpacked(scanFrames(data, compressed.size(), frames), '\0');
+    CHECK(decompressFrames(frames, reinterpret_cast<uint8_t *>(unpacked.data()), 2));
+    CHECK(unpacked == trace);
+    checkBinary(unpacked, segments);
+
+    generate(false, trace, index);
+    segments = loadIndex(index);
+    CHECK(segments.size() == 2);
+    checkText(trace, segments);
+
+    return testResult("index_test");
+}
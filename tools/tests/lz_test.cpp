@@ -0,0 +1,178 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace_lz.h 的帧压缩：各种数据的单帧往返、不可压缩数据的长度上界、空帧，
+// CompressSink 写出的帧序列经 trace_frames.h 多线程解压后与原始数据相同，以及损坏数据被拒绝而不越界。
+//
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "test_check.h"
+#include "trace_frames.h"
+#include "trace_lz.h"
+#include "trace_writer.h"
+
+class StringSink : public TraceSink {
+public:
+    bool write(const void *data, size_t len) override {
+        bytes.append(static_cast<const char *>(data), len);
+        return true;
+    }
+
+    std::string bytes;
+};
+
+static uint64_t rng = 0x1234567;
+
+static uint64_t random64() {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static TraceLzTable table;
+
+// 单帧压缩再解压，返回压缩后的长度
+static size_t roundTrip(const std::vector<uint8_t> &raw) {
+    std::vector<uint8_t> packed(TRACE_LZ_BOUND(raw.size()));
+    size_t size = lzCompress(raw.data(), raw.size(), packed.data(), table);
+    CHECK(size <= TRACE_LZ_BOUND(raw.size()));
+    // 解压缓冲区正好为原始长度，任何越界写都会被 capacity 检查拒绝
+    std::vector<uint8_t> out(raw.size() + 1);
+    size_t outSize = 0;
+    CHECK(lzDecompress(packed.data(), size, out.data(), raw.size(), outSize));
+    CHECK(outSize == raw.size());
+    CHECK(memcmp(out.data(), raw.data(), raw.size()) == 0);
+    return size;
+}
+
+static std::vector<uint8_t> textLike(size_t size) {
+    static const char *const LINES[] = {
+            "libnative.so[0x1a2c4]:0x7a0001a2c4: \teor\tw8, w9, w10\tr[W9=0x5a W10=0x3c ]\tw[W8=0x66 ]\n",
+            "   mem[r]:0x7ff0001234 size:0x8 value:0x1122334455667788\n\n",
+            "Strings :bulNalvWmXgeYrQbvQiiFeLoD\n",
+    };
+    std::vector<uint8_t> data;
+    while (data.size() < size) {
+        const char *line = LINES[random64() % 3];
+        data.insert(data.end(), line, line + strlen(line));
+    }
+    data.resize(size);
+    return data;
+}
+
+static void singleFrames() {
+    // 空帧和短于最小匹配范围的帧只有一个字面量序列
+    CHECK(roundTrip({}) == 1);
+    for (size_t n = 1; n <= 16; ++n) {
+        std::vector<uint8_t> raw(n, 'a');
+        roundTrip(raw);
+    }
+
+    // 不可压缩：随机数据不超过上界，CompressSink 会改为原样保存
+    std::vector<uint8_t> noise(TRACE_LZ_FRAME);
+    for (auto &b: noise) {
+        b = (uint8_t) random64();
+    }
+    CHECK(roundTrip(noise) >= noise.size());
+
+    // 可压缩：文本 trace、长的重复字节（长度需要多个 255 扩展字节）、短周期的重叠匹配
+    CHECK(roundTrip(textLike(TRACE_LZ_FRAME)) < TRACE_LZ_FRAME / 3);
+    CHECK(roundTrip(std::vector<uint8_t>(TRACE_LZ_FRAME, 0)) < 400);
+    std::vector<uint8_t> periodic(5000);
+    for (size_t i = 0; i < periodic.size(); ++i) {
+        periodic[i] = "abc"[i % 3];
+    }
+    roundTrip(periodic);
+
+    // 随机长度、可压缩和随机内容交错
+    for (int round = 0; round < 200; ++round) {
+        size_t size = random64() % (TRACE_LZ_FRAME + 1);
+        std::vector<uint8_t> raw = textLike(size);
+        for (size_t i = 0; i < size; i += 1 + random64() % 512) {
+            raw[i] = (uint8_t) random64();
+        }
+        roundTrip(raw);
+    }
+}
+
+// CompressSink 的输出按帧扫描、并行解压
+static void frameSequence() {
+    std::vector<uint8_t> raw = textLike(TRACE_LZ_FRAME * 5 + 1234);
+    // 中间一整帧随机数据，应当原样保存
+    for (size_t i = TRACE_LZ_FRAME * 2; i < TRACE_LZ_FRAME * 3; ++i) {
+        raw[i] = (uint8_t) random64();
+    }
+    StringSink sink;
+    std::unique_ptr<CompressSink> compressor(new CompressSink(&sink));
+    // 任意长度的写入，flush 写出不足一帧的零头；之后再 flush 不产生空帧
+    for (size_t pos = 0; pos < raw.size();) {
+        size_t n = std::min<size_t>(raw.size() - pos, 1 + random64() % 30000);
+        CHECK(compressor->write(raw.data() + pos, n));
+        pos += n;
+    }
+    compressor->flush();
+    size_t stored = sink.bytes.size();
+    compressor->flush();
+    CHECK(sink.bytes.size() == stored);
+    CHECK(compressor->rawBytes() == raw.size());
+    CHECK(compressor->storedBytes() == stored);
+
+    // 再追加一个空帧（rawSize 0），读取端应当接受
+    TraceLzFrame empty{{'Q', 'B', 'L', 'Z'}, 0, 1, 0};
+    sink.bytes.append(reinterpret_cast<const char *>(&empty), sizeof(empty));
+    sink.bytes.push_back('\0');
+
+    auto data = reinterpret_cast<const uint8_t *>(sink.bytes.data());
+    CHECK(isCompressedTrace(data, sink.bytes.size()));
+    std::vector<FrameInfo> frames;
+    size_t total = scanFrames(data, sink.bytes.size(), frames);
+    CHECK(total == raw.size());
+    CHECK(frames.size() == 7);
+    CHECK(frames.size() > 2 && (frames[2].header.flags & TRACE_LZ_STORED));
+    CHECK(frames.size() > 1 && !(frames[1].header.flags & TRACE_LZ_STORED));
+    std::vector<uint8_t> out(total);
+    CHECK(decompressFrames(frames, out.data(), 4));
+    CHECK(out == raw);
+
+    // 截断的最后一帧被丢弃，之前的帧仍然可读
+    frames.clear();
+    size_t truncated = scanFrames(data, stored - 10, frames);
+    CHECK(frames.size() == 5);
+    CHECK(truncated == TRACE_LZ_FRAME * 5);
+}
+
+// 损坏的帧内容：解压失败或输出错误，但不能越界
+static void corruptFrames() {
+    std::vector<uint8_t> raw = textLike(20000);
+    std::vector<uint8_t> packed(TRACE_LZ_BOUND(raw.size()));
+    size_t size = lzCompress(raw.data(), raw.size(), packed.data(), table);
+    std::vector<uint8_t> out(raw.size());
+    for (int round = 0; round < 2000; ++round) {
+        std::vector<uint8_t> bad(packed.begin(), packed.begin() + size);
+        bad[random64() % size] ^= (uint8_t) (1 + random64() % 255);
+        if (round % 4 == 0) {
+            bad.resize(random64() % size);
+        }
+        size_t outSize = 0;
+        if (lzDecompress(bad.data(), bad.size(), out.data(), out.size(), outSize)) {
+            CHECK(outSize <= out.size());
+        }
+    }
+    // 偏移指向输出开始之前
+    const uint8_t badOffset[] = {0x10, 'x', 0x05, 0x00};
+    size_t outSize;
+    CHECK(!lzDecompress(badOffset, sizeof(badOffset), out.data(), out.size(), outSize));
+}
+
+int main() {
+    singleFrames();
+    frameSequence();
+    corruptFrames();
+    return testResult("lz_test");
+}
@@ -0,0 +1,189 @@
+//
+// Created by agent on 2026/10/17.
+//
+// trace_query 的查询结果：手写的小 trace 上逐字节比较 write / read / reg 的输出（含 -a / -n、压缩的 trace），
+// 由 TraceEmitter 生成的多段、远大于一个扫描块的 trace 上，多线程的结果与顺序扫描得到的段号、
+// 段内指令序号和偏移相同。
+//
+// 用法: query_test trace_query 的路径
+//
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "test_check.h"
+#include "trace_fixture.h"
+#include "trace_text.h"
+#include "trace_writer.h"
+
+static const char *query;
+
+// 在 trace 文件上执行 trace_query，返回标准输出
+static std::string runQuery(const std::string &path, const std::string &args) {
+    std::string output;
+    std::string command = std::string("'") + query + "' '" + path + "' " + args;
+    CHECK(runCommand(command, output) == 0);
+    return output;
+}
+
+// 一个结果："segment S #N @偏移  详情\n    指令行\n"
+static std::string hit(uint32_t segment, uint64_t n, const std::string &trace, const std::string &line,
+                       const std::string &detail) {
+    size_t offset = trace.find(line);
+    CHECK(offset != std::string::npos);
+    char head[96];
+    snprintf(head, sizeof(head), "segment %u #%" PRIu64 " @%zu  ", segment, n, offset);
+    return head + detail + "\n    " + line + "\n";
+}
+
+static void checkSmall(const std::string &dir) {
+    const std::string mov4 = "0x1000: \tmov\tx8, x0\tr[X0=0x5 ]\tw[X8=0x5 ]";
+    const std::string str4 = "0x1004: \tstr\tx8, [sp]\tr[X8=0x5 SP=0x7000 ]";
+    const std::string ldr4 = "0x1008: \tldr\tw9, [sp]\tr[SP=0x7000 ]\tw[W9=0x5 ]";
+    const std::string mov5 = "0x1000: \tmov\tx8, x0\tr[X0=0x6 ]\tw[X8=0x6 ]";
+    const std::string stp5 = "0x100c: \tstp\tx8, x9, [sp, #16]\tr[X8=0x6 W9=0x5 SP=0x7000 ]";
+    std::string trace = "==== segment 4 target 0x1000 time 1 ====\n" +
+                        mov4 + "\n" +
+                        str4 + "\n   mem[w]:0x7000 size:8 value:0x5\n\n" +
+                        ldr4 + "\n   mem[r]:0x7000 size:4 value:0x5\n\n" +
+                        "==== segment 4 end 10us ====\n"
+                        "==== segment 5 target 0x1000 time 2 ====\n" +
+                        mov5 + "\n" +
+                        stp5 + "\n   mem[w]:0x7010 size:8 value:0x6   mem[w]:0x7018 size:8 value:0x5\n\n" +
+                        "==== segment 5 end 10us ====\n";
+    std::string path = dir + "/small.txt";
+    CHECK(writeFile(path, trace));
+
+    std::string first = hit(4, 1, trace, str4, "mem[w]:0x7000 size:8 value:0x5");
+    CHECK(runQuery(path, "write 0x5") == first);
+    CHECK(runQuery(path, "write 0x5 -a") == first + hit(5, 1, trace, stp5, "mem[w]:0x7018 size:8 value:0x5"));
+    CHECK(runQuery(path, "write 0x7") == "not found\n");
+
+    std::string load = hit(4, 2, trace, ldr4, "mem[r]:0x7000 size:4 value:0x5");
+    CHECK(runQuery(path, "read 0x7000 0x7008") == load);
+    CHECK(runQuery(path, "read 0x7003") == load);
+    CHECK(runQuery(path, "read 0x7004") == "not found\n");
+
+    // x9 / w9 是同一个寄存器
+    CHECK(runQuery(path, "reg x9") == hit(4, 2, trace, ldr4, "w:W9=0x5") + hit(5, 1, trace, stp5, "r:W9=0x5"));
+    CHECK(runQuery(path, "reg X8 -n 2") == hit(4, 0, trace, mov4, "w:X8=0x5") + hit(4, 1, trace, str4, "r:X8=0x5"));
+
+    // 压缩的 trace 先解压再查询，偏移为解压后的偏移
+    std::string compressed;
+    StringSink sink(&compressed);
+    {
+        CompressSink compressor(&sink);
+        compressor.write(trace.data(), trace.size());
+        compressor.flush();
+    }
+    std::string lz = dir + "/small.txt.lz";
+    CHECK(writeFile(lz, compressed));
+    CHECK(runQuery(lz, "write 0x5 -a") == runQuery(path, "write 0x5 -a"));
+}
+
+// 顺序扫描的结果："segment S #N @偏移"，与 trace_query 输出中每个结果的第一部分比较
+struct Expected {
+    std::vector<std::string> reg;
+    std::vector<std::string> write;
+};
+
+static Expected scan(std::string_view data, uint64_t value) {
+    Expected expected;
+    uint32_t segment = 0;
+    uint64_t count = 0;
+    size_t instruction = 0;
+    char head[96];
+    auto position = [&](size_t offset) {
+        snprintf(head, sizeof(head), "segment %u #%" PRIu64 " @%zu", segment, count - 1, offset);
+        return std::string(head);
+    };
+    for (size_t pos = 0; pos < data.size();) {
+        size_t eol = data.find('\n', pos);
+        std::string_view line = data.substr(pos, eol - pos);
+        if (isSegmentLine(line)) {
+            if (line.find(" target ") != std::string_view::npos) {
+                segment = (uint32_t) strtoul(line.data() + 13, nullptr, 10);
+                count = 0;
+            }
+        } else if (startsWith(line, "   mem[")) {
+            forEachAccess(line, [&](const MemAccess &acc) {
+                if (acc.write && acc.value == value) {
+                    expected.write.push_back(position(instruction));
+                }
+            });
+        } else if (isInstructionLine(line)) {
+            instruction = pos;
+            count++;
+            bool match = false;
+            for (const char *marker: {"\tr[", "\tw["}) {
+                forEachRegister(line, marker, [&](std::string_view name, uint64_t, std::string_view) {
+                    match = match || name == "X3" || name == "W3";
+                });
+            }
+            if (match) {
+                expected.reg.push_back(position(pos));
+            }
+        }
+        pos = eol + 1;
+    }
+    return expected;
+}
+
+// trace_query 输出中每个结果的 "segment S #N @偏移"
+static std::vector<std::string> positions(const std::string &output) {
+    std::vector<std::string> result;
+    for (size_t pos = 0; pos < output.size();) {
+        size_t eol = output.find('\n', pos);
+        if (startsWith(std::string_view(output).substr(pos), "segment ")) {
+            result.push_back(output.substr(pos, output.find("  ", pos) - pos));
+        }
+        pos = eol + 1;
+    }
+    return result;
+}
+
+static void checkLarge(const std::string &dir) {
+    std::string trace, index;
+    FakeTracer tracer(21);
+    FixtureOptions options;
+    options.instructions = 8000;
+    for (uint32_t segment = 0; segment < 3; ++segment) {
+        options.segment = segment;
+        tracer.run(options, trace, index);
+    }
+    // 每块至少 1MB，保证有多个块、段跨过块的边界
+    CHECK(trace.size() > (3 << 20));
+    std::string path = dir + "/large.txt";
+    CHECK(writeFile(path, trace));
+
+    // 查询的值取 trace 中间的某个写入
+    size_t mem = trace.find("   mem[w]:", trace.size() / 2);
+    CHECK(mem != std::string::npos);
+    uint64_t value = 0;
+    size_t valuePos = trace.find(" value:0x", mem) + 9;
+    std::string hex = "0x" + trace.substr(valuePos, parseHex(trace, valuePos, value));
+    Expected expected = scan(trace, value);
+    CHECK(!expected.reg.empty() && !expected.write.empty());
+
+    CHECK(positions(runQuery(path, "reg x3 -t 4")) == expected.reg);
+    CHECK(positions(runQuery(path, "write " + hex + " -a -t 4")) == expected.write);
+    std::vector<std::string> first = positions(runQuery(path, "write " + hex + " -t 4"));
+    CHECK(first.size() == 1 && first[0] == expected.write[0]);
+    CHECK(runQuery(path, "reg x3 -t 1") == runQuery(path, "reg x3 -t 8"));
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s trace_query\n", argv[0]);
+        return 2;
+    }
+    query = argv[1];
+    std::string dir = testDirectory();
+    checkSmall(dir);
+    checkLarge(dir);
+    return testResult("query_test");
+}
@@ -0,0 +1,253 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 二进制 trace -> trace_render 的输出应当与同一次执行的文本 trace 逐字节相同：
+// 两份 trace 都由设备端的 TraceEmitter 生成（trace_fixture.h），
+// 覆盖操作数寄存器值 / GPR 增量两种编码，多个段追加在同一个文件中，去重的 dump 引用，以及压缩后的文件。
+// 引用不存在的 dump 的记录被跳过。块模式的 trace 展开后与逐条指令的 trace 比较（见 blockMatches）。
+//
+// 用法: render_test trace_render 的路径
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "test_check.h"
+#include "trace_fixture.h"
+#include "trace_text.h"
+
+static const char *renderer;
+
+// 用 trace_render 还原 binary，expected 一起写入测试目录以便失败时比较
+static bool render(const char *name, const std::string &binary, const std::string &expected, std::string &actual) {
+    std::string dir = testDirectory();
+    std::string in = dir + "/" + name + ".bin";
+    std::string out = dir + "/" + name + ".txt";
+    if (!writeFile(in, binary) || !writeFile(dir + "/" + name + ".expected.txt", expected)) {
+        perror(in.c_str());
+        return false;
+    }
+    std::string command = std::string("'") + renderer + "' '" + in + "' '" + out + "'";
+    if (system(command.c_str()) != 0) {
+        fprintf(stderr, "%s: trace_render failed\n", name);
+        return false;
+    }
+    if (!readFile(out, actual)) {
+        perror(out.c_str());
+        return false;
+    }
+    return true;
+}
+
+// 还原的文本和 expected 比较，不同时输出第一处不同的行
+static bool renderMatches(const char *name, const std::string &binary, const std::string &expected) {
+    std::string actual;
+    if (!render(name, binary, expected, actual)) {
+        return false;
+    }
+    if (actual == expected) {
+        return true;
+    }
+    size_t pos = 0, line = 1;
+    while (pos < actual.size() && pos < expected.size() && actual[pos] == expected[pos]) {
+        line += actual[pos++] == '\n';
+    }
+    size_t start = actual.rfind('\n', pos == 0 ? 0 : pos - 1);
+    start = start == std::string::npos ? 0 : start + 1;
+    fprintf(stderr, "%s: output differs at line %zu (%zu / %zu bytes)\n  expected: %s\n  rendered: %s\n", name, line,
+            expected.size(), actual.size(), expected.substr(start, expected.find('\n', start) - start).c_str(),
+            actual.substr(start, actual.find('\n', start) - start).c_str());
+    return false;
+}
+
+// 一条指令：指令行和它的内存访问
+struct Step {
+    std::string_view line;
+    std::vector<std::string_view> mem;
+};
+
+static std::vector<Step> instructionSteps(std::string_view data) {
+    std::vector<Step> steps;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t eol = std::min(data.find('\n', pos), data.size());
+        std::string_view line = data.substr(pos, eol - pos);
+        if (isInstructionLine(line)) {
+            steps.push_back({line, {}});
+        } else if (!steps.empty()) {
+            forEachAccess(line, [&](const MemAccess &acc) { steps.back().mem.push_back(acc.text); });
+        }
+        pos = eol + 1;
+    }
+    return steps;
+}
+
+// 指令行中 "\tr[" / "\tw[" 后的 (名称, 值)，值为 "0x..."，展开的块中不能确定的值为 "?"
+static std::vector<std::pair<std::string_view, std::string_view>> registerList(std::string_view line,
+                                                                              std::string_view marker) {
+    std::vector<std::pair<std::string_view, std::string_view>> regs;
+    size_t pos = line.find(marker);
+    if (pos == std::string_view::npos) {
+        return regs;
+    }
+    pos += marker.size();
+    while (pos < line.size() && line[pos] != ']') {
+        size_t eq = line.find('=', pos);
+        size_t space = line.find(' ', eq);
+        if (eq == std::string_view::npos || space == std::string_view::npos) {
+            break;
+        }
+        regs.emplace_back(line.substr(pos, eq - pos), line.substr(eq + 1, space - eq - 1));
+        pos = space + 1;
+    }
+    return regs;
+}
+
+// 指令行中寄存器列表之前的部分："符号[0x偏移]:0x地址: 反汇编"
+static std::string_view lineHead(std::string_view line) {
+    size_t end = line.size();
+    for (std::string_view marker: {"\tr[", "\tfr[", "\tw[", "\tfw["}) {
+        end = std::min(end, line.find(marker));
+    }
+    return line.substr(0, end);
+}
+
+// 块模式还原出的指令与同一次执行的逐条指令文本比较：指令的顺序、读写寄存器名和内存访问相同，
+// 能确定的寄存器值（块开始时 / 块结束时的值）与逐条指令时记录的值相同，其余为 "?"
+static bool blockMatches(const char *name, const std::string &binary, const std::string &text) {
+    std::string actual;
+    if (!render(name, binary, text, actual)) {
+        return false;
+    }
+    std::vector<Step> blocks = instructionSteps(actual), steps = instructionSteps(text);
+    if (blocks.size() != steps.size()) {
+        fprintf(stderr, "%s: %zu instructions rendered, %zu traced\n", name, blocks.size(), steps.size());
+        return false;
+    }
+    size_t known = 0, unknown = 0;
+    for (size_t i = 0; i < steps.size(); ++i) {
+        const Step &block = blocks[i], &step = steps[i];
+        bool same = lineHead(block.line) == lineHead(step.line) && block.mem == step.mem;
+        for (std::string_view marker: {"\tr[", "\tw["}) {
+            auto expanded = registerList(block.line, marker), traced = registerList(step.line, marker);
+            same = same && expanded.size() == traced.size();
+            for (size_t k = 0; same && k < expanded.size(); ++k) {
+                bool isKnown = expanded[k].second != "?";
+                (isKnown ? known : unknown)++;
+                same = expanded[k].first == traced[k].first && (!isKnown || expanded[k].second == traced[k].second);
+            }
+        }
+        if (!same) {
+            fprintf(stderr, "%s: instruction %zu differs\n  traced:   %.*s\n  rendered: %.*s\n", name, i,
+                    (int) step.line.size(), step.line.data(), (int) block.line.size(), block.line.data());
+            return false;
+        }
+    }
+    // 块开始时的值和块内最后一次写入的值都应当出现，块内中间的写入不能确定
+    CHECK(known > 0 && unknown > 0);
+    return true;
+}
+
+// 两个段追加在同一个文件中，分别生成文本和二进制（或块模式）trace
+static void generate(uint64_t seed, FixtureOptions options, std::string &text, std::string &binary) {
+    std::string index;
+    FakeTracer textTracer(seed), binaryTracer(seed);
+    binary = FakeTracer::binaryHeader();
+    bool blocks = options.blocks;
+    for (uint32_t segment = 0; segment < 2; ++segment) {
+        options.segment = segment;
+        options.binary = false;
+        options.blocks = false;
+        textTracer.run(options, text, index);
+        options.binary = true;
+        options.blocks = blocks;
+        binaryTracer.run(options, binary, index);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s trace_render\n", argv[0]);
+        return 2;
+    }
+    renderer = argv[1];
+
+    FixtureOptions options;
+    std::string text, binary;
+    generate(1, options, text, binary);
+    // 文本格式本身：第一行是段的开始行
+    const std::string firstLine = "==== segment 0 target 0x7a0001a000 time 1760000000000 ====\n";
+    CHECK(text.compare(0, firstLine.size(), firstLine) == 0);
+    CHECK(text.find("Hexdump for ") != std::string::npos);
+    CHECK(text.find("\tfw[v") != std::string::npos);
+    // 默认不去重
+    CHECK(text.find("Same as dump #") == std::string::npos);
+    CHECK(renderMatches("values", binary, text));
+
+    options.gprDelta = true;
+    text.clear();
+    generate(2, options, text, binary);
+    CHECK(renderMatches("gpr_delta", binary, text));
+
+    // 压缩：CompressSink 的帧序列，trace_render 先在内存中解压
+    std::string compressed;
+    StringSink compressedSink(&compressed);
+    {
+        CompressSink compressor(&compressedSink);
+        CHECK(compressor.write(binary.data(), binary.size()));
+        compressor.flush();
+        CHECK(compressor.rawBytes() == binary.size());
+    }
+    CHECK(compressed.size() < binary.size());
+    CHECK(renderMatches("gpr_delta_lz", compressed, text));
+
+    // 块模式：trace_render 把块展开为逐条指令
+    options.gprDelta = false;
+    options.blocks = true;
+    text.clear();
+    generate(4, options, text, binary);
+    CHECK(blockMatches("blocks", binary, text));
+    options.blocks = false;
+
+    options.dedupDumps = true;
+    text.clear();
+    generate(3, options, text, binary);
+    CHECK(text.find("Same as dump #") != std::string::npos);
+    CHECK(renderMatches("dedup", binary, text));
+
+    // 引用了本段不存在的 dump 的 DUMP_REF 是损坏的记录，不输出引用行
+    // 没有指令定义时寄存器名为 "?"
+    std::string dumpLine = "Same as dump #0 for ? at address 0x7a00010000\n";
+    for (uint32_t id: {0u, 1u << 30}) {
+        TraceRecordBuilder rec;
+        rec.begin(TRACE_REC_SEGMENT);
+        rec.put<uint32_t>(2);
+        rec.put<uint16_t>(0);
+        rec.put<uint64_t>(0x7a0001a000);
+        rec.put<uint64_t>(1760000000000);
+        std::string refs = FakeTracer::binaryHeader();
+        refs.append(reinterpret_cast<const char *>(rec.data()), rec.size());
+        rec.begin(TRACE_REC_DUMP, TRACE_DUMP_STRING);
+        rec.put<uint8_t>(0);
+        rec.put<uint64_t>(0x7a00010000);
+        rec.putBytes("abcd", 4);
+        refs.append(reinterpret_cast<const char *>(rec.data()), rec.size());
+        rec.begin(TRACE_REC_DUMP_REF, TRACE_DUMP_STRING);
+        rec.put<uint8_t>(0);
+        rec.put<uint64_t>(0x7a00010000);
+        rec.put<uint32_t>(id);
+        refs.append(reinterpret_cast<const char *>(rec.data()), rec.size());
+        std::string expected = "==== segment 2 target 0x7a0001a000 time 1760000000000 ====\nStrings :abcd\n";
+        if (id == 0) {
+            expected += dumpLine;
+        }
+        CHECK(renderMatches(id == 0 ? "dump_ref" : "dump_ref_bad", refs, expected));
+    }
+
+    return testResult("render_test");
+}
@@ -0,0 +1,105 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 主机端测试共用：失败时输出位置并计数，main 最后用 testResult() 作为返回值，由 ctest 判断
+//
+
+#ifndef NHOOK_TOOLS_TEST_CHECK_H
+#define NHOOK_TOOLS_TEST_CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+inline int &testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if (!(cond)) {                                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);    \
+            testFailures()++;                                                           \
+        }                                                                               \
+    } while (0)
+
+// 测试用的临时目录，通过时由 testResult 删除，失败时保留以便查看其中的文件
+inline std::string &testDirectoryPath() {
+    static std::string dir;
+    return dir;
+}
+
+inline int testResult(const char *name) {
+    if (testFailures() != 0) {
+        fprintf(stderr, "%s: %d check(s) failed%s%s\n", name, testFailures(),
+                testDirectoryPath().empty() ? "" : ", files kept in ", testDirectoryPath().c_str());
+        return 1;
+    }
+    if (!testDirectoryPath().empty()) {
+        std::error_code ignored;
+        std::filesystem::remove_all(testDirectoryPath(), ignored);
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+inline std::string testDirectory() {
+    std::string &dir = testDirectoryPath();
+    if (dir.empty()) {
+        char pattern[] = "/tmp/nhook_test.XXXXXX";
+        const char *made = mkdtemp(pattern);
+        if (made == nullptr) {
+            perror("mkdtemp");
+            exit(2);
+        }
+        dir = made;
+    }
+    return dir;
+}
+
+inline bool writeFile(const std::string &path, const std::string &data) {
+    FILE *out = fopen(path.c_str(), "wb");
+    if (out == nullptr) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), out) == data.size();
+    return fclose(out) == 0 && ok;
+}
+
+inline bool readFile(const std::string &path, std::string &data) {
+    FILE *in = fopen(path.c_str(), "rb");
+    if (in == nullptr) {
+        return false;
+    }
+    data.clear();
+    char buffer[1 << 16];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        data.append(buffer, n);
+    }
+    fclose(in);
+    return true;
+}
+
+// 执行命令，返回退出码，标准输出写入 output
+inline int runCommand(const std::string &command, std::string &output) {
+    FILE *pipe = popen(command.c_str(), "r");
+    if (pipe == nullptr) {
+        perror("popen");
+        return -1;
+    }
+    output.clear();
+    char buffer[1 << 16];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+        output.append(buffer, n);
+    }
+    int status = pclose(pipe);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+#endif //NHOOK_TOOLS_TEST_CHECK_H
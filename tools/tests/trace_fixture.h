@@ -0,0 +1,378 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 主机端测试用的模拟执行：随机生成一段"程序"、它访问的内存和执行过程，按 vm.cpp 中回调的顺序
+// 把寄存器、写寄存器的探测结果和内存访问交给设备端同一份 TraceEmitter（trace_emitter.h），
+// 由它生成文本 trace、二进制 trace 和 sidecar 索引。同一个种子的两次执行完全相同，
+// 分别以文本和二进制输出时，trace_render 还原出的文本应当与文本 trace 逐字节相同。
+//
+
+#ifndef NHOOK_TOOLS_TRACE_FIXTURE_H
+#define NHOOK_TOOLS_TRACE_FIXTURE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gpr_delta.h"
+#include "trace_emitter.h"
+#include "trace_index.h"
+#include "trace_record.h"
+#include "trace_writer.h"
+
+// 追加到字符串的 sink，position 为字符串的长度（已有的文件头也计入，与 trace 会话写入文件头的方式相同）
+class StringSink : public TraceSink {
+public:
+    explicit StringSink(std::string *out) : out(out) {}
+
+    bool write(const void *data, size_t len) override {
+        out->append(static_cast<const char *>(data), len);
+        return true;
+    }
+
+    uint64_t position() const override { return out->size(); }
+
+private:
+    std::string *out;
+};
+
+struct FixtureOptions {
+    bool binary = false;
+    // 块模式：每个 sequence 进出时各输出一次，只有二进制
+    bool blocks = false;
+    bool gprDelta = false;
+    bool index = false;
+    bool dedupDumps = false;
+    uint32_t indexInterval = 64;
+    uint64_t instructions = 5000;
+    uint32_t segment = 0;
+    // 输出在整个 trace 文件中的起始偏移（追加到已有文件时为原文件长度）
+    uint64_t streamBase = 0;
+};
+
+class FakeTracer {
+public:
+    explicit FakeTracer(uint64_t seed) : state(seed) {
+        buildModules();
+        buildProgram();
+        buildBuffers();
+    }
+
+    // 执行一个段：trace 追加到 out，索引记录（不含索引文件头）追加到 index。
+    // 同一个 FakeTracer 的各个段共用模板，与 vm 复用已翻译的块相同
+    void run(const FixtureOptions &options, std::string &out, std::string &index) {
+        TraceEmitOptions &output = emitter.options;
+        output.binary = options.binary || options.blocks;
+        output.blocks = options.blocks;
+        output.gprDelta = options.gprDelta;
+        output.dedupDumps = options.dedupDumps;
+        output.indexInterval = options.indexInterval;
+        StringSink sink(&out), indexSink(&index);
+
+        begin();
+        emitter.begin(&sink, options.segment, options.index ? &indexSink : nullptr, options.streamBase);
+        emitter.writeSegmentBegin(program[0].address, 1760000000000ull + options.segment);
+        size_t pc = 0;
+        for (uint64_t n = 0; n < options.instructions;) {
+            // 一个 sequence：连续执行 1-8 条指令，之后大多顺序执行，偶尔跳转，形成循环和重复执行的地址。
+            // 两种模式下随机数的使用完全相同，同一个种子的执行相同
+            size_t len = std::min<uint64_t>({1 + next(8), contiguous(pc), options.instructions - n});
+            if (options.blocks) {
+                runBlock(pc, len);
+            } else {
+                for (size_t i = 0; i < len; ++i) {
+                    step(program[pc + i]);
+                }
+            }
+            n += len;
+            pc = next(100) < 85 ? (pc + len) % program.size() : next(program.size());
+        }
+        emitter.writeSegmentEnd(1234 + options.segment);
+        emitter.end();
+    }
+
+    // 二进制文件头，只在新文件开头写一次
+    static std::string binaryHeader() {
+        TraceFileHeader header{{'Q', 'B', 'T', 'R'}, TRACE_VERSION, 0};
+        return {reinterpret_cast<const char *>(&header), sizeof(header)};
+    }
+
+    static std::string indexHeader() {
+        TraceFileHeader header{{'Q', 'B', 'I', 'X'}, TRACE_INDEX_VERSION, 0};
+        return {reinterpret_cast<const char *>(&header), sizeof(header)};
+    }
+
+    uint64_t nextRandom() {
+        // splitmix64
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+private:
+    struct Inst {
+        uint64_t address;
+        // 0 为 QBDI 符号，1 为模块 + 偏移，2 为只有地址
+        int source;
+        uint32_t module;
+        std::string disassembly;
+        std::vector<TracedReg> reads;
+        std::vector<TracedReg> writes;
+        uint32_t fprReads;
+        uint32_t fprWrites;
+        bool memory;
+        InstTemplate *tpl;
+    };
+
+    // 写寄存器可能指向的内存
+    struct Buffer {
+        uint64_t address;
+        TraceDumpKind kind;
+        std::vector<uint8_t> bytes;
+    };
+
+    uint64_t next(uint64_t bound) { return nextRandom() % bound; }
+
+    void buildModules() {
+        moduleNames = {"libnative.so", "libcrypto_fake.so"};
+        moduleBases = {0x7a00000000ull, 0x7b10000000ull};
+    }
+
+    TracedReg randomReg(bool write) {
+        // x0-x28, x29, lr, sp, nzcv 中随机一个，部分 x 寄存器用 w 名
+        TracedReg reg{(int16_t) next(write ? 33 : 32), 0, {}};
+        static const char *const NAMES[] = {"X29", "LR", "SP", "NZCV"};
+        int len = reg.ctxIdx < 29 ? snprintf(reg.name, sizeof(reg.name), "%c%d", next(4) == 0 ? 'W' : 'X', reg.ctxIdx)
+                                  : snprintf(reg.name, sizeof(reg.name), "%s", NAMES[reg.ctxIdx - 29]);
+        reg.nameLen = (uint8_t) len;
+        return reg;
+    }
+
+    void buildProgram() {
+        static const char *const MNEMONICS[] = {"add", "eor", "ldr", "str", "ror", "mov", "ldp", "stp", "orr", "cmp"};
+        for (size_t i = 0; i < 96; ++i) {
+            Inst inst{};
+            // 三种符号来源：QBDI 符号、模块 + 偏移、只有地址
+            if (i < 32) {
+                inst.address = moduleBases[0] + 0x1a000 + i * 4;
+                inst.source = 0;
+            } else if (i < 80) {
+                inst.module = i < 56 ? 0 : 1;
+                inst.address = moduleBases[inst.module] + 0x3000 + i * 4;
+                inst.source = 1;
+            } else {
+                inst.address = 0x7c00001000ull + i * 4;
+                inst.source = 2;
+            }
+            inst.disassembly = std::string("\t") + MNEMONICS[next(10)] + "\tx" + std::to_string(next(29)) + ", x" +
+                               std::to_string(next(29));
+            for (size_t n = next(4); n > 0; --n) {
+                inst.reads.push_back(randomReg(false));
+            }
+            for (size_t n = next(3); n > 0; --n) {
+                inst.writes.push_back(randomReg(true));
+            }
+            if (next(5) == 0) {
+                inst.fprReads = 1u << next(8) | 1u << next(8);
+            }
+            if (next(5) == 0) {
+                inst.fprWrites = 1u << next(8);
+            }
+            inst.memory = next(5) < 2;
+            program.push_back(inst);
+        }
+    }
+
+    void buildBuffers() {
+        const char *const strings[] = {"kanxue", "imyang", "ollvm_md5", "bulNalvWmXgeYrQbvQiiFeLoD"};
+        uint64_t address = 0x7d00002000ull;
+        for (const char *s: strings) {
+            buffers.push_back({address, TRACE_DUMP_STRING, std::vector<uint8_t>(s, s + strlen(s))});
+            address += 0x100;
+        }
+        for (size_t len: {32, 32, 7, 16}) {
+            Buffer buffer{address, TRACE_DUMP_HEX, {}};
+            for (size_t i = 0; i < len; ++i) {
+                buffer.bytes.push_back((uint8_t) next(256));
+            }
+            buffers.push_back(buffer);
+            address += 0x100;
+        }
+        buffers.push_back({address, TRACE_DUMP_INVALID, {}});
+    }
+
+    // vm.cpp 的 buildTemplate：插桩时的指令分析交给 emitter
+    InstTemplate *translate(const Inst &inst) {
+        InstInfo info{};
+        info.address = inst.address;
+        info.size = 4;
+        info.disassembly = inst.disassembly.c_str();
+        info.module = -1;
+        if (inst.source == 0) {
+            info.symbol = "Java_cn_mrack_xposed_nhook_NHook_sign1";
+            info.offset = inst.address - program[0].address;
+        } else if (inst.source == 1) {
+            info.module = (int32_t) inst.module;
+            info.offset = inst.address - moduleBases[inst.module];
+            info.moduleName = moduleNames[inst.module];
+            info.moduleBase = moduleBases[inst.module];
+        }
+        info.reads = inst.reads;
+        info.writes = inst.writes;
+        info.fprReads = inst.fprReads;
+        info.fprWrites = inst.fprWrites;
+        info.mayAccessMemory = inst.memory;
+        return emitter.prepare(info, nullptr);
+    }
+
+    // 调用时的参数和栈
+    void begin() {
+        memset(regs, 0, sizeof(regs));
+        for (int i = 0; i < 8; ++i) {
+            regs[i] = nextRandom();
+        }
+        regs[31] = 0x7ff0001000ull;
+        regs[30] = 0x7a00001234ull;
+        for (auto &v: fpr) {
+            v[0] = nextRandom();
+            v[1] = next(2) ? nextRandom() : 0;
+        }
+    }
+
+    // 一条指令：执行前回调 -> 执行（更新写寄存器、V 寄存器和内存访问）-> 执行后回调
+    void step(Inst &inst) {
+        if (inst.tpl == nullptr) {
+            inst.tpl = translate(inst);
+        }
+        InstTemplate *tpl = inst.tpl;
+        bool binary = emitter.options.binary;
+        regs[TRACE_GPR_PC] = inst.address;
+        // 两条 trace 指令之间没有被 trace 的代码也可能改变 V 寄存器
+        if (next(10) == 0) {
+            fpr[next(8)][next(2)] = nextRandom();
+        }
+
+        if (binary) {
+            emitter.recordPre(tpl, regs, &fpr[0][0]);
+        } else {
+            emitter.textPre(tpl, regs, &fpr[0][0]);
+        }
+
+        execute(inst);
+        probe(tpl);
+
+        if (binary) {
+            emitter.recordPost(tpl, regs, &fpr[0][0]);
+            if (tpl->accessMemory) {
+                emitter.recordMemory(accesses.data(), accesses.size());
+            }
+        } else {
+            emitter.textPost(tpl, regs, &fpr[0][0]);
+            if (tpl->accessMemory) {
+                emitter.textMemory(accesses.data(), accesses.size());
+            }
+            emitter.flushText();
+        }
+    }
+
+    // 从 pc 开始地址连续的指令数，sequence 不跨过程序中地址不连续的地方
+    size_t contiguous(size_t pc) const {
+        size_t n = 1;
+        while (pc + n < program.size() && program[pc + n].address == program[pc].address + n * 4) {
+            ++n;
+        }
+        return n;
+    }
+
+    // vm.cpp 的 onBlockEntry / onBlockExit：sequence 内的指令已经翻译，进入时记录寄存器，
+    // 离开时记录块内全部内存访问和寄存器
+    void runBlock(size_t pc, size_t len) {
+        for (size_t i = pc; i < pc + len; ++i) {
+            if (program[i].tpl == nullptr) {
+                program[i].tpl = translate(program[i]);
+            }
+        }
+        const Inst &first = program[pc], &last = program[pc + len - 1];
+        regs[TRACE_GPR_PC] = first.address;
+        emitter.blockEntry(first.address, last.address + 4, len, regs);
+        blockAccesses.clear();
+        for (size_t i = pc; i < pc + len; ++i) {
+            const Inst &inst = program[i];
+            regs[TRACE_GPR_PC] = inst.address;
+            // 与 step 相同地使用随机数
+            if (next(10) == 0) {
+                fpr[next(8)][next(2)] = nextRandom();
+            }
+            execute(inst);
+            for (const auto &access: accesses) {
+                blockAccesses.push_back({inst.address, access});
+            }
+        }
+        emitter.blockMemory(blockAccesses.data(), blockAccesses.size());
+        emitter.blockExit(regs);
+    }
+
+    void execute(const Inst &inst) {
+        for (const auto &reg: inst.writes) {
+            // 约三分之一的写入是指向已知内存的指针，其余是普通的值
+            if (next(3) == 0) {
+                regs[reg.ctxIdx] = buffers[next(buffers.size())].address;
+            } else {
+                regs[reg.ctxIdx] = next(4) == 0 ? next(0x10000) : nextRandom();
+            }
+        }
+        for (uint32_t bits = inst.fprWrites; bits != 0; bits &= bits - 1) {
+            int reg = __builtin_ctz(bits);
+            fpr[reg][0] = nextRandom();
+            if (next(2)) {
+                fpr[reg][1] = next(3) ? nextRandom() : 0;
+            }
+        }
+        accesses.clear();
+        if (inst.memory) {
+            // 可能访问内存的指令偶尔没有记录到访问（例如条件不成立的访存）
+            for (size_t n = next(5); n > 0; --n) {
+                static const uint8_t TYPES[] = {TRACE_MEM_READ, TRACE_MEM_WRITE, TRACE_MEM_READ_WRITE};
+                static const uint16_t SIZES[] = {1, 2, 4, 8, 16};
+                accesses.push_back({0x7ff0000000ull + next(0x2000) * 8, nextRandom(), SIZES[next(5)],
+                                    TYPES[next(3)], 0});
+            }
+        }
+    }
+
+    // vm.cpp 的 probePointers：写寄存器的值是否指向已知内存，以及其中的内容
+    void probe(const InstTemplate *tpl) {
+        for (size_t i = 0; i < tpl->writes.size(); ++i) {
+            PointerProbe &probe = emitter.probes[i];
+            probe.value = regs[tpl->writes[i].ctxIdx];
+            probe.valid = false;
+            for (const auto &buffer: buffers) {
+                if (buffer.address == probe.value) {
+                    probe.valid = true;
+                    probe.kind = buffer.kind;
+                    probe.len = buffer.bytes.size();
+                    memcpy(probe.buffer, buffer.bytes.data(), buffer.bytes.size());
+                }
+            }
+        }
+    }
+
+    uint64_t state;
+    TraceEmitter emitter;
+
+    std::vector<std::string> moduleNames;
+    std::vector<uint64_t> moduleBases;
+    std::vector<Inst> program;
+    std::vector<Buffer> buffers;
+    std::vector<TraceMemAccess> accesses;
+    std::vector<TraceBlockMemAccess> blockAccesses;
+
+    uint64_t regs[TRACE_GPR_COUNT] = {};
+    uint64_t fpr[32][2] = {};
+};
+
+#endif //NHOOK_TOOLS_TRACE_FIXTURE_H
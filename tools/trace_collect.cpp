@@ -0,0 +1,178 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 接收设备端 TraceConfig::stream 流式导出的 trace（trace_stream.h），写入输出目录下设备端给出的文件名
+// （trace_log.txt / trace_log.bin，压缩时带 .lz），之后与设备上写出的文件一样用其他 tools 处理。
+// 每写完一个 DATA 帧才把 credit 归还给设备端，主机磁盘慢时设备端的 tracer 随之变慢。
+// 设备端还没开始监听时每秒重试一次连接。
+//
+// 用法: trace_collect [-d 输出目录] [-w 窗口字节数] [-k] 地址
+//   地址为 unix:名字（本机抽象 Unix socket）或 tcp:端口 / tcp:IPv4:端口，例如
+//   adb forward tcp:5555 localabstract:qbdi_trace && trace_collect -d out tcp:5555
+//   -k 一个流结束后继续等待下一个连接
+//
+
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "trace_stream.h"
+#include "trace_writer.h"
+
+using Clock = std::chrono::steady_clock;
+
+static bool readAll(int fd, void *data, size_t len) {
+    auto p = static_cast<uint8_t *>(data);
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool grant(int fd, uint32_t bytes) {
+    return send(fd, &bytes, sizeof(bytes), MSG_NOSIGNAL) == sizeof(bytes);
+}
+
+static int connectTo(const sockaddr_storage &addr, socklen_t len) {
+    int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<const sockaddr *>(&addr), len) == 0) {
+        return fd;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return -1;
+}
+
+// 接收一个流，返回是否以 END 正常结束
+static bool collect(int fd, const std::string &dir, uint32_t window) {
+    TraceStreamFrame frame{};
+    std::vector<uint8_t> payload(TRACE_STREAM_FRAME);
+    if (!readAll(fd, &frame, sizeof(frame)) || memcmp(frame.magic, TRACE_STREAM_MAGIC, 4) != 0 ||
+        frame.type != TRACE_STREAM_HELLO || frame.length < sizeof(uint32_t) ||
+        frame.length > sizeof(uint32_t) + TRACE_STREAM_NAME_MAX || !readAll(fd, payload.data(), frame.length)) {
+        fprintf(stderr, "bad hello from device\n");
+        return false;
+    }
+    uint32_t version;
+    memcpy(&version, payload.data(), sizeof(version));
+    std::string name((const char *) payload.data() + sizeof(version), frame.length - sizeof(version));
+    if (version != TRACE_STREAM_VERSION || name.empty() || name.find('/') != std::string::npos || name[0] == '.') {
+        fprintf(stderr, "unsupported stream (version %u, name '%s')\n", version, name.c_str());
+        return false;
+    }
+    std::string path = dir + "/" + name;
+    std::unique_ptr<FileSink> out(FileSink::open(path.c_str()));
+    if (!out) {
+        perror(path.c_str());
+        return false;
+    }
+    if (!grant(fd, window)) {
+        return false;
+    }
+    fprintf(stderr, "receiving %s\n", path.c_str());
+
+    auto start = Clock::now();
+    auto lastReport = start;
+    uint64_t total = 0;
+    bool ended = false;
+    while (readAll(fd, &frame, sizeof(frame))) {
+        if (memcmp(frame.magic, TRACE_STREAM_MAGIC, 4) != 0 || frame.length > TRACE_STREAM_FRAME) {
+            fprintf(stderr, "corrupt frame after %" PRIu64 " bytes\n", total);
+            break;
+        }
+        if (frame.type == TRACE_STREAM_END) {
+            ended = true;
+            break;
+        }
+        if (!readAll(fd, payload.data(), frame.length)) {
+            break;
+        }
+        if (frame.type != TRACE_STREAM_DATA) {
+            continue;
+        }
+        if (!out->write(payload.data(), frame.length)) {
+            perror(path.c_str());
+            break;
+        }
+        total += frame.length;
+        // 写入之后才归还 credit
+        if (!grant(fd, frame.length)) {
+            break;
+        }
+        auto now = Clock::now();
+        if (now - lastReport >= std::chrono::seconds(5)) {
+            double seconds = std::chrono::duration<double>(now - start).count();
+            fprintf(stderr, "  %.1f MB, %.1f MB/s\n", total / 1e6, total / 1e6 / seconds);
+            lastReport = now;
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    fprintf(stderr, "%s: %" PRIu64 " bytes in %.1fs%s\n", path.c_str(), total, seconds,
+            ended ? "" : " (connection closed without end, device process exited?)");
+    return ended;
+}
+
+int main(int argc, char **argv) {
+    std::string dir = ".";
+    uint32_t window = TRACE_STREAM_WINDOW;
+    bool keep = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:w:k")) != -1) {
+        switch (opt) {
+            case 'd':
+                dir = optarg;
+                break;
+            case 'w':
+                window = (uint32_t) strtoul(optarg, nullptr, 0);
+                break;
+            case 'k':
+                keep = true;
+                break;
+            default:
+                optind = argc + 1;
+                break;
+        }
+    }
+    sockaddr_storage addr{};
+    socklen_t len;
+    if (optind != argc - 1 || !traceStreamAddress(argv[optind], addr, len) || window < TRACE_STREAM_FRAME) {
+        fprintf(stderr, "usage: %s [-d dir] [-w window >= %d] [-k] unix:name | tcp:[ipv4:]port\n", argv[0],
+                TRACE_STREAM_FRAME);
+        return 2;
+    }
+    mkdir(dir.c_str(), 0755);
+
+    bool ok = true;
+    do {
+        int fd;
+        bool waiting = false;
+        while ((fd = connectTo(addr, len)) < 0) {
+            if (!waiting) {
+                fprintf(stderr, "waiting for device on %s\n", argv[optind]);
+                waiting = true;
+            }
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+        ok = collect(fd, dir, window);
+        close(fd);
+    } while (keep);
+    return ok ? 0 : 1;
+}
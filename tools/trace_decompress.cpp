@@ -0,0 +1,69 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 解压设备端 compress = true 时输出的 trace_log.bin.lz / trace_log.txt.lz。
+// 各帧互相独立，先扫描帧头算出每帧的输出位置，再多线程解压到 mmap 的输出文件中。
+// durable = true 时输出的 trace_log.txt.mmap 等去掉文件头和预分配的部分，还原为普通的 trace 文件。
+//
+// 用法: trace_decompress trace_log.txt.lz trace_log.txt [线程数]
+//       trace_decompress trace_log.txt.mmap trace_log.txt
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "trace_frames.h"
+#include "trace_reader.h"
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s trace.lz output [threads]\n", argv[0]);
+        return 1;
+    }
+    unsigned threads = argc > 3 ? (unsigned) atoi(argv[3]) : std::thread::hardware_concurrency();
+
+    MappedFile in;
+    if (!in.open(argv[1])) {
+        return 1;
+    }
+    if (in.durable) {
+        FILE *out = fopen(argv[2], "wb");
+        if (out == nullptr || fwrite(in.data, 1, in.size, out) != in.size || fclose(out) != 0) {
+            perror(argv[2]);
+            return 1;
+        }
+        fprintf(stderr, "durable trace, %zu committed bytes\n", in.size);
+        return 0;
+    }
+    if (!isCompressedTrace(in.data, in.size)) {
+        fprintf(stderr, "%s: not a compressed trace\n", argv[1]);
+        return 1;
+    }
+    std::vector<FrameInfo> frames;
+    size_t total = scanFrames(in.data, in.size, frames);
+
+    int fd = open(argv[2], O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t) total) != 0) {
+        perror(argv[2]);
+        return 1;
+    }
+    bool ok = true;
+    if (total > 0) {
+        void *out = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (out == MAP_FAILED) {
+            perror(argv[2]);
+            close(fd);
+            return 1;
+        }
+        ok = decompressFrames(frames, static_cast<uint8_t *>(out), threads);
+        munmap(out, total);
+    }
+    close(fd);
+    fprintf(stderr, "%zu frames, %zu -> %zu bytes\n", frames.size(), in.size, total);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,670 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 比较同一个函数的两次文本 trace（trace_log.txt 格式），找出执行开始不同的位置。
+// 两个 trace 都 mmap 后按指令行切块、多线程解析，连续地址的指令组成块，每块按指令的
+// "模块[0x偏移]"（没有时为地址）计算哈希，两次运行在不同进程、加载地址不同也能对齐。
+// 按块哈希序列对齐：相同的块依次匹配，遇到不同时在之后的 -w 个块内找最近的连续 -k 个相同块重新同步。
+// 对齐的指令再多线程比较寄存器值和 mem / dump 行。输出第一处差异（控制流或数据）、
+// 差异指令的寄存器和内存访问对比，以及各个控制流分叉和重新同步的位置。
+// 指令序号为段内序号，可以直接用于 trace_seek goto。指针值在不同进程中通常不同，也会算作数据差异。
+//
+// 用法: trace_diff a.txt b.txt [-s A 的段号] [-S B 的段号] [-n 最多列出的分叉数] [-a 列出所有数据差异]
+//                  [-w 同步窗口块数] [-k 同步需要的连续块数] [-t 线程数]
+//   段号默认为各自文件的最后一段；同一个文件的两段：trace_diff t.txt t.txt -s 0 -S 1
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "trace_frames.h"
+#include "trace_reader.h"
+#include "trace_record.h"
+#include "trace_text.h"
+
+#define DIFF_MIN_CHUNK (1 << 20)
+#define DIFF_HASH_BASE 0x9e3779b97f4a7c15ull
+#define SEGMENT_PREFIX "==== segment "
+
+// 顺序执行（地址连续）的一段指令
+struct Block {
+    uint64_t first;         // 第一条指令的序号
+    uint32_t count;
+    uint64_t hash;          // 各指令标识的多项式哈希，可以拼接
+};
+
+// 一块的解析结果，Block::first 为块内序号
+struct Part {
+    size_t begin = 0;
+    size_t end = 0;
+    std::vector<uint64_t> lines;
+    std::vector<Block> blocks;
+    uint64_t firstAddress = 0;
+    uint64_t lastAddress = 0;
+};
+
+static inline uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t hashPower(uint64_t n) {
+    uint64_t result = 1, base = DIFF_HASH_BASE;
+    for (; n != 0; n >>= 1) {
+        if (n & 1) {
+            result *= base;
+        }
+        base *= base;
+    }
+    return result;
+}
+
+// 指令的标识：有 "模块[0x偏移]" 时为它的哈希，否则为地址
+static inline bool instructionKey(std::string_view line, uint64_t &address, uint64_t &key) {
+    if (!parseInstructionAddress(line, address)) {
+        return false;
+    }
+    size_t pos = line.find("]:0x");
+    if (pos == std::string_view::npos) {
+        key = mix(address);
+        return true;
+    }
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i <= pos; ++i) {
+        h = (h ^ (uint8_t) line[i]) * 0x100000001b3ull;
+    }
+    key = mix(h);
+    return true;
+}
+
+static inline std::string_view lineAt(std::string_view data, size_t pos) {
+    const char *eol = static_cast<const char *>(memchr(data.data() + pos, '\n', data.size() - pos));
+    return data.substr(pos, eol ? eol - (data.data() + pos) : data.size() - pos);
+}
+
+class Trace {
+public:
+    bool load(const char *path, long wantedSegment, unsigned threads) {
+        this->path = path;
+        if (!file.open(path)) {
+            return false;
+        }
+        data = std::string_view(reinterpret_cast<const char *>(file.data), file.size);
+        if (isCompressedTrace(file.data, file.size)) {
+            std::vector<FrameInfo> frames;
+            decompressed.resize(scanFrames(file.data, file.size, frames));
+            if (!decompressFrames(frames, decompressed.data(), threads)) {
+                fprintf(stderr, "%s: corrupt compressed trace\n", path);
+                return false;
+            }
+            data = std::string_view(reinterpret_cast<const char *>(decompressed.data()), decompressed.size());
+        }
+        if (startsWith(data, TRACE_MAGIC)) {
+            fprintf(stderr, "%s: binary trace, convert it with trace_render first\n", path);
+            return false;
+        }
+        if (!selectSegment(wantedSegment)) {
+            return false;
+        }
+        parse(threads);
+        return true;
+    }
+
+    size_t instructions() const { return lines.size(); }
+
+    std::string_view line(uint64_t index) const { return lineAt(body, lines[index]); }
+
+    // 指令在文件（解压后）中的偏移
+    size_t offset(uint64_t index) const { return bodyOffset + lines[index]; }
+
+    uint64_t key(uint64_t index) const {
+        uint64_t address, k = 0;
+        instructionKey(line(index), address, k);
+        return k;
+    }
+
+    // 参与数据比较的部分：指令行第一个 \t 之后的寄存器，到下一条指令之前的 mem / dump 行；
+    // 行首的地址和反汇编不比较
+    std::string_view payload(uint64_t index) const {
+        size_t begin = lines[index];
+        size_t end = index + 1 < lines.size() ? lines[index + 1] : body.size();
+        std::string_view text = body.substr(begin, end - begin);
+        size_t nl = text.find('\n');
+        size_t tab = text.find('\t');
+        size_t from = tab < nl ? tab : nl == std::string_view::npos ? text.size() : nl;
+        return text.substr(from);
+    }
+
+    void describe(const char *label) const {
+        printf("%s: %s", label, path);
+        if (segmented) {
+            printf(" segment %u", segment);
+        }
+        printf(", %zu instructions, %zu blocks\n", lines.size(), blocks.size());
+    }
+
+    const char *path = nullptr;
+    bool segmented = false;
+    uint32_t segment = 0;
+    std::vector<uint64_t> lines;    // 指令行在 body 中的偏移
+    std::vector<Block> blocks;
+
+private:
+    // 找到段开始行，wanted < 0 时为最后一段；没有段分隔行时整个文件为一段
+    bool selectSegment(long wanted) {
+        std::vector<std::pair<uint32_t, size_t>> starts;
+        const size_t prefix = sizeof(SEGMENT_PREFIX) - 1;
+        size_t pos = 0;
+        while (pos < data.size()) {
+            auto p = static_cast<const char *>(memmem(data.data() + pos, data.size() - pos, SEGMENT_PREFIX, prefix));
+            if (p == nullptr) {
+                break;
+            }
+            size_t at = p - data.data();
+            std::string_view text = lineAt(data, at);
+            if ((at == 0 || data[at - 1] == '\n') && text.find(" target ") != std::string_view::npos) {
+                starts.emplace_back((uint32_t) strtoul(text.data() + prefix, nullptr, 10), at);
+            }
+            pos = at + prefix;
+        }
+        if (starts.empty()) {
+            if (wanted >= 0) {
+                fprintf(stderr, "%s: no segment lines in trace\n", path);
+                return false;
+            }
+            body = data;
+            bodyOffset = 0;
+            return true;
+        }
+        auto chosen = starts.end() - 1;
+        if (wanted >= 0) {
+            chosen = std::find_if(starts.begin(), starts.end(), [&](const std::pair<uint32_t, size_t> &s) {
+                return s.first == (uint32_t) wanted;
+            });
+            if (chosen == starts.end()) {
+                fprintf(stderr, "%s: no segment %ld\n", path, wanted);
+                return false;
+            }
+        }
+        segmented = true;
+        segment = chosen->first;
+        bodyOffset = chosen->second + lineAt(data, chosen->second).size() + 1;
+        bodyOffset = std::min(bodyOffset, data.size());
+        // 段结束行或下一段的开始行之前
+        size_t end = data.size();
+        auto next = static_cast<const char *>(memmem(data.data() + bodyOffset, data.size() - bodyOffset,
+                                                     "\n" SEGMENT_PREFIX, prefix + 1));
+        if (next != nullptr) {
+            end = next - data.data() + 1;
+        }
+        body = data.substr(bodyOffset, end - bodyOffset);
+        return true;
+    }
+
+    void parse(unsigned threads) {
+        std::vector<Part> parts;
+        size_t target = std::max<size_t>(body.size() / (threads * 8 + 1), DIFF_MIN_CHUNK);
+        for (size_t begin = 0; begin < body.size();) {
+            size_t end = begin + target >= body.size() ? body.size() : nextInstructionLine(body, begin + target);
+            parts.emplace_back();
+            parts.back().begin = begin;
+            parts.back().end = end;
+            begin = end;
+        }
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < std::min<size_t>(threads, parts.size()); ++i) {
+            workers.emplace_back([&]() {
+                size_t index;
+                while ((index = next.fetch_add(1)) < parts.size()) {
+                    parsePart(parts[index]);
+                }
+            });
+        }
+        for (auto &worker: workers) {
+            worker.join();
+        }
+
+        // 按顺序拼接；上一块最后一条指令与这一块第一条地址连续时，两块的首尾合并为一个 Block
+        size_t total = 0;
+        for (const Part &part: parts) {
+            total += part.lines.size();
+        }
+        lines.reserve(total);
+        bool hasLast = false;
+        uint64_t lastAddress = 0;
+        for (Part &part: parts) {
+            if (part.lines.empty()) {
+                continue;
+            }
+            uint64_t base = lines.size();
+            lines.insert(lines.end(), part.lines.begin(), part.lines.end());
+            size_t i = 0;
+            if (hasLast && part.firstAddress == lastAddress + 4) {
+                Block &tail = blocks.back();
+                const Block &head = part.blocks[0];
+                tail.hash = tail.hash * hashPower(head.count) + head.hash;
+                tail.count += head.count;
+                i = 1;
+            }
+            for (; i < part.blocks.size(); ++i) {
+                Block block = part.blocks[i];
+                block.first += base;
+                blocks.push_back(block);
+            }
+            hasLast = true;
+            lastAddress = part.lastAddress;
+        }
+    }
+
+    void parsePart(Part &part) const {
+        uint64_t previous = 0;
+        size_t pos = part.begin;
+        while (pos < part.end) {
+            const char *nl = static_cast<const char *>(memchr(body.data() + pos, '\n', part.end - pos));
+            size_t len = nl ? nl - (body.data() + pos) : part.end - pos;
+            std::string_view text(body.data() + pos, len);
+            size_t linePos = pos;
+            pos += len + 1;
+            uint64_t address, key;
+            if (len == 0 || text[0] == ' ' || !isInstructionLine(text) || !instructionKey(text, address, key)) {
+                continue;
+            }
+            if (part.lines.empty() || address != previous + 4) {
+                part.blocks.push_back(Block{part.lines.size(), 0, 0});
+            }
+            if (part.lines.empty()) {
+                part.firstAddress = address;
+            }
+            Block &block = part.blocks.back();
+            block.hash = block.hash * DIFF_HASH_BASE + key;
+            block.count++;
+            part.lines.push_back(linePos);
+            previous = address;
+        }
+        part.lastAddress = previous;
+    }
+
+    MappedFile file;
+    std::vector<uint8_t> decompressed;
+    std::string_view data;
+    std::string_view body;          // 选中段的内容
+    size_t bodyOffset = 0;
+};
+
+// 两边相同的连续块 [a, a + n) 和 [b, b + n)
+struct Run {
+    size_t a;
+    size_t b;
+    size_t n;
+};
+
+// 控制流分叉：从块 a / b 开始不同，到块 aEnd / bEnd 重新同步（synced 为 false 时没有同步上，到末尾为止）
+struct Gap {
+    size_t a;
+    size_t b;
+    size_t aEnd;
+    size_t bEnd;
+    bool synced;
+};
+
+static uint64_t kgramHash(const std::vector<Block> &blocks, size_t at, size_t k) {
+    uint64_t h = 0;
+    for (size_t i = at; i < at + k; ++i) {
+        h = mix(h ^ blocks[i].hash) + blocks[i].count;
+    }
+    return h;
+}
+
+static bool sameBlock(const Block &x, const Block &y) {
+    return x.hash == y.hash && x.count == y.count;
+}
+
+// 在 [i, i + window) 和 [j, j + window) 内找 di + dj 最小、之后连续 k 块相同的位置
+static bool resync(const Trace &a, const Trace &b, size_t i, size_t j, size_t window, size_t k,
+                   size_t &di, size_t &dj) {
+    if (i + k > a.blocks.size() || j + k > b.blocks.size()) {
+        return false;
+    }
+    std::unordered_map<uint64_t, size_t> later;
+    size_t bLast = std::min(j + window, b.blocks.size() - k);
+    for (size_t p = j; p <= bLast; ++p) {
+        later.emplace(kgramHash(b.blocks, p, k), p);
+    }
+    size_t best = SIZE_MAX;
+    size_t aLast = std::min(i + window, a.blocks.size() - k);
+    for (size_t p = i; p <= aLast && p - i < best; ++p) {
+        auto it = later.find(kgramHash(a.blocks, p, k));
+        if (it == later.end()) {
+            continue;
+        }
+        size_t q = it->second;
+        bool match = true;
+        for (size_t t = 0; t < k && match; ++t) {
+            match = sameBlock(a.blocks[p + t], b.blocks[q + t]);
+        }
+        if (match && (p - i) + (q - j) < best) {
+            best = (p - i) + (q - j);
+            di = p - i;
+            dj = q - j;
+        }
+    }
+    return best != SIZE_MAX;
+}
+
+static void align(const Trace &a, const Trace &b, size_t window, size_t k, std::vector<Run> &runs,
+                  std::vector<Gap> &gaps) {
+    size_t i = 0, j = 0;
+    while (i < a.blocks.size() && j < b.blocks.size()) {
+        size_t n = 0;
+        while (i + n < a.blocks.size() && j + n < b.blocks.size() && sameBlock(a.blocks[i + n], b.blocks[j + n])) {
+            n++;
+        }
+        if (n > 0) {
+            runs.push_back(Run{i, j, n});
+            i += n;
+            j += n;
+        }
+        if (i == a.blocks.size() || j == b.blocks.size()) {
+            break;
+        }
+        size_t di = 0, dj = 0;
+        if (!resync(a, b, i, j, window, k, di, dj)) {
+            gaps.push_back(Gap{i, j, a.blocks.size(), b.blocks.size(), false});
+            return;
+        }
+        gaps.push_back(Gap{i, j, i + di, j + dj, true});
+        i += di;
+        j += dj;
+    }
+    if (i < a.blocks.size() || j < b.blocks.size()) {
+        // 一边先结束
+        gaps.push_back(Gap{i, j, a.blocks.size(), b.blocks.size(), false});
+    }
+}
+
+// 对齐的指令区间 [a, a + n) 和 [b, b + n)
+struct Span {
+    uint64_t a;
+    uint64_t b;
+    uint64_t n;
+};
+
+// 多线程比较对齐的指令，返回数据不同的指令对（按顺序，最多 limit 个，0 为不限）和总数
+static std::vector<std::pair<uint64_t, uint64_t>> compareData(const Trace &a, const Trace &b,
+                                                              const std::vector<Span> &spans, unsigned threads,
+                                                              size_t limit, uint64_t &total) {
+    // 把所有区间按指令数均分给各线程
+    uint64_t all = 0;
+    for (const Span &span: spans) {
+        all += span.n;
+    }
+    unsigned count = (unsigned) std::max<uint64_t>(1, std::min<uint64_t>(threads, all / 65536 + 1));
+    struct Result {
+        std::vector<std::pair<uint64_t, uint64_t>> pairs;
+        uint64_t total = 0;
+    };
+    std::vector<Result> results(count);
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < count; ++w) {
+        workers.emplace_back([&, w]() {
+            uint64_t from = all * w / count, to = all * (w + 1) / count, offset = 0;
+            Result &result = results[w];
+            for (const Span &span: spans) {
+                uint64_t lo = std::max(from, offset), hi = std::min(to, offset + span.n);
+                for (uint64_t x = lo; x < hi; ++x) {
+                    uint64_t ia = span.a + (x - offset), ib = span.b + (x - offset);
+                    if (a.payload(ia) != b.payload(ib)) {
+                        result.total++;
+                        if (limit == 0 || result.pairs.size() < limit) {
+                            result.pairs.emplace_back(ia, ib);
+                        }
+                    }
+                }
+                offset += span.n;
+            }
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    std::vector<std::pair<uint64_t, uint64_t>> pairs;
+    total = 0;
+    for (const Result &result: results) {
+        total += result.total;
+        for (const auto &pair: result.pairs) {
+            if (limit == 0 || pairs.size() < limit) {
+                pairs.push_back(pair);
+            }
+        }
+    }
+    return pairs;
+}
+
+static void printInstruction(const char *label, const Trace &trace, uint64_t index) {
+    if (index >= trace.instructions()) {
+        printf("  %s: (end of trace)\n", label);
+        return;
+    }
+    std::string_view text = trace.line(index);
+    printf("  %s #%" PRIu64 " @%zu: %.*s\n", label, index, trace.offset(index), (int) text.size(), text.data());
+}
+
+// 寄存器和内存访问逐项对比
+static void printDataDiff(const Trace &a, const Trace &b, uint64_t ia, uint64_t ib) {
+    printInstruction("A", a, ia);
+    printInstruction("B", b, ib);
+    struct Reg {
+        char kind;
+        std::string_view name;
+        uint64_t value;
+    };
+    auto registers = [](std::string_view line) {
+        std::vector<Reg> regs;
+        forEachRegister(line, "\tr[", [&](std::string_view name, uint64_t value, std::string_view) {
+            regs.push_back(Reg{'r', name, value});
+        });
+        forEachRegister(line, "\tw[", [&](std::string_view name, uint64_t value, std::string_view) {
+            regs.push_back(Reg{'w', name, value});
+        });
+        return regs;
+    };
+    std::vector<Reg> ra = registers(a.line(ia)), rb = registers(b.line(ib));
+    for (const Reg &x: ra) {
+        auto y = std::find_if(rb.begin(), rb.end(), [&](const Reg &r) { return r.kind == x.kind && r.name == x.name; });
+        if (y == rb.end()) {
+            printf("    %c %.*s: 0x%" PRIx64 " | -\n", x.kind, (int) x.name.size(), x.name.data(), x.value);
+        } else if (y->value != x.value) {
+            printf("    %c %.*s: 0x%" PRIx64 " | 0x%" PRIx64 "\n", x.kind, (int) x.name.size(), x.name.data(),
+                   x.value, y->value);
+        }
+    }
+    for (const Reg &y: rb) {
+        if (std::none_of(ra.begin(), ra.end(), [&](const Reg &r) { return r.kind == y.kind && r.name == y.name; })) {
+            printf("    %c %.*s: - | 0x%" PRIx64 "\n", y.kind, (int) y.name.size(), y.name.data(), y.value);
+        }
+    }
+
+    // mem 行按出现顺序逐项比较，其他附属行（字符串 / hexdump）只指出第一处不同
+    auto attached = [](std::string_view payload, std::vector<MemAccess> &accesses, std::string &other) {
+        size_t nl = payload.find('\n');
+        for (size_t pos = nl == std::string_view::npos ? payload.size() : nl + 1; pos < payload.size();) {
+            std::string_view text = lineAt(payload, pos);
+            pos += text.size() + 1;
+            if (startsWith(text, "   mem[")) {
+                forEachAccess(text, [&](const MemAccess &acc) { accesses.push_back(acc); });
+            } else {
+                other.append(text).push_back('\n');
+            }
+        }
+    };
+    std::vector<MemAccess> ma, mb;
+    std::string oa, ob;
+    attached(a.payload(ia), ma, oa);
+    attached(b.payload(ib), mb, ob);
+    for (size_t i = 0; i < std::max(ma.size(), mb.size()); ++i) {
+        std::string_view x = i < ma.size() ? ma[i].text : "-", y = i < mb.size() ? mb[i].text : "-";
+        if (x != y) {
+            printf("    %.*s | %.*s\n", (int) x.size(), x.data(), (int) y.size(), y.data());
+        }
+    }
+    if (oa != ob) {
+        size_t x = 0, y = 0;
+        std::string_view la, lb;
+        do {
+            la = x < oa.size() ? lineAt(oa, x) : std::string_view("-");
+            lb = y < ob.size() ? lineAt(ob, y) : std::string_view("-");
+            x += la.size() + 1;
+            y += lb.size() + 1;
+        } while (la == lb);
+        printf("    dump differs: %.*s | %.*s\n", (int) la.size(), la.data(), (int) lb.size(), lb.data());
+    }
+}
+
+// 分叉处第一条不同的指令：两边分叉块的公共前缀之后
+static void gapStart(const Trace &a, const Trace &b, const Gap &gap, uint64_t &ia, uint64_t &ib) {
+    ia = gap.a < a.blocks.size() ? a.blocks[gap.a].first : a.instructions();
+    ib = gap.b < b.blocks.size() ? b.blocks[gap.b].first : b.instructions();
+    while (ia < a.instructions() && ib < b.instructions() && a.key(ia) == b.key(ib)) {
+        ia++;
+        ib++;
+    }
+}
+
+static void printGap(const Trace &a, const Trace &b, const Gap &gap, size_t number) {
+    uint64_t ia, ib;
+    gapStart(a, b, gap, ia, ib);
+    uint64_t aEnd = gap.aEnd < a.blocks.size() ? a.blocks[gap.aEnd].first : a.instructions();
+    uint64_t bEnd = gap.bEnd < b.blocks.size() ? b.blocks[gap.bEnd].first : b.instructions();
+    printf("control flow divergence %zu at A #%" PRIu64 " / B #%" PRIu64 "\n", number, ia, ib);
+    if (ia > 0) {
+        printInstruction("last common A", a, ia - 1);
+    }
+    printInstruction("A", a, ia);
+    printInstruction("B", b, ib);
+    if (gap.synced) {
+        printf("  resync at A #%" PRIu64 " / B #%" PRIu64 " (A runs %" PRIu64 " instructions, B %" PRIu64 ")\n",
+               aEnd, bEnd, aEnd - ia, bEnd - ib);
+    } else if (ia >= a.instructions() || ib >= b.instructions()) {
+        printf("  %s ends, %s has %" PRIu64 " more instructions\n", ia >= a.instructions() ? "A" : "B",
+               ia >= a.instructions() ? "B" : "A", ia >= a.instructions() ? bEnd - ib : aEnd - ia);
+    } else {
+        printf("  no resync within the window until the end (A %" PRIu64 " / B %" PRIu64 " instructions left)\n",
+               aEnd - ia, bEnd - ib);
+    }
+}
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s a.txt b.txt [-s segA] [-S segB] [-n max] [-a] [-w window] [-k blocks] "
+                    "[-t threads]\n", name);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    long segmentA = -1, segmentB = -1;
+    size_t maxGaps = 10, window = 4096, k = 4;
+    bool allData = false;
+    unsigned threads = std::thread::hardware_concurrency();
+    int c;
+    while ((c = getopt(argc, argv, "s:S:n:aw:k:t:")) != -1) {
+        switch (c) {
+            case 's':
+                segmentA = strtol(optarg, nullptr, 10);
+                break;
+            case 'S':
+                segmentB = strtol(optarg, nullptr, 10);
+                break;
+            case 'n':
+                maxGaps = strtoul(optarg, nullptr, 10);
+                break;
+            case 'a':
+                allData = true;
+                break;
+            case 'w':
+                window = strtoul(optarg, nullptr, 10);
+                break;
+            case 'k':
+                k = std::max<size_t>(1, strtoul(optarg, nullptr, 10));
+                break;
+            case 't':
+                threads = strtoul(optarg, nullptr, 10);
+                break;
+            default:
+                return usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2) {
+        return usage(argv[0]);
+    }
+    threads = std::max(threads, 1u);
+
+    // 两个 trace 同时解析，各用一半线程
+    Trace a, b;
+    bool okA = false, okB = false;
+    unsigned half = std::max(threads / 2, 1u);
+    std::thread loader([&]() { okB = b.load(argv[optind + 1], segmentB, half); });
+    okA = a.load(argv[optind], segmentA, std::max(threads - half, 1u));
+    loader.join();
+    if (!okA || !okB) {
+        return 1;
+    }
+    a.describe("A");
+    b.describe("B");
+
+    std::vector<Run> runs;
+    std::vector<Gap> gaps;
+    align(a, b, window, k, runs, gaps);
+
+    std::vector<Span> spans;
+    uint64_t aligned = 0;
+    for (const Run &run: runs) {
+        const Block &lastA = a.blocks[run.a + run.n - 1];
+        uint64_t n = lastA.first + lastA.count - a.blocks[run.a].first;
+        spans.push_back(Span{a.blocks[run.a].first, b.blocks[run.b].first, n});
+        aligned += n;
+    }
+    uint64_t dataTotal;
+    auto dataDiffs = compareData(a, b, spans, threads, allData ? 0 : 1, dataTotal);
+    printf("%" PRIu64 " aligned instructions, %zu control flow divergence(s), %" PRIu64
+           " aligned instruction(s) with different registers / memory\n", aligned, gaps.size(), dataTotal);
+    if (gaps.empty() && dataTotal == 0) {
+        printf("no difference\n");
+        return 0;
+    }
+
+    // 第一处差异：第一个数据不同的对齐指令，或第一个控制流分叉，取更早的
+    uint64_t gapA = UINT64_MAX, gapB = 0;
+    if (!gaps.empty()) {
+        gapStart(a, b, gaps[0], gapA, gapB);
+    }
+    if (!dataDiffs.empty() && dataDiffs[0].first < gapA) {
+        printf("\nfirst difference is in data at A #%" PRIu64 " / B #%" PRIu64 "\n", dataDiffs[0].first,
+               dataDiffs[0].second);
+    } else {
+        printf("\nfirst difference is in control flow at A #%" PRIu64 " / B #%" PRIu64 "\n", gapA, gapB);
+    }
+    for (const auto &pair: dataDiffs) {
+        printf("\ndata difference:\n");
+        printDataDiff(a, b, pair.first, pair.second);
+    }
+    for (size_t i = 0; i < gaps.size() && (maxGaps == 0 || i < maxGaps); ++i) {
+        printf("\n");
+        printGap(a, b, gaps[i], i);
+    }
+    if (maxGaps != 0 && gaps.size() > maxGaps) {
+        printf("\n... %zu more control flow divergence(s), use -n 0 to list all\n", gaps.size() - maxGaps);
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 主机端工具共用：压缩 trace（trace_lz.h 的帧序列）的扫描和多线程解压
+//
+
+#ifndef NHOOK_TOOLS_TRACE_FRAMES_H
+#define NHOOK_TOOLS_TRACE_FRAMES_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "trace_lz.h"
+
+struct FrameInfo {
+    const uint8_t *body;
+    TraceLzFrame header;
+    size_t outOffset;       // 解压后在整个 trace 中的偏移
+};
+
+// 数据是否为压缩的 trace
+inline bool isCompressedTrace(const uint8_t *data, size_t size) {
+    return size >= sizeof(TraceLzFrame) && memcmp(data, TRACE_LZ_MAGIC, 4) == 0;
+}
+
+// 只读帧头建立帧表，返回解压后的总长度；最后一帧不完整（进程被杀）时丢弃并提示
+inline size_t scanFrames(const uint8_t *data, size_t size, std::vector<FrameInfo> &frames) {
+    size_t pos = 0, out = 0;
+    while (size - pos >= sizeof(TraceLzFrame)) {
+        FrameInfo frame{};
+        memcpy(&frame.header, data + pos, sizeof(TraceLzFrame));
+        if (memcmp(frame.header.magic, TRACE_LZ_MAGIC, 4) != 0 || frame.header.rawSize > TRACE_LZ_FRAME ||
+            frame.header.storedSize > size - pos - sizeof(TraceLzFrame)) {
+            break;
+        }
+        frame.body = data + pos + sizeof(TraceLzFrame);
+        frame.outOffset = out;
+        frames.push_back(frame);
+        pos += sizeof(TraceLzFrame) + frame.header.storedSize;
+        out += frame.header.rawSize;
+    }
+    if (pos != size) {
+        fprintf(stderr, "warning: compressed trace truncated at offset %zu\n", pos);
+    }
+    return out;
+}
+
+// 解压一帧到 out + frame.outOffset
+inline bool decompressFrame(const FrameInfo &frame, uint8_t *out) {
+    uint8_t *dst = out + frame.outOffset;
+    if (frame.header.flags & TRACE_LZ_STORED) {
+        if (frame.header.storedSize != frame.header.rawSize) {
+            return false;
+        }
+        memcpy(dst, frame.body, frame.header.rawSize);
+        return true;
+    }
+    size_t size = 0;
+    return lzDecompress(frame.body, frame.header.storedSize, dst, frame.header.rawSize, size) &&
+           size == frame.header.rawSize;
+}
+
+// 多线程解压全部帧，各帧互相独立，按帧号分给 threads 个线程。损坏的帧输出提示并保留为 0
+inline bool decompressFrames(const std::vector<FrameInfo> &frames, uint8_t *out, unsigned threads) {
+    std::atomic<size_t> next{0};
+    std::atomic<bool> ok{true};
+    auto worker = [&]() {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < frames.size();) {
+            if (!decompressFrame(frames[i], out)) {
+                fprintf(stderr, "error: frame %zu is corrupt\n", i);
+                memset(out + frames[i].outOffset, 0, frames[i].header.rawSize);
+                ok = false;
+            }
+        }
+    };
+    threads = std::max(1u, std::min<unsigned>(threads, frames.size()));
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread: pool) {
+        thread.join();
+    }
+    return ok;
+}
+
+#endif //NHOOK_TOOLS_TRACE_FRAMES_H
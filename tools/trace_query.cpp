@@ -0,0 +1,362 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 文本 trace（trace_log.txt 格式）的多线程查询：mmap 整个文件，按指令行边界切块，多个线程并行扫描。
+//   write 0x值              值第一次被写入内存的位置（-a 列出所有写入）
+//   read 0x起始 [0x结束]     读取了 [起始, 结束) 内内存的指令，不给结束时为单个字节
+//   reg 名称                寄存器的读写历史，x8 / w8 视为同一个寄存器
+// 结果按 trace 中的顺序输出：段号、段内指令序号（可直接用于 trace_seek goto）、文件偏移和指令行。
+// 压缩的 trace（.lz）先多线程解压到内存再查询。
+//
+// 用法: trace_query trace_log.txt 命令 参数 [-a] [-n 最多条数] [-t 线程数]
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "trace_frames.h"
+#include "trace_reader.h"
+#include "trace_record.h"
+#include "trace_text.h"
+
+// 每块至少这么大，块太小时线程切换的开销比扫描还大
+#define QUERY_MIN_CHUNK (1 << 20)
+#define SEGMENT_PREFIX "==== segment "
+
+enum QueryKind {
+    QUERY_WRITE,
+    QUERY_READ,
+    QUERY_REG,
+};
+
+struct Query {
+    QueryKind kind;
+    uint64_t value = 0;         // write
+    uint64_t start = 0;         // read: [start, end)
+    uint64_t end = 0;
+    char regClass = 0;          // reg: 'x' 表示 x/w 通用寄存器，其他为整个名称比较
+    long regNumber = -1;
+    std::string regName;
+    bool all = false;           // write: 所有写入而不是第一次
+    size_t limit = 0;           // 最多输出条数，0 为不限
+};
+
+struct Hit {
+    size_t line;                // 指令行在数据中的偏移
+    uint32_t segment;           // 块内第几个段（0 为块开始时所在的段）
+    uint64_t instruction;       // 在该段中、从块内开始计数的指令序号
+    std::string detail;
+};
+
+// 块的扫描结果；段号和指令序号在所有块扫描完后按顺序累加得到
+struct Chunk {
+    size_t begin = 0;
+    size_t end = 0;
+    std::vector<uint32_t> segments;     // 块内遇到的段开始行的段号
+    uint64_t instructions = 0;          // 最后一个段中（没有段开始行时为整块）的指令数
+    std::vector<Hit> hits;
+    bool scanned = false;
+};
+
+static std::vector<Chunk> splitChunks(std::string_view data, unsigned threads) {
+    size_t target = std::max<size_t>(data.size() / (threads * 8 + 1), QUERY_MIN_CHUNK);
+    std::vector<Chunk> chunks;
+    size_t begin = 0;
+    while (begin < data.size()) {
+        size_t end = begin + target >= data.size() ? data.size() : nextInstructionLine(data, begin + target);
+        chunks.emplace_back();
+        chunks.back().begin = begin;
+        chunks.back().end = end;
+        begin = end;
+    }
+    return chunks;
+}
+
+static inline char lower(char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+// 寄存器名拆为类别和编号：x8 / w8 -> ('x', 8)，其他（sp / lr / nzcv）类别为 0，按名称比较
+static void parseRegister(std::string_view name, char &cls, long &number) {
+    cls = 0;
+    number = -1;
+    if (name.size() >= 2 && (lower(name[0]) == 'x' || lower(name[0]) == 'w')) {
+        long n = 0;
+        for (size_t i = 1; i < name.size(); ++i) {
+            if (name[i] < '0' || name[i] > '9') {
+                return;
+            }
+            n = n * 10 + (name[i] - '0');
+        }
+        cls = 'x';
+        number = n;
+    }
+}
+
+static bool sameRegister(const Query &query, std::string_view name) {
+    char cls;
+    long number;
+    parseRegister(name, cls, number);
+    if (query.regClass != 0 || cls != 0) {
+        return cls == query.regClass && number == query.regNumber;
+    }
+    if (name.size() != query.regName.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (lower(name[i]) != lower(query.regName[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+class Scanner {
+public:
+    Scanner(std::string_view data, const Query &query) : data(data), query(query) {}
+
+    // 不需要后面的块时（write 只找第一次且已经在更早的块中找到）返回 false
+    bool wanted(size_t index) const {
+        return query.kind != QUERY_WRITE || query.all || index <= firstHitChunk.load(std::memory_order_relaxed);
+    }
+
+    void scan(Chunk &chunk, size_t index) {
+        std::string_view instruction;
+        size_t instructionPos = 0;
+        uint32_t segment = 0;
+        uint64_t count = 0;
+        size_t pos = chunk.begin;
+        while (pos < chunk.end) {
+            const char *nl = static_cast<const char *>(memchr(data.data() + pos, '\n', chunk.end - pos));
+            size_t len = nl ? nl - (data.data() + pos) : chunk.end - pos;
+            std::string_view line(data.data() + pos, len);
+            size_t linePos = pos;
+            pos += len + 1;
+
+            if (len == 0) {
+                continue;
+            }
+            if (line[0] == ' ') {
+                if (!instruction.empty() && query.kind != QUERY_REG && startsWith(line, "   mem[")) {
+                    onMemory(chunk, line, instructionPos, segment, count - 1);
+                }
+                continue;
+            }
+            if (isSegmentLine(line)) {
+                if (line.find(" target ") != std::string_view::npos) {
+                    uint64_t number = 0;
+                    for (size_t i = sizeof(SEGMENT_PREFIX) - 1; i < line.size() && line[i] >= '0' && line[i] <= '9'; ++i) {
+                        number = number * 10 + (line[i] - '0');
+                    }
+                    chunk.segments.push_back((uint32_t) number);
+                    segment++;
+                    count = 0;
+                }
+                instruction = {};
+                continue;
+            }
+            if (!isInstructionLine(line)) {
+                continue;
+            }
+            instruction = line;
+            instructionPos = linePos;
+            count++;
+            if (query.kind == QUERY_REG) {
+                onInstruction(chunk, line, linePos, segment, count - 1);
+            }
+            if (full(chunk) || !wanted(index)) {
+                break;
+            }
+        }
+        chunk.instructions = count;
+        chunk.scanned = true;
+        if (!chunk.hits.empty() && query.kind == QUERY_WRITE && !query.all) {
+            // 记录找到结果的最早的块，更晚的块不用再扫描
+            size_t current = firstHitChunk.load();
+            while (index < current && !firstHitChunk.compare_exchange_weak(current, index)) {
+            }
+        }
+    }
+
+private:
+    bool full(const Chunk &chunk) const {
+        // 每块最多需要 limit 条：输出的前 limit 条一定来自这些结果
+        size_t limit = query.kind == QUERY_WRITE && !query.all ? 1 : query.limit;
+        return limit != 0 && chunk.hits.size() >= limit;
+    }
+
+    void onMemory(Chunk &chunk, std::string_view line, size_t instructionPos, uint32_t segment, uint64_t n) {
+        forEachAccess(line, [&](const MemAccess &acc) {
+            if (full(chunk)) {
+                return;
+            }
+            bool match = query.kind == QUERY_WRITE
+                         ? acc.write && acc.value == query.value
+                         : acc.read && acc.address < query.end && acc.address + std::max<uint64_t>(acc.size, 1) > query.start;
+            if (match) {
+                chunk.hits.push_back(Hit{instructionPos, segment, n, std::string(acc.text)});
+            }
+        });
+    }
+
+    void onInstruction(Chunk &chunk, std::string_view line, size_t linePos, uint32_t segment, uint64_t n) {
+        std::string detail;
+        auto collect = [&](const char *kind) {
+            return [&, kind](std::string_view name, uint64_t, std::string_view text) {
+                if (sameRegister(query, name)) {
+                    detail.append(kind).append(text).append(" ");
+                }
+            };
+        };
+        forEachRegister(line, "\tr[", collect("r:"));
+        forEachRegister(line, "\tw[", collect("w:"));
+        if (!detail.empty()) {
+            detail.pop_back();
+            chunk.hits.push_back(Hit{linePos, segment, n, std::move(detail)});
+        }
+    }
+
+    std::string_view data;
+    const Query &query;
+    std::atomic<size_t> firstHitChunk{SIZE_MAX};
+};
+
+static int usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s trace (write 0xVALUE | read 0xSTART [0xEND] | reg NAME) [-a] [-n max] [-t threads]\n", name);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    Query query{};
+    unsigned threads = std::thread::hardware_concurrency();
+    int c;
+    while ((c = getopt(argc, argv, "an:t:")) != -1) {
+        switch (c) {
+            case 'a':
+                query.all = true;
+                break;
+            case 'n':
+                query.limit = strtoul(optarg, nullptr, 10);
+                break;
+            case 't':
+                threads = strtoul(optarg, nullptr, 10);
+                break;
+            default:
+                return usage(argv[0]);
+        }
+    }
+    if (argc - optind < 3) {
+        return usage(argv[0]);
+    }
+    threads = std::max(threads, 1u);
+    const char *path = argv[optind];
+    std::string command = argv[optind + 1];
+    const char *arg = argv[optind + 2];
+    if (command == "write") {
+        query.kind = QUERY_WRITE;
+        query.value = strtoull(arg, nullptr, 0);
+    } else if (command == "read") {
+        query.kind = QUERY_READ;
+        query.start = strtoull(arg, nullptr, 0);
+        query.end = argc - optind > 3 ? strtoull(argv[optind + 3], nullptr, 0) : query.start + 1;
+        if (query.end <= query.start) {
+            fprintf(stderr, "empty address range\n");
+            return 1;
+        }
+    } else if (command == "reg") {
+        query.kind = QUERY_REG;
+        query.regName = arg;
+        parseRegister(query.regName, query.regClass, query.regNumber);
+    } else {
+        return usage(argv[0]);
+    }
+
+    MappedFile file;
+    if (!file.open(path)) {
+        return 1;
+    }
+    std::vector<uint8_t> decompressed;
+    std::string_view data(reinterpret_cast<const char *>(file.data), file.size);
+    if (isCompressedTrace(file.data, file.size)) {
+        std::vector<FrameInfo> frames;
+        decompressed.resize(scanFrames(file.data, file.size, frames));
+        if (!decompressFrames(frames, decompressed.data(), threads)) {
+            fprintf(stderr, "error: corrupt compressed trace\n");
+            return 1;
+        }
+        data = std::string_view(reinterpret_cast<const char *>(decompressed.data()), decompressed.size());
+    }
+    if (startsWith(data, TRACE_MAGIC)) {
+        fprintf(stderr, "binary trace: convert it with trace_render first\n");
+        return 1;
+    }
+
+    // 线程按顺序领取块，write 找到第一次后，更晚的块直接跳过
+    std::vector<Chunk> chunks = splitChunks(data, threads);
+    Scanner scanner(data, query);
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < std::min<size_t>(threads, chunks.size()); ++i) {
+        workers.emplace_back([&]() {
+            size_t index;
+            while ((index = next.fetch_add(1)) < chunks.size()) {
+                if (scanner.wanted(index)) {
+                    scanner.scan(chunks[index], index);
+                }
+            }
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+
+    // 按顺序累加各块的段号和指令数，得到每个结果在段内的指令序号
+    bool hasSegment = false;
+    uint32_t segmentNumber = 0;
+    uint64_t base = 0;
+    size_t printed = 0;
+    for (const Chunk &chunk: chunks) {
+        if (!chunk.scanned) {
+            break;
+        }
+        for (const Hit &hit: chunk.hits) {
+            if (query.limit != 0 && printed >= query.limit) {
+                break;
+            }
+            uint32_t seg = hit.segment == 0 ? segmentNumber : chunk.segments[hit.segment - 1];
+            uint64_t n = hit.segment == 0 ? base + hit.instruction : hit.instruction;
+            const char *eol = static_cast<const char *>(memchr(data.data() + hit.line, '\n', data.size() - hit.line));
+            size_t len = eol ? eol - (data.data() + hit.line) : data.size() - hit.line;
+            if (hasSegment || hit.segment != 0) {
+                printf("segment %u ", seg);
+            }
+            printf("#%" PRIu64 " @%zu  %s\n    %.*s\n", n, hit.line, hit.detail.c_str(), (int) len,
+                   data.data() + hit.line);
+            printed++;
+            if (query.kind == QUERY_WRITE && !query.all) {
+                return 0;
+            }
+        }
+        if (!chunk.segments.empty()) {
+            hasSegment = true;
+            segmentNumber = chunk.segments.back();
+            base = chunk.instructions;
+        } else {
+            base += chunk.instructions;
+        }
+    }
+    if (printed == 0) {
+        printf("not found\n");
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 主机端工具共用：只读 mmap 整个 trace 文件。durable trace（trace_mmap.h）只暴露已提交的数据部分，
+// 各工具不需要区分
+//
+
+#ifndef NHOOK_TOOLS_TRACE_READER_H
+#define NHOOK_TOOLS_TRACE_READER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace_mmap.h"
+
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        if (mapping != nullptr) {
+            munmap(mapping, mappingSize);
+        }
+    }
+
+    bool open(const char *path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            perror(path);
+            return false;
+        }
+        struct stat st{};
+        if (fstat(fd, &st) != 0) {
+            perror(path);
+            close(fd);
+            return false;
+        }
+        size = st.st_size;
+        if (size == 0) {
+            close(fd);
+            return true;
+        }
+        void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            perror(path);
+            size = 0;
+            return false;
+        }
+        madvise(p, size, MADV_SEQUENTIAL);
+        mapping = p;
+        mappingSize = size;
+        data = static_cast<const uint8_t *>(p);
+        durable = durableTraceData(data, size, data, size);
+        return true;
+    }
+
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    // 是否为 durable trace，是则 data / size 为其中已提交的数据
+    bool durable = false;
+
+private:
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+};
+
+#endif //NHOOK_TOOLS_TRACE_READER_H
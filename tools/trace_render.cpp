@@ -0,0 +1,537 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 将设备端输出的二进制 trace（trace_log.bin）还原为文本 trace_log.txt，
+// 输出格式与设备端文本模式逐字节一致。文件中的每个段（一次被 trace 的调用）之间以 "==== segment N ..." 行分隔。
+// 块模式的 trace 按 INST_DEF 把每个块展开为逐条指令：读寄存器的值取块开始时的状态，
+// 写寄存器的值取块结束时的状态，块内被中间指令改写过、无法还原的值输出为 "?"；块模式没有指针 dump。
+//
+// 压缩的 trace（trace_log.bin.lz）先在内存中多线程解压。
+//
+// 用法: trace_render trace_log.bin [trace_log.txt]
+//
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "gpr_delta.h"
+#include "trace_format.h"
+#include "trace_frames.h"
+#include "trace_record.h"
+#include "trace_reader.h"
+
+struct InstDef {
+    uint8_t symbolKind = TRACE_SYM_NONE;
+    uint64_t offset = 0;
+    uint32_t module = 0;
+    std::string symbol;
+    std::string disassembly;
+    std::vector<std::string> reads;
+    std::vector<std::string> writes;
+    uint8_t size = 4;
+    // 读写寄存器在 GPRState 中的下标，顺序同 reads / writes
+    std::vector<uint8_t> readIdx;
+    std::vector<uint8_t> writeIdx;
+};
+
+// 块模式中正在展开的块
+struct Block {
+    bool open = false;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    uint64_t entry[TRACE_GPR_COUNT] = {};
+    std::vector<TraceBlockMemAccess> mem;
+};
+
+class Renderer {
+public:
+    explicit Renderer(FILE *out) : out(out) {}
+
+    bool render(const uint8_t *data, size_t size) {
+        TraceFileHeader fileHeader{};
+        if (size < sizeof(fileHeader)) {
+            fprintf(stderr, "trace too small\n");
+            return false;
+        }
+        memcpy(&fileHeader, data, sizeof(fileHeader));
+        if (memcmp(fileHeader.magic, TRACE_MAGIC, 4) != 0 || fileHeader.version != TRACE_VERSION) {
+            fprintf(stderr, "not a trace file (bad magic or version)\n");
+            return false;
+        }
+        gprDelta = fileHeader.flags & TRACE_FLAG_GPR_DELTA;
+
+        TraceRecordReader reader(data + sizeof(fileHeader), size - sizeof(fileHeader));
+        TraceRecordHeader header{};
+        const uint8_t *payload;
+        while (reader.next(header, payload)) {
+            TracePayload p(payload, header.length);
+            switch (header.tag) {
+                case TRACE_REC_INST_DEF:
+                    onInstDef(p);
+                    break;
+                case TRACE_REC_INST_PRE:
+                    onPre(header.aux, p);
+                    break;
+                case TRACE_REC_INST_POST:
+                    onPost(header.aux, p);
+                    break;
+                case TRACE_REC_MEM:
+                    onMem(header.aux, p);
+                    break;
+                case TRACE_REC_DUMP:
+                    onDump(header.aux, p);
+                    break;
+                case TRACE_REC_DUMP_REF:
+                    onDumpRef(p);
+                    break;
+                case TRACE_REC_MODULE:
+                    onModule(p);
+                    break;
+                case TRACE_REC_BLOCK:
+                    onBlock(p);
+                    break;
+                case TRACE_REC_BLOCK_MEM:
+                    onBlockMem(header.aux, p);
+                    break;
+                case TRACE_REC_BLOCK_EXIT:
+                    onBlockExit(p);
+                    break;
+                case TRACE_REC_FPR:
+                    onFpr(header.aux, p);
+                    break;
+                case TRACE_REC_SEGMENT:
+                    onSegment(p);
+                    break;
+                case TRACE_REC_SEGMENT_END:
+                    onSegmentEnd(p);
+                    break;
+                default:
+                    // 未知记录直接跳过，保持向前兼容
+                    break;
+            }
+        }
+        finishBlock();
+        if (badRefs != 0) {
+            fprintf(stderr, "warning: skipped %" PRIu64 " reference(s) to dumps not in the segment\n", badRefs);
+        }
+        if (reader.position() != data + size) {
+            fprintf(stderr, "warning: trace truncated at offset %zu\n", (size_t) (reader.position() - data));
+        }
+        return true;
+    }
+
+private:
+    // 新的段：指令定义、模块和寄存器状态都从头开始
+    void onSegment(TracePayload &p) {
+        finishBlock();
+        uint32_t segment = p.get<uint32_t>();
+        uint16_t flags = p.get<uint16_t>();
+        uint64_t target = p.get<uint64_t>();
+        uint64_t timeMs = p.get<uint64_t>();
+        gprDelta = flags & TRACE_FLAG_GPR_DELTA;
+        defs.clear();
+        modules.clear();
+        current = &unknown;
+        pendingFpr.clear();
+        memset(regs, 0, sizeof(regs));
+        dumps = 0;
+        char *q = formatSegmentBegin(line, segment, target, timeMs);
+        fwrite(line, 1, q - line, out);
+    }
+
+    void onSegmentEnd(TracePayload &p) {
+        finishBlock();
+        uint32_t segment = p.get<uint32_t>();
+        uint64_t durationUs = p.get<uint64_t>();
+        char *q = formatSegmentEnd(line, segment, durationUs);
+        fwrite(line, 1, q - line, out);
+    }
+
+    // 还没结束的块（进程崩溃或段被截断），写寄存器的值未知
+    void finishBlock() {
+        if (block.open) {
+            expandBlock(nullptr);
+        }
+    }
+
+    void onModule(TracePayload &p) {
+        uint32_t module = p.get<uint32_t>();
+        p.get<uint64_t>();  // 加载基址，文本中不输出
+        size_t len;
+        const char *name = p.string<uint16_t>(len);
+        modules[module].assign(name ? name : "", len);
+    }
+
+    void onInstDef(TracePayload &p) {
+        uint64_t address = p.get<uint64_t>();
+        InstDef &def = defs[address];
+        def.offset = p.get<uint64_t>();
+        def.module = p.get<uint32_t>();
+        def.symbolKind = p.get<uint8_t>();
+        uint8_t numRead = p.get<uint8_t>();
+        uint8_t numWrite = p.get<uint8_t>();
+        size_t len;
+        const char *str = p.string<uint16_t>(len);
+        def.symbol.assign(str ? str : "", len);
+        str = p.string<uint16_t>(len);
+        def.disassembly.assign(str ? str : "", len);
+        def.reads.clear();
+        def.writes.clear();
+        for (int i = 0; i < numRead; ++i) {
+            str = p.string<uint8_t>(len);
+            def.reads.emplace_back(str ? str : "", len);
+        }
+        for (int i = 0; i < numWrite; ++i) {
+            str = p.string<uint8_t>(len);
+            def.writes.emplace_back(str ? str : "", len);
+        }
+        def.size = p.get<uint8_t>();
+        if (def.size == 0) {
+            def.size = 4;
+        }
+        def.readIdx.resize(numRead);
+        def.writeIdx.resize(numWrite);
+        for (int i = 0; i < numRead; ++i) {
+            def.readIdx[i] = p.get<uint8_t>();
+        }
+        for (int i = 0; i < numWrite; ++i) {
+            def.writeIdx[i] = p.get<uint8_t>();
+        }
+    }
+
+    void onPre(uint8_t count, TracePayload &p) {
+        uint64_t address = p.get<uint64_t>();
+        auto it = defs.find(address);
+        current = it == defs.end() ? &unknown : &it->second;
+        writeHead(address);
+
+        if (gprDelta) {
+            applyGprDelta(p, regs);
+            regs[TRACE_GPR_PC] = address;
+            writeRegState("\tr[", "]", current->reads, current->readIdx);
+        } else if (count > 0) {
+            writeRegs("\tr[", "]", current->reads, count, p);
+        }
+    }
+
+    // "符号[0x偏移]:0x地址: 反汇编"
+    void writeHead(uint64_t address) {
+        if (current->symbolKind == TRACE_SYM_QBDI) {
+            fprintf(out, "%s[0x%" PRIx64 "]:0x%" PRIx64 ": %s", current->symbol.c_str(), current->offset,
+                    address, current->disassembly.c_str());
+        } else if (current->symbolKind == TRACE_SYM_MODULE) {
+            fprintf(out, "%s[0x%" PRIx64 "]:0x%" PRIx64 ": %s", modules[current->module].c_str(), current->offset,
+                    address, current->disassembly.c_str());
+        } else {
+            fprintf(out, "0x%" PRIx64 ": %s", address, current->disassembly.c_str());
+        }
+    }
+
+    void onPost(uint8_t count, TracePayload &p) {
+        if (gprDelta) {
+            applyGprDelta(p, regs);
+            writeRegState("\tw[", "]", current->writes, current->writeIdx);
+        } else if (count > 0) {
+            writeRegs("\tw[", "]", current->writes, count, p);
+        }
+        // FPR_WRITE 记录在 INST_POST 之前，与设备端文本一样放在 w[] 之后
+        fwrite(pendingFpr.data(), 1, pendingFpr.size(), out);
+        pendingFpr.clear();
+        fputs("\n", out);
+    }
+
+    // FPR 通道：READ 直接跟在 r[] 之后输出，WRITE 留到 INST_POST 的 w[] 之后
+    void onFpr(uint8_t count, TracePayload &p) {
+        uint8_t kind = p.get<uint8_t>();
+        std::string text = kind == TRACE_FPR_READ ? "\tfr[" : "\tfw[";
+        for (int i = 0; i < count; ++i) {
+            uint8_t reg = p.get<uint8_t>();
+            uint8_t lanes = p.get<uint8_t>() & 3;
+            uint64_t value[2] = {};
+            for (int lane = 0; lane < 2; ++lane) {
+                if (lanes & (1 << lane)) {
+                    value[lane] = p.get<uint64_t>();
+                }
+            }
+            char *q = formatFprChange(line, reg & 31, lanes, value);
+            text.append(line, q - line);
+        }
+        text += "]";
+        if (kind == TRACE_FPR_READ) {
+            fwrite(text.data(), 1, text.size(), out);
+        } else {
+            pendingFpr = text;
+        }
+    }
+
+    void onMem(uint8_t count, TracePayload &p) {
+        if (count == 0) {
+            fputs("\n", out);
+        }
+        for (int i = 0; i < count; ++i) {
+            writeMem(p.get<TraceMemAccess>());
+        }
+        fputs("\n\n", out);
+    }
+
+    // "   mem[r]:0x地址 size:大小 value:0x值"
+    void writeMem(const TraceMemAccess &acc) {
+        char *q = line;
+        if (acc.type == TRACE_MEM_READ) {
+            q = formatLiteral(q, "   mem[r]:0x");
+        } else if (acc.type == TRACE_MEM_WRITE) {
+            q = formatLiteral(q, "   mem[w]:0x");
+        } else {
+            q = formatLiteral(q, "   mem[rw]:0x");
+        }
+        q = formatHex(q, acc.address);
+        q = formatLiteral(q, " size:");
+        q = formatHex(q, acc.size);
+        q = formatLiteral(q, " value:0x");
+        q = formatHex(q, acc.value);
+        fwrite(line, 1, q - line, out);
+    }
+
+    void onDump(uint8_t kind, TracePayload &p) {
+        uint8_t index = p.get<uint8_t>();
+        uint64_t address = p.get<uint64_t>();
+        size_t len = p.remaining();
+        const uint8_t *bytes = p.bytes(len);
+        if (kind != TRACE_DUMP_INVALID) {
+            dumps++;
+        }
+        if (kind == TRACE_DUMP_STRING) {
+            fputs("Strings :", out);
+            fwrite(bytes, 1, len, out);
+            fputs("\n", out);
+        } else if (kind == TRACE_DUMP_HEX) {
+            fprintf(out, "Hexdump for %s at address 0x%" PRIx64 ":\n", regName(current->writes, index), address);
+            // DUMP 记录最长 TRACE_MAX_RECORD 字节，line 足够容纳
+            char *q = formatHexdump(line, bytes, len, address);
+            fwrite(line, 1, q - line, out);
+        } else {
+            fprintf(out, "Invalid memory access at address 0x%" PRIx64 "\n", address);
+        }
+    }
+
+    // 与之前第 id 个 dump 相同，输出与文本模式相同的引用行；本段还没有第 id 个 dump 时记录已损坏，跳过
+    void onDumpRef(TracePayload &p) {
+        uint8_t index = p.get<uint8_t>();
+        uint64_t address = p.get<uint64_t>();
+        uint32_t id = p.get<uint32_t>();
+        if (id >= dumps) {
+            badRefs++;
+            return;
+        }
+        const char *reg = regName(current->writes, index);
+        char *q = formatDumpRef(line, reg, strlen(reg), id, address);
+        fwrite(line, 1, q - line, out);
+    }
+
+    void onBlock(TracePayload &p) {
+        finishBlock();
+        block.open = true;
+        block.start = p.get<uint64_t>();
+        block.end = p.get<uint64_t>();
+        applyGprDelta(p, regs);
+        memcpy(block.entry, regs, sizeof(regs));
+        block.mem.clear();
+    }
+
+    void onBlockMem(uint8_t count, TracePayload &p) {
+        for (int i = 0; i < count; ++i) {
+            block.mem.push_back(p.get<TraceBlockMemAccess>());
+        }
+    }
+
+    void onBlockExit(TracePayload &p) {
+        applyGprDelta(p, regs);
+        if (block.open) {
+            expandBlock(regs);
+        }
+    }
+
+    // 把块展开为逐条指令的文本，exit 为空表示块结束时的寄存器未知
+    void expandBlock(const uint64_t *exit) {
+        block.open = false;
+        insts.clear();
+        for (uint64_t address = block.start; address < block.end;) {
+            auto it = defs.find(address);
+            const InstDef *def = it == defs.end() ? &unknown : &it->second;
+            insts.emplace_back(address, def);
+            address += def->size;
+        }
+
+        // 每个寄存器在块内最后一次被写入的指令，之后的值就是块结束时的值
+        int lastWrite[TRACE_GPR_COUNT];
+        bool written[TRACE_GPR_COUNT] = {};
+        std::fill(std::begin(lastWrite), std::end(lastWrite), -1);
+        for (size_t i = 0; i < insts.size(); ++i) {
+            for (uint8_t idx: insts[i].second->writeIdx) {
+                if (idx < TRACE_GPR_COUNT) {
+                    lastWrite[idx] = (int) i;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < insts.size(); ++i) {
+            uint64_t address = insts[i].first;
+            current = insts[i].second;
+            writeHead(address);
+            if (!current->reads.empty()) {
+                fputs("\tr[", out);
+                for (size_t k = 0; k < current->reads.size(); ++k) {
+                    // 块内还没被写过：块开始时的值；最后一次写入已经发生：块结束时的值
+                    uint8_t idx = current->readIdx[k];
+                    if (idx < TRACE_GPR_COUNT && !written[idx]) {
+                        writeReg(current->reads[k], true, block.entry[idx]);
+                    } else if (exit != nullptr && idx < TRACE_GPR_COUNT && lastWrite[idx] < (int) i) {
+                        writeReg(current->reads[k], true, exit[idx]);
+                    } else {
+                        writeReg(current->reads[k], false, 0);
+                    }
+                }
+                fputs("]", out);
+            }
+            for (uint8_t idx: current->writeIdx) {
+                if (idx < TRACE_GPR_COUNT) {
+                    written[idx] = true;
+                }
+            }
+
+            if (!current->writes.empty()) {
+                fputs("\tw[", out);
+                for (size_t k = 0; k < current->writes.size(); ++k) {
+                    uint8_t idx = current->writeIdx[k];
+                    bool known = exit != nullptr && idx < TRACE_GPR_COUNT && lastWrite[idx] == (int) i;
+                    writeReg(current->writes[k], known, known ? exit[idx] : 0);
+                }
+                fputs("]\n", out);
+            } else {
+                fputs("\n", out);
+            }
+
+            bool accessed = false;
+            for (const auto &acc: block.mem) {
+                if (acc.instAddress == address) {
+                    writeMem(acc.access);
+                    accessed = true;
+                }
+            }
+            if (accessed) {
+                fputs("\n\n", out);
+            }
+        }
+    }
+
+    // "名称=0x值 "，值未知时为 "名称=? "
+    void writeReg(const std::string &name, bool known, uint64_t value) {
+        char *q = formatBytes(line, name.data(), name.size());
+        if (known) {
+            q = formatLiteral(q, "=0x");
+            q = formatHex(q, value);
+        } else {
+            q = formatLiteral(q, "=?");
+        }
+        *q++ = ' ';
+        fwrite(line, 1, q - line, out);
+    }
+
+    // GPR 增量模式：按 INST_DEF 中的下标从当前寄存器状态取值，没有寄存器时不输出
+    void writeRegState(const char *prefix, const char *suffix, const std::vector<std::string> &names,
+                       const std::vector<uint8_t> &indexes) {
+        if (names.empty()) {
+            return;
+        }
+        fputs(prefix, out);
+        for (size_t k = 0; k < names.size(); ++k) {
+            bool known = k < indexes.size() && indexes[k] < TRACE_GPR_COUNT;
+            writeReg(names[k], known, known ? regs[indexes[k]] : 0);
+        }
+        fputs(suffix, out);
+    }
+
+    // prefix + 每个寄存器 "名称=0x值 " + suffix
+    void writeRegs(const char *prefix, const char *suffix, const std::vector<std::string> &names, uint8_t count,
+                   TracePayload &p) {
+        fputs(prefix, out);
+        for (int i = 0; i < count; ++i) {
+            const char *name = regName(names, i);
+            char *q = formatBytes(line, name, strnlen(name, 0xff));
+            q = formatLiteral(q, "=0x");
+            q = formatHex(q, p.get<uint64_t>());
+            *q++ = ' ';
+            fwrite(line, 1, q - line, out);
+        }
+        fputs(suffix, out);
+    }
+
+    static const char *regName(const std::vector<std::string> &names, size_t index) {
+        return index < names.size() ? names[index].c_str() : "?";
+    }
+
+    FILE *out;
+    // 格式化一条记录的输出
+    char line[(TRACE_MAX_RECORD + 15) / 16 * HEXDUMP_ROW_MAX];
+    std::unordered_map<uint64_t, InstDef> defs;
+    std::unordered_map<uint32_t, std::string> modules;
+    InstDef unknown;
+    const InstDef *current = &unknown;
+    // GPR 增量还原出的当前寄存器状态（逐条指令的增量模式和块模式）
+    bool gprDelta = false;
+    // 还没输出的 fw[]
+    std::string pendingFpr;
+    // 本段中已经输出的字符串 / hexdump 个数，即下一个 dump 的编号
+    uint32_t dumps = 0;
+    // 引用了本段不存在的 dump 的 DUMP_REF 记录数
+    uint64_t badRefs = 0;
+    uint64_t regs[TRACE_GPR_COUNT] = {};
+    // 块模式：正在展开的块和块内的指令
+    Block block;
+    std::vector<std::pair<uint64_t, const InstDef *>> insts;
+};
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s trace_log.bin [trace_log.txt]\n", argv[0]);
+        return 1;
+    }
+    MappedFile file;
+    if (!file.open(argv[1])) {
+        return 1;
+    }
+    FILE *out = stdout;
+    if (argc > 2) {
+        out = fopen(argv[2], "w");
+        if (out == nullptr) {
+            perror(argv[2]);
+            return 1;
+        }
+    }
+    static char outbuf[1 << 20];
+    setvbuf(out, outbuf, _IOFBF, sizeof(outbuf));
+
+    const uint8_t *data = file.data;
+    size_t size = file.size;
+    std::vector<uint8_t> decompressed;
+    if (isCompressedTrace(data, size)) {
+        std::vector<FrameInfo> frames;
+        decompressed.resize(scanFrames(data, size, frames));
+        decompressFrames(frames, decompressed.data(), std::thread::hardware_concurrency());
+        data = decompressed.data();
+        size = decompressed.size();
+    }
+
+    Renderer renderer(out);
+    bool ok = renderer.render(data, size);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return ok ? 0 : 1;
+}
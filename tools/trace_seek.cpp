@@ -0,0 +1,356 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 用 sidecar 索引（trace 文件名 + ".idx"，设备端 index = true 时输出）随机访问 trace：
+//   info                     列出文件中的段
+//   goto N                   从段内第 N 条指令开始输出 trace（文本 trace）
+//   regs N                   第 N 条指令之前最近的检查点处的寄存器
+//   addr 0x地址              地址第一次 / 最后一次执行的指令序号和次数，并列出每次执行的指令行（文本 trace）
+// 从最近的检查点开始只扫描需要的部分。压缩的 trace（.lz）只解压用到的帧。
+//
+// 用法: trace_seek trace_log.txt 命令 [参数] [-s 段] [-n 行数 / 最多条数] [-i 索引文件]
+//
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+#include "trace_frames.h"
+#include "trace_index.h"
+#include "trace_reader.h"
+#include "trace_record.h"
+#include "trace_text.h"
+
+struct Checkpoint {
+    uint64_t instruction;
+    uint64_t offset;
+    uint64_t regs[TRACE_GPR_COUNT];
+};
+
+struct Segment {
+    uint32_t number = 0;
+    uint64_t offset = 0;
+    uint64_t instructions = 0;
+    bool ended = false;
+    std::vector<Checkpoint> checkpoints;
+    std::vector<TraceIndexAddress> addresses;   // 按地址排序
+};
+
+static bool loadIndex(const MappedFile &file, std::vector<Segment> &segments) {
+    TraceFileHeader header{};
+    if (file.size < sizeof(header)) {
+        fprintf(stderr, "index too small\n");
+        return false;
+    }
+    memcpy(&header, file.data, sizeof(header));
+    if (memcmp(header.magic, TRACE_INDEX_MAGIC, 4) != 0 || header.version != TRACE_INDEX_VERSION) {
+        fprintf(stderr, "not a trace index (bad magic or version)\n");
+        return false;
+    }
+    TraceRecordReader reader(file.data + sizeof(header), file.size - sizeof(header));
+    TraceRecordHeader rec{};
+    const uint8_t *payload;
+    while (reader.next(rec, payload)) {
+        TracePayload p(payload, rec.length);
+        if (rec.tag == TRACE_IDX_SEGMENT) {
+            segments.emplace_back();
+            segments.back().number = p.get<uint32_t>();
+            segments.back().offset = p.get<uint64_t>();
+            continue;
+        }
+        if (segments.empty()) {
+            continue;
+        }
+        Segment &segment = segments.back();
+        if (rec.tag == TRACE_IDX_CHECKPOINT) {
+            Checkpoint cp{};
+            cp.instruction = p.get<uint64_t>();
+            cp.offset = p.get<uint64_t>();
+            for (auto &reg: cp.regs) {
+                reg = p.get<uint64_t>();
+            }
+            segment.checkpoints.push_back(cp);
+            segment.instructions = std::max(segment.instructions, cp.instruction);
+        } else if (rec.tag == TRACE_IDX_ADDRESSES) {
+            for (int i = 0; i < rec.aux; ++i) {
+                segment.addresses.push_back(p.get<TraceIndexAddress>());
+            }
+        } else if (rec.tag == TRACE_IDX_SEGMENT_END) {
+            p.get<uint32_t>();
+            segment.instructions = p.get<uint64_t>();
+            segment.ended = true;
+        }
+    }
+    for (auto &segment: segments) {
+        std::sort(segment.addresses.begin(), segment.addresses.end(),
+                  [](const TraceIndexAddress &a, const TraceIndexAddress &b) { return a.address < b.address; });
+    }
+    return true;
+}
+
+// trace 内容的按偏移访问：未压缩时直接指向 mmap，压缩时只解压从偏移所在帧开始、实际读到的帧
+class TraceData {
+public:
+    bool open(const char *path) {
+        if (!file.open(path)) {
+            return false;
+        }
+        compressed = isCompressedTrace(file.data, file.size);
+        if (compressed) {
+            total = scanFrames(file.data, file.size, frames);
+        } else {
+            total = file.size;
+        }
+        return true;
+    }
+
+    bool isBinary() {
+        std::string_view head = lines(0).next();
+        return startsWith(head, TRACE_MAGIC);
+    }
+
+    // 从 offset 开始逐行读取
+    class Lines {
+    public:
+        Lines(TraceData &data, uint64_t offset) : data(data), pos(offset) {}
+
+        // 下一行（不含换行符），结束时返回空并置 eof
+        std::string_view next() {
+            while (true) {
+                const char *p;
+                size_t avail = data.view(pos, p);
+                const char *nl = avail ? static_cast<const char *>(memchr(p, '\n', avail)) : nullptr;
+                if (nl != nullptr || pos + avail >= data.total || data.compressed == false) {
+                    size_t len = nl ? nl - p : avail;
+                    pos += nl ? len + 1 : len;
+                    eof = len == 0 && nl == nullptr;
+                    return {p, len};
+                }
+                // 一行跨过了已解压的部分，多解压一帧
+                data.extend();
+            }
+        }
+
+        bool eof = false;
+
+    private:
+        TraceData &data;
+        uint64_t pos;
+    };
+
+    Lines lines(uint64_t offset) { return {*this, offset}; }
+
+private:
+    // offset 处连续可读的数据
+    size_t view(uint64_t offset, const char *&p) {
+        if (offset >= total) {
+            p = nullptr;
+            return 0;
+        }
+        if (!compressed) {
+            p = reinterpret_cast<const char *>(file.data) + offset;
+            return total - offset;
+        }
+        if (offset < bufferStart || offset >= bufferStart + buffer.size()) {
+            // 从 offset 所在的帧重新开始解压
+            auto it = std::upper_bound(frames.begin(), frames.end(), offset,
+                                       [](uint64_t o, const FrameInfo &f) { return o < f.outOffset; });
+            nextFrame = it - frames.begin() - 1;
+            bufferStart = frames[nextFrame].outOffset;
+            buffer.clear();
+            extend();
+        }
+        p = reinterpret_cast<const char *>(buffer.data()) + (offset - bufferStart);
+        return buffer.size() - (offset - bufferStart);
+    }
+
+    void extend() {
+        if (nextFrame >= frames.size()) {
+            return;
+        }
+        FrameInfo frame = frames[nextFrame++];
+        size_t old = buffer.size();
+        buffer.resize(old + frame.header.rawSize);
+        frame.outOffset = old;
+        if (!decompressFrame(frame, buffer.data())) {
+            fprintf(stderr, "error: frame %zu is corrupt\n", nextFrame - 1);
+        }
+    }
+
+    MappedFile file;
+    bool compressed = false;
+    uint64_t total = 0;
+    std::vector<FrameInfo> frames;
+    std::vector<uint8_t> buffer;
+    uint64_t bufferStart = 0;
+    size_t nextFrame = 0;
+};
+
+static const char *const REG_NAMES[TRACE_GPR_COUNT] = {
+        "x0", "x1", "x2", "x3", "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11", "x12", "x13", "x14", "x15", "x16",
+        "x17", "x18", "x19", "x20", "x21", "x22", "x23", "x24", "x25", "x26", "x27", "x28", "x29", "lr", "sp", "nzcv",
+        "pc"};
+
+// 第 instruction 条指令之前（含）最近的检查点，没有时返回空
+static const Checkpoint *findCheckpoint(const Segment &segment, uint64_t instruction) {
+    auto it = std::upper_bound(segment.checkpoints.begin(), segment.checkpoints.end(), instruction,
+                               [](uint64_t n, const Checkpoint &cp) { return n < cp.instruction; });
+    return it == segment.checkpoints.begin() ? nullptr : &*(it - 1);
+}
+
+// 从检查点开始扫描文本 trace，对序号在 [from, to] 内的每条指令调用 fn(序号, 指令行, lines)，fn 返回 false 时停止
+template<typename Fn>
+static void scanInstructions(TraceData &data, const Checkpoint &cp, uint64_t from, uint64_t to, Fn fn) {
+    auto lines = data.lines(cp.offset);
+    uint64_t instruction = cp.instruction - 1;
+    while (true) {
+        std::string_view line = lines.next();
+        if (lines.eof || isSegmentLine(line)) {
+            return;
+        }
+        if (!isInstructionLine(line)) {
+            continue;
+        }
+        if (++instruction > to) {
+            return;
+        }
+        if (instruction >= from && !fn(instruction, line, lines)) {
+            return;
+        }
+    }
+}
+
+static void printRegs(const Checkpoint &cp) {
+    for (int i = 0; i < TRACE_GPR_COUNT; ++i) {
+        printf("%-5s0x%016" PRIx64 "%s", REG_NAMES[i], cp.regs[i], i % 4 == 3 ? "\n" : "  ");
+    }
+    printf("\n");
+}
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s trace (info | goto N | regs N | addr 0xADDR) [-s segment] [-n count] [-i index]\n",
+            name);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    int segmentArg = -1;
+    long count = -1;
+    std::string indexPath;
+    int c;
+    while ((c = getopt(argc, argv, "s:n:i:")) != -1) {
+        switch (c) {
+            case 's':
+                segmentArg = atoi(optarg);
+                break;
+            case 'n':
+                count = atol(optarg);
+                break;
+            case 'i':
+                indexPath = optarg;
+                break;
+            default:
+                return usage(argv[0]);
+        }
+    }
+    if (argc - optind < 2) {
+        return usage(argv[0]);
+    }
+    const char *tracePath = argv[optind];
+    std::string command = argv[optind + 1];
+    uint64_t arg = argc - optind > 2 ? strtoull(argv[optind + 2], nullptr, 0) : 0;
+    if (indexPath.empty()) {
+        indexPath = std::string(tracePath) + ".idx";
+    }
+
+    MappedFile indexFile;
+    std::vector<Segment> segments;
+    if (!indexFile.open(indexPath.c_str()) || !loadIndex(indexFile, segments)) {
+        return 1;
+    }
+    TraceData data;
+    if (!data.open(tracePath)) {
+        return 1;
+    }
+
+    if (command == "info") {
+        printf("%-4s %8s %14s %12s %12s %10s\n", "#", "segment", "offset", "instructions", "checkpoints", "addresses");
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const Segment &s = segments[i];
+            printf("%-4zu %8u %14" PRIu64 " %12" PRIu64 "%s %11zu %10zu\n", i, s.number, s.offset, s.instructions,
+                   s.ended ? " " : "+", s.checkpoints.size(), s.addresses.size());
+        }
+        return 0;
+    }
+
+    // -s 为文件中的第几个段（info 中的 #），默认最后一个
+    if (segments.empty()) {
+        fprintf(stderr, "no segments in index\n");
+        return 1;
+    }
+    size_t ordinal = segmentArg < 0 ? segments.size() - 1 : (size_t) segmentArg;
+    if (ordinal >= segments.size()) {
+        fprintf(stderr, "segment #%zu out of range (%zu segments)\n", ordinal, segments.size());
+        return 1;
+    }
+    const Segment &segment = segments[ordinal];
+    bool binary = data.isBinary();
+
+    if (command == "regs" || command == "goto") {
+        const Checkpoint *cp = findCheckpoint(segment, arg);
+        if (cp == nullptr) {
+            fprintf(stderr, "no checkpoint before instruction %" PRIu64 "\n", arg);
+            return 1;
+        }
+        if (command == "regs" || binary) {
+            printf("checkpoint at instruction %" PRIu64 ", offset %" PRIu64 "\n", cp->instruction, cp->offset);
+            printRegs(*cp);
+            if (binary && command == "goto") {
+                printf("binary trace: render it with trace_render to read the instructions\n");
+            }
+            return 0;
+        }
+        // 从检查点数到第 N 条指令，再原样输出 count 行
+        long remaining = count < 0 ? 20 : count;
+        scanInstructions(data, *cp, arg, arg, [&](uint64_t, std::string_view line, TraceData::Lines &lines) {
+            while (remaining-- > 0 && !lines.eof) {
+                printf("%.*s\n", (int) line.size(), line.data());
+                line = lines.next();
+            }
+            return false;
+        });
+        return 0;
+    }
+
+    if (command == "addr") {
+        auto it = std::lower_bound(segment.addresses.begin(), segment.addresses.end(), arg,
+                                   [](const TraceIndexAddress &a, uint64_t address) { return a.address < address; });
+        if (it == segment.addresses.end() || it->address != arg) {
+            printf("0x%" PRIx64 " not executed in segment #%zu\n", arg, ordinal);
+            return 0;
+        }
+        printf("0x%" PRIx64 ": %" PRIu64 " hits, first at instruction %" PRIu64 ", last at %" PRIu64 "\n", arg,
+               it->count, it->first, it->last);
+        const Checkpoint *cp = findCheckpoint(segment, it->first);
+        if (binary || cp == nullptr) {
+            return 0;
+        }
+        long remaining = count < 0 ? 100 : count;
+        scanInstructions(data, *cp, it->first, it->last, [&](uint64_t n, std::string_view line, TraceData::Lines &) {
+            uint64_t address;
+            if (parseInstructionAddress(line, address) && address == arg) {
+                printf("%10" PRIu64 "  %.*s\n", n, (int) line.size(), line.data());
+                return --remaining > 0;
+            }
+            return true;
+        });
+        return 0;
+    }
+    return usage(argv[0]);
+}
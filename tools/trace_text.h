@@ -0,0 +1,161 @@
+//
+// Created by agent on 2026/10/17.
+//
+// 主机端工具共用：文本 trace（trace_log.txt 格式）的行分类和解析。
+// 一条指令以指令行开始（"符号[0x偏移]:0x地址: 反汇编\tr[...]\tw[...]"），之后可能跟着
+// Strings / Hexdump / Invalid memory access / Same as dump / mem[...] 等附属行和空行。
+//
+
+#ifndef NHOOK_TOOLS_TRACE_TEXT_H
+#define NHOOK_TOOLS_TRACE_TEXT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+static inline bool startsWith(std::string_view line, std::string_view prefix) {
+    return line.size() >= prefix.size() && memcmp(line.data(), prefix.data(), prefix.size()) == 0;
+}
+
+static inline int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// 从 pos 开始解析十六进制数（不含 0x），返回解析的字符数
+static inline size_t parseHex(std::string_view s, size_t pos, uint64_t &value) {
+    size_t start = pos;
+    value = 0;
+    int d;
+    while (pos < s.size() && (d = hexDigit(s[pos])) >= 0) {
+        value = value << 4 | (uint64_t) d;
+        pos++;
+    }
+    return pos - start;
+}
+
+// hexdump 的一行："%08x: xx xx ..."，开头是不带 0x 的十六进制地址
+static inline bool isHexdumpRow(std::string_view line) {
+    uint64_t value;
+    size_t n = parseHex(line, 0, value);
+    return n >= 8 && line.size() > n + 1 && line[n] == ':' && line[n + 1] == ' ';
+}
+
+// 段的分隔行
+static inline bool isSegmentLine(std::string_view line) {
+    return startsWith(line, "==== segment ");
+}
+
+// 是否为指令行（每条指令的第一行）
+static inline bool isInstructionLine(std::string_view line) {
+    if (line.empty() || line[0] == ' ') {
+        return false;   // 空行、"   mem[...]"
+    }
+    return !startsWith(line, "Strings :") && !startsWith(line, "Hexdump for ") &&
+           !startsWith(line, "Invalid memory access") && !startsWith(line, "Same as dump #") &&
+           !isSegmentLine(line) && !isHexdumpRow(line);
+}
+
+// 指令行中的指令地址："0x地址: ..." 或 "...]:0x地址: ..."
+static inline bool parseInstructionAddress(std::string_view line, uint64_t &address) {
+    size_t pos;
+    if (startsWith(line, "0x")) {
+        pos = 2;
+    } else {
+        pos = line.find("]:0x");
+        if (pos == std::string_view::npos) {
+            return false;
+        }
+        pos += 4;
+    }
+    size_t n = parseHex(line, pos, address);
+    return n > 0 && pos + n < line.size() && line[pos + n] == ':';
+}
+
+// 从 pos 开始的下一个指令行的起始位置，块的边界都落在指令行上，指令和它的 mem 行不会被切开
+static inline size_t nextInstructionLine(std::string_view data, size_t pos) {
+    if (pos == 0) {
+        return 0;
+    }
+    while (pos < data.size()) {
+        const char *nl = static_cast<const char *>(memchr(data.data() + pos - 1, '\n', data.size() - pos + 1));
+        if (nl == nullptr) {
+            return data.size();
+        }
+        pos = nl - data.data() + 1;
+        const char *eol = static_cast<const char *>(memchr(data.data() + pos, '\n', data.size() - pos));
+        size_t len = eol ? eol - (data.data() + pos) : data.size() - pos;
+        std::string_view line(data.data() + pos, len);
+        if (isInstructionLine(line) || isSegmentLine(line)) {
+            return pos;
+        }
+        pos++;
+    }
+    return data.size();
+}
+
+// "   mem[r]:0x地址 size:大小 value:0x值"，同一条指令的多个访问在同一行中依次排列
+struct MemAccess {
+    bool read;
+    bool write;
+    uint64_t address;
+    uint64_t size;
+    uint64_t value;
+    std::string_view text;
+};
+
+template<typename Fn>
+static inline void forEachAccess(std::string_view line, Fn fn) {
+    size_t pos = 0;
+    while ((pos = line.find("mem[", pos)) != std::string_view::npos) {
+        size_t start = pos;
+        MemAccess acc{};
+        pos += 4;
+        acc.read = pos < line.size() && line[pos] == 'r';
+        acc.write = line.substr(pos, 2) == "w]" || line.substr(pos, 3) == "rw]";
+        pos = line.find("]:0x", pos);
+        if (pos == std::string_view::npos) {
+            return;
+        }
+        pos += 4;
+        pos += parseHex(line, pos, acc.address);
+        if (line.substr(pos, 6) != " size:") {
+            continue;
+        }
+        pos += 6;
+        pos += parseHex(line, pos, acc.size);
+        if (line.substr(pos, 9) != " value:0x") {
+            continue;
+        }
+        pos += 9;
+        pos += parseHex(line, pos, acc.value);
+        acc.text = line.substr(start, pos - start);
+        fn(acc);
+    }
+}
+
+// 指令行中 "\tr[" / "\tw[" 后的 "名称=0x值 " 列表
+template<typename Fn>
+static inline void forEachRegister(std::string_view line, std::string_view marker, Fn fn) {
+    size_t pos = line.find(marker);
+    if (pos == std::string_view::npos) {
+        return;
+    }
+    pos += marker.size();
+    while (pos < line.size() && line[pos] != ']') {
+        size_t eq = line.find('=', pos);
+        if (eq == std::string_view::npos || line.substr(eq, 3) != "=0x") {
+            return;
+        }
+        std::string_view name = line.substr(pos, eq - pos);
+        uint64_t value;
+        size_t n = parseHex(line, eq + 3, value);
+        fn(name, value, line.substr(pos, eq + 3 + n - pos));
+        pos = eq + 3 + n + 1;
+    }
+}
+
+#endif //NHOOK_TOOLS_TRACE_TEXT_H